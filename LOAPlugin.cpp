@@ -4,10 +4,21 @@
 
 #include "stdafx.h"
 #include "LOAPlugin.h"
+#include "LoaLog.h"
+#include "LoaTrace.h"
+#include "LoaCompiled.h"
+#include "LoaShadow.h"
+#include "LoaGeometry.h"
+#include "LoaPredicate.h"
 #include <windows.h>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
+#include <sstream>
 #include <shlwapi.h>
 #include <unordered_set>
+#include <algorithm>
+#include <chrono>
 #include <json.hpp>
 
 using json = nlohmann::json;
@@ -29,127 +40,320 @@ size_t HashVectorOfStrings(const std::vector<std::string>& vec)
     return seed;
 }
 
+// Independent of iteration order: two equal sets can lay out their buckets
+// differently (insertion history, another run), and snapshots persist this hash
 size_t HashSetOfStrings(const std::unordered_set<std::string>& set)
 {
-    size_t seed = set.size();
+    size_t sum = 0;
     for (const auto& s : set) {
+        size_t seed = 0;
         for (char c : s) {
             seed ^= c + 0x9e3779b9 + (seed << 6) + (seed >> 2);
         }
+        sum += seed;
     }
-    return seed;
+    return sum ^ (set.size() + 0x9e3779b9 + (sum << 6) + (sum >> 2));
+}
+
+namespace {
+
+// How long a native route's comparison with the SDK is trusted, and how many are kept
+const ULONGLONG kRouteCheckMaxAgeMs = 10 * 60 * 1000;
+const size_t kMaxRouteChecks = 4096;
+
+std::string SnapshotPath()
+{
+    return GetPluginFilePath("LOAPlugin.snapshot");
+}
+
+size_t MixHash(size_t seed, size_t v)
+{
+    return seed ^ (v + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+// What a snapshot record must still match to be restored at all
+uint64_t SnapshotRouteFingerprint(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    const auto& fpd = fp.GetFlightPlanData();
+    std::hash<std::string> hashString;
+    size_t hash = MixHash(hashString(fpd.GetOrigin()), hashString(fpd.GetDestination()));
+    return MixHash(hash, hashString(fpd.GetRoute()));
+}
+
+// The rest of what the match read; a restored match is only current if this
+// is unchanged too (never 0, which marks a record saved stale)
+uint64_t SnapshotContextHash(const EuroScopePlugIn::CFlightPlan& fp, size_t onlineHash)
+{
+    size_t hash = MixHash(std::hash<std::string>()(fp.GetTrackingControllerId()), (size_t)fp.GetClearedAltitude());
+    hash = MixHash(hash, loaPredicates.FlightFingerprint(fp));
+    hash = MixHash(hash, onlineHash);
+    return hash ? hash : 1;
+}
+
+} // namespace
+
+std::string GetPluginDirectory()
+{
+    char dllPath[MAX_PATH];
+    GetModuleFileNameA(HINSTANCE(&__ImageBase), dllPath, sizeof(dllPath));
+
+    std::string basePath(dllPath);
+    size_t lastSlash = basePath.find_last_of("\\/");
+    return (lastSlash != std::string::npos) ? basePath.substr(0, lastSlash) : ".";
+}
+
+std::string GetPluginFilePath(const std::string& relative)
+{
+#ifdef _WIN32
+    const char separator = '\\';
+#else
+    const char separator = '/';
+#endif
+    std::string path = GetPluginDirectory() + separator + relative;
+    std::replace_if(path.begin() + (path.size() - relative.size()), path.end(),
+        [](char c) { return c == '\\' || c == '/'; }, separator);
+    return path;
 }
 
-std::vector<LOAEntry> destinationLoas;
-std::vector<LOAEntry> departureLoas;
-std::vector<LOAEntry> lorArrivals;
-std::vector<LOAEntry> lorDepartures;
-std::vector<LOAEntry> fallbackLoas;
+uint64_t loadedConfigHash = 0;
+
+std::unordered_map<std::string, std::string> controllerFrequencies;
+std::unordered_map<std::string, std::pair<std::string, std::string>> handoffTargets;
 
 int nextFunctionId = 1000;
 
 LOAPlugin::LOAPlugin()
     : CPlugIn(COMPATIBILITY_CODE, "LOA Plugin", "1.1", "Author", "LOA Plugin")
 {
-    static bool registered = false;
-    if (!registered) {
-        RegisterTagItemType("LOA XFL", 1996);
-        RegisterTagItemType("LOA XFL Detailed", 2000);
-        RegisterTagItemType("COP", 1997);
-        registered = true;
-    }
+    auto start = std::chrono::steady_clock::now();
 
-    std::string sector = ControllerMyself().GetPositionId();
-    if (!sector.empty()) {
-        LoadLOAsFromJSON();
-    }
+    RegisterTagItemType("LOA XFL", 1996);
+    RegisterTagItemType("LOA XFL Detailed", 2000);
+    RegisterTagItemType("COP", 1997);
+    RegisterTagItemType("LOA Next Sector", ItemCodes::CUSTOM_TAG_NEXT_SECTOR);
+    RegisterTagItemFunction("LOA Handoff to Next Sector", ItemCodes::CUSTOM_FUNC_HANDOFF_NEXT_SECTOR);
+
+    // The sector files are read once EuroScope is idle (see OnTimer)
+    constructedAt = std::chrono::steady_clock::now();
+    startup.constructMs = std::chrono::duration<double, std::milli>(constructedAt - start).count();
 }
 
 void LOAPlugin::OnControllerPositionUpdate(EuroScopePlugIn::CController controller)
 {
-    // Example: reload LOAs when controller position changes
+    if (loaTrace.IsRecording()) TraceController(LOA_TRACE_CONTROLLER_UPDATE, controller);
+
+    // Our own position changed: load its sector file (and bandbox)
     std::string sector = controller.GetPositionId();
-    if (!sector.empty() && sector != this->loadedSector) {
+    if (!sector.empty() && sector != this->loadedSector && strcmp(controller.GetCallsign(), ControllerMyself().GetCallsign()) == 0) {
         LoadLOAsFromJSON();
     }
+
+    if (!sector.empty() && IsSectorController(controller)) UpdateControllerFrequency(controller);
+
+    // A sector coming online only affects the flights indexed against it
+    if (!sector.empty() && IsSectorController(controller) && cachedOnlineControllers.insert(sector).second) {
+        cachedOnlineControllersHash = HashSetOfStrings(cachedOnlineControllers);
+        OnSectorOnlineChanged(sector);
+    }
 }
 
-LOAPlugin::~LOAPlugin() {}
+void LOAPlugin::OnControllerDisconnect(EuroScopePlugIn::CController controller)
+{
+    if (loaTrace.IsRecording()) TraceController(LOA_TRACE_CONTROLLER_DISCONNECT, controller);
+
+    std::string sector = controller.GetPositionId();
+    if (sector.empty() || !IsSectorController(controller) || !cachedOnlineControllers.count(sector)) return;
+
+    // Another controller may still be covering the same position
+    for (EuroScopePlugIn::CController c = ControllerSelectFirst(); c.IsValid(); c = ControllerSelectNext(c)) {
+        if (sector == c.GetPositionId() && strcmp(c.GetCallsign(), controller.GetCallsign()) != 0 && IsSectorController(c))
+            return;
+    }
+
+    cachedOnlineControllers.erase(sector);
+    controllerFrequencies.erase(sector);
+    cachedOnlineControllersHash = HashSetOfStrings(cachedOnlineControllers);
+    OnSectorOnlineChanged(sector);
+}
+
+LOAPlugin::~LOAPlugin()
+{
+    if (configLoadWorker.joinable()) configLoadWorker.join();
+    snapshot.Close();
+    resultExport.Stop();
+    loaShadow.Stop();
+    loaTrace.Stop();
+    loaLog.Stop();
+}
 
-void LOAPlugin::LoadLOAsFromJSON() {
+void InstallLOAConfig(LoaPreparedConfig& config)
+{
+    destinationLoas = std::move(config.destination);
+    departureLoas = std::move(config.departure);
+    lorArrivals = std::move(config.lorArrivals);
+    lorDepartures = std::move(config.lorDepartures);
+    fallbackLoas = std::move(config.fallback);
+    IndexLoaWaypoints();
+    loaPredicates.Compile();
+    loaGeometry.Build(config.boundaries, config.cops);
+    loaActivation.Rebuild(LoaUtcNow());
+    if (plugin) plugin->matchMemo.Clear();  // memoized matches point into the replaced lists
+    if (loaShadow.IsRunning()) loaShadow.SetRules();
+    loadedConfigHash = HashLoaConfig(config.hashed);
+}
+
+bool LoadLOAConfigFiles(const std::vector<std::string>& filePaths, const std::vector<std::string>& ownedSectors,
+    std::string& error, LoaMergeReport* report)
+{
+    LoaPreparedConfig config;
+    if (!PrepareLOAConfigFiles(filePaths, ownedSectors, config, error, report)) return false;
+    InstallLOAConfig(config);
+    return true;
+}
+
+bool LoadLOAConfigFile(const std::string& filePath, std::string& error)
+{
+    return LoadLOAConfigFiles({ filePath }, {}, error);
+}
+
+std::vector<std::string> GetOwnedSectors(const std::string& position, const std::vector<std::string>& overrideSectors)
+{
+    std::vector<std::string> sectors = { position };
+    std::vector<std::string> extra = overrideSectors;
+
+    // loa_configs_json\bandboxes.json: { "EDYY_J": ["EDYY_H", "EDYY_B"], ... }
+    if (extra.empty()) {
+        std::ifstream inFile(GetPluginFilePath("loa_configs_json\\bandboxes.json"));
+        if (inFile.is_open()) {
+            try {
+                json bandboxes = json::parse(inFile);
+                if (bandboxes.contains(position)) extra = bandboxes[position].get<std::vector<std::string>>();
+            }
+            catch (const std::exception& e) {
+                LOA_LOG_ERROR("bandboxes.json: %s", e.what());
+            }
+        }
+    }
+
+    for (const auto& s : extra)
+        if (std::find(sectors.begin(), sectors.end(), s) == sectors.end()) sectors.push_back(s);
+    return sectors;
+}
+
+void LOAPlugin::LoadLOAsFromJSON(bool force) {
+    // Before the first timer callback EuroScope is still starting up; the timer
+    // starts the first load. One load at a time: the timer starts the next one
+    // if our position moved on meanwhile.
+    if (configLoad) configReloadWanted = configReloadWanted || force;
+    if (!idleReached || configLoad) return;
+    // Our position first: bandboxes.json and the sector files are only read
+    // when it changed (or when ".loa sectors" or ".loa airways" forces a reload)
     std::string mySector = ControllerMyself().GetPositionId();
-    if (mySector.empty() || mySector == this->loadedSector) return;
-    this->loadedSector = mySector;
+    if (mySector.empty() || (mySector == this->loadedSector && !force)) return;
 
-    char dllPath[MAX_PATH];
-    GetModuleFileNameA(HINSTANCE(&__ImageBase), dllPath, sizeof(dllPath));
+    configLoad.reset(new ConfigLoad());
+    configLoad->sector = mySector;
+    configLoadReady = false;
+    if (configLoadWorker.joinable()) configLoadWorker.join();
 
-    std::string basePath(dllPath);
-    size_t lastSlash = basePath.find_last_of("\\/");
-    basePath = (lastSlash != std::string::npos) ? basePath.substr(0, lastSlash) : ".";
-    std::string filePath = basePath + "\\loa_configs_json\\" + mySector + ".json";
+    ConfigLoad* load = configLoad.get();
+    std::vector<std::string> overrideSectors = ownedSectorsOverride;
+    std::string airwayPath = airwayFile.empty() ? GetPluginFilePath("loa_configs_json\\airways.sct") : airwayFile;
+    bool airwayFileSet = !airwayFile.empty();
+    configLoadWorker = std::thread([this, load, overrideSectors, airwayPath, airwayFileSet]() {
+        auto start = std::chrono::steady_clock::now();
+        load->sectors = GetOwnedSectors(load->sector, overrideSectors);
+        for (const auto& s : load->sectors)
+            load->filePaths.push_back(GetPluginFilePath("loa_configs_json\\" + s + ".json"));
+        auto parsed = std::chrono::steady_clock::now();
+        load->ok = PrepareLOAConfigFiles(load->filePaths, load->sectors, load->config, load->error, &load->report);
+        load->discoverMs = std::chrono::duration<double, std::milli>(parsed - start).count();
+        load->parseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parsed).count();
+        if (airwayFileSet || std::ifstream(airwayPath).good())
+            load->airwaysOk = load->airways.Load(airwayPath, load->airwaysError);
+        configLoadReady.store(true, std::memory_order_release);
+    });
+}
 
-    std::ifstream inFile(filePath);
-    if (!inFile.is_open()) {
-        DisplayUserMessage("LOA Plugin", "JSON Load Error", ("Cannot open: " + filePath).c_str(), true, true, true, true, false);
+void LOAPlugin::InstallConfigLoad() {
+    configLoadWorker.join();
+    std::unique_ptr<ConfigLoad> load = std::move(configLoad);
+
+    // Airways do not depend on the sectors: installed even when the rules stay
+    if (load->airwaysOk) {
+        loaAirways = std::move(load->airways);
+        nativeRouteChecks.clear();
+        routeCache.clear();
+        routeCacheTime.clear();
+        LOA_LOG_INFO("Airways %s: %zu points, %zu airways, %zu links", loaAirways.GetPath().c_str(),
+            loaAirways.NodeCount(), loaAirways.AirwayCount(), loaAirways.LinkCount());
+    }
+    else if (!load->airwaysError.empty()) {
+        LOA_LOG_WARN("Airways not loaded: %s", load->airwaysError.c_str());
+    }
+
+    // The same sectors again (".loa sectors" unchanged): keep what is loaded
+    if (load->sector == this->loadedSector && load->sectors == this->loadedSectors) return;
+    this->loadedSector = load->sector;
+    this->loadedSectors = load->sectors;
+
+    const std::string& mySector = load->sector;
+    const std::vector<std::string>& sectors = load->sectors;
+    const std::string& filePath = load->filePaths.front();
+    const LoaMergeReport& report = load->report;
+    if (!load->ok) {
+        LOA_LOG_ERROR("JSON load error: %s", load->error.c_str());
         return;
     }
 
-    json config;
-    try {
-        inFile >> config;
+    auto installStart = std::chrono::steady_clock::now();
+    InstallLOAConfig(load->config);
+
+    // A snapshot left by the last session is picked up once there are rules
+    // to resolve its results against
+    if (!snapshot.IsOpen() && std::ifstream(SnapshotPath()).good() && snapshot.Open(SnapshotPath())) {
+        LOA_LOG_INFO("Snapshot %s: %s", SnapshotPath().c_str(), snapshot.IsRestoring() ?
+            (snapshot.RestoreConfigHash() == loadedConfigHash ? "restoring" : "restoring coordination only (rules changed)") : "empty");
     }
-    catch (const std::exception& e) {
-        DisplayUserMessage("LOA Plugin", "JSON Parse Error", e.what(), true, true, true, true, false);
-        return;
+    for (const auto& missing : report.missing)
+        LOA_LOG_WARN("Bandbox sector file not found: %s", missing.c_str());
+    if (sectors.size() > 1) {
+        LOA_LOG_INFO("Bandbox of %zu sectors: %zu rules read, %zu duplicates and %zu internal handoffs dropped",
+            sectors.size(), report.rules, report.duplicates, report.internal);
     }
 
-    destinationLoas.clear();
-    departureLoas.clear();
-    lorArrivals.clear();
-    lorDepartures.clear();
-    fallbackLoas.clear();
+    // Cached results point into the lists that were just replaced
+    matchedLOACache.clear();
+    matchTimestamps.clear();
+    altitudeProfiles.clear();
+    currentFrameMatchedLOA = nullptr;
+    currentFrameTimestamp = 0;  // the next tag callback matches again
 
-    auto processAirportList = [](const std::vector<std::string>& list,
-        std::unordered_set<std::string>& exact,
-        std::vector<std::string>& prefixes)
-        {
-            for (const std::string& a : list) {
-                if (a.length() == 4) exact.insert(a);
-                else prefixes.push_back(a);
-            }
-        };
-
-    auto parseLOAList = [&](const json& array, bool isFallback = false) {
-        std::vector<LOAEntry> result;
-        for (const auto& item : array) {
-            LOAEntry loa;
-            if (item.contains("origins")) {
-                loa.originAirports = item["origins"].get<std::vector<std::string>>();
-                processAirportList(loa.originAirports, loa.originAirportSet, loa.originAirportPrefixes);
-            }
-            if (item.contains("destinations")) {
-                loa.destinationAirports = item["destinations"].get<std::vector<std::string>>();
-                processAirportList(loa.destinationAirports, loa.destinationAirportSet, loa.destinationAirportPrefixes);
-            }
-            if (item.contains("waypoints")) loa.waypoints = item["waypoints"].get<std::vector<std::string>>();
-            if (item.contains("nextSectors")) loa.nextSectors = item["nextSectors"].get<std::vector<std::string>>();
-            if (item.contains("copText")) loa.copText = item["copText"].get<std::string>();
-            if (item.contains("requireNextSectorOnline")) loa.requireNextSectorOnline = item["requireNextSectorOnline"].get<bool>();
-            if (item.contains("xfl")) loa.xfl = item["xfl"].get<int>();
-            if (item.contains("minAltitudeFt")) loa.minAltitudeFt = item["minAltitudeFt"].get<int>();
-            result.push_back(loa);
-        }
-        return result;
-        };
+    // Prefer a ruleset compiled from exactly this file (see LoaCompiled.h);
+    // generated code has no flight conditions
+    activeCompiledRuleset = useCompiledRulesets && !loaPredicates.UsesFlightConditions() ?
+        FindCompiledRuleset(mySector, loadedConfigHash) : nullptr;
+    LOA_LOG_INFO("%s: %s", mySector.c_str(), activeCompiledRuleset ? "using compiled ruleset" : "using JSON interpreter");
 
-    if (config.contains("destinationLoas")) destinationLoas = parseLOAList(config["destinationLoas"]);
-    if (config.contains("departureLoas")) departureLoas = parseLOAList(config["departureLoas"]);
-    if (config.contains("lorArrivals")) lorArrivals = parseLOAList(config["lorArrivals"]);
-    if (config.contains("lorDepartures")) lorDepartures = parseLOAList(config["lorDepartures"]);
-    if (config.contains("fallbackLoas")) fallbackLoas = parseLOAList(config["fallbackLoas"], true);
+    LOA_LOG_INFO("Loaded %s: destination=%zu departure=%zu lorArrivals=%zu lorDepartures=%zu fallback=%zu",
+        filePath.c_str(), destinationLoas.size(), departureLoas.size(), lorArrivals.size(), lorDepartures.size(), fallbackLoas.size());
 
-    DisplayUserMessage("LOA Plugin", "LOA Load Success", ("LOAs loaded for sector: " + mySector).c_str(), true, true, true, true, false);
+    size_t total = destinationLoas.size() + departureLoas.size() + lorArrivals.size() + lorDepartures.size() + fallbackLoas.size();
+    std::string loadedFor = mySector;
+    for (size_t i = 1; i < sectors.size(); ++i) loadedFor += "+" + sectors[i];
+    DisplayUserMessage("LOA Plugin", "LOA Load Success", ("LOAs loaded for sector: " + loadedFor + " (" + std::to_string(total) + " rules)").c_str(), true, true, true, true, false);
+
+    if (!startup.complete) {
+        auto now = std::chrono::steady_clock::now();
+        startup.discoverMs = load->discoverMs;
+        startup.parseMs = load->parseMs;
+        startup.installMs = std::chrono::duration<double, std::milli>(now - installStart).count();
+        startup.totalMs = std::chrono::duration<double, std::milli>(now - constructedAt).count();
+        startup.complete = true;
+        LOA_LOG_INFO("Startup: construct %.2f ms, first timer after %.0f ms, discovery %.2f ms + parse %.2f ms (worker), "
+            "install %.2f ms, rules ready %.0f ms after construction", startup.constructMs, startup.idleWaitMs,
+            startup.discoverMs, startup.parseMs, startup.installMs, startup.totalMs);
+    }
 }
 
 bool LOAPlugin::IsLOARelevantState(int state) {
@@ -166,23 +370,346 @@ bool LOAPlugin::IsLOARelevantState(int state) {
 const std::unordered_set<std::string>& LOAPlugin::GetOnlineControllersCached()
 {
     ULONGLONG currentTime = GetTickCount64();
-    if (currentTime - lastOnlineFetchTime > 5000 || cachedOnlineControllers.empty()) {
-        cachedOnlineControllers.clear();
+    if (currentTime - lastOnlineFetchTime > 5000 || !onlineFetched) {
+        std::unordered_set<std::string> previous;
+        previous.swap(cachedOnlineControllers);
+        controllerFrequencies.clear();
         for (EuroScopePlugIn::CController c = ControllerSelectFirst(); c.IsValid(); c = ControllerSelectNext(c)) {
-            std::string callsign = c.GetCallsign();
-            if (!callsign.empty() &&   // ✅ Only if callsign exists
-                (callsign.find("_CTR") != std::string::npos ||
-                    callsign.find("_APP") != std::string::npos)) {  // ✅ Only CTR/APP
+            if (IsSectorController(c)) {
                 cachedOnlineControllers.insert(c.GetPositionId());
+                UpdateControllerFrequency(c);
             }
         }
         lastOnlineFetchTime = currentTime;
 
         cachedOnlineControllersHash = HashSetOfStrings(cachedOnlineControllers);  // if you use controller hash caching
+
+        // Safety net for transitions the controller callbacks did not report.
+        // The first fetch only establishes the set: nothing was matched against
+        // a different one yet, so there is nothing to re-evaluate or forget.
+        if (!onlineFetched) {
+            onlineFetched = true;
+            return cachedOnlineControllers;
+        }
+        std::vector<std::string> changed;
+        for (const auto& s : cachedOnlineControllers)
+            if (!previous.count(s)) changed.push_back(s);
+        for (const auto& s : previous)
+            if (!cachedOnlineControllers.count(s)) changed.push_back(s);
+        for (const auto& s : changed)
+            OnSectorOnlineChanged(s);
     }
     return cachedOnlineControllers;
 }
 
+bool LOAPlugin::IsSectorController(EuroScopePlugIn::CController& controller)
+{
+    std::string callsign = controller.GetCallsign();
+    return !callsign.empty() &&   // ✅ Only if callsign exists
+        (callsign.find("_CTR") != std::string::npos ||
+            callsign.find("_APP") != std::string::npos);  // ✅ Only CTR/APP
+}
+
+void LOAPlugin::UpdateControllerFrequency(EuroScopePlugIn::CController& controller)
+{
+    double frequency = controller.GetPrimaryFrequency();
+    if (frequency < 100.0 || frequency > 199.0) return;  // 199.998 = observer / no frequency
+
+    char text[16];
+    snprintf(text, sizeof(text), "%.3f", frequency);
+    controllerFrequencies[controller.GetPositionId()] = text;
+}
+
+void LOAPlugin::SetFlightSectorDependencies(const std::string& callsign, const std::vector<std::string>& sectors)
+{
+    auto& current = flightSectorDependencies[callsign];
+    if (current == sectors) return;
+
+    for (const auto& s : current) {
+        auto it = sectorDependents.find(s);
+        if (it == sectorDependents.end()) continue;
+        it->second.erase(callsign);
+        if (it->second.empty()) sectorDependents.erase(it);
+    }
+    for (const auto& s : sectors)
+        sectorDependents[s].insert(callsign);
+
+    if (sectors.empty()) flightSectorDependencies.erase(callsign);
+    else current = sectors;
+}
+
+void LOAPlugin::OnSectorOnlineChanged(const std::string& sectorId)
+{
+    stats.controllerEvents++;
+    stats.lastEventReevaluations = 0;
+    onlineSectorGeneration++;  // memoized matches saw the old online set
+
+    auto it = sectorDependents.find(sectorId);
+    if (it == sectorDependents.end()) return;
+
+    // Copy first: cleanup rewrites the index we are iterating
+    std::vector<std::string> affected(it->second.begin(), it->second.end());
+    for (const auto& callsign : affected) {
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+        if (!fp.IsValid()) {
+            CleanupCache(callsign);
+            continue;
+        }
+        matchTimestamps.erase(callsign);
+        scheduler.Request(callsign, LOA_URGENCY_ROUTINE);
+        stats.lastEventReevaluations++;
+    }
+    stats.controllerEventReevaluations += stats.lastEventReevaluations;
+}
+
+void LOAPlugin::OnRulesActivationChanged(const std::vector<const LOAEntry*>& changed)
+{
+    activationGeneration++;  // tag altitude tables
+    matchMemo.Clear();
+    if (loaShadow.IsRunning()) loaShadow.SetRules();
+
+    // Only flights whose match a changed rule could take or give up
+    std::vector<std::string> callsigns;
+    for (const auto& cached : matchedLOACache) callsigns.push_back(cached.first);
+
+    for (const auto& callsign : callsigns) {
+        const LOAEntry* current = matchedLOACache[callsign];
+        bool affected = current && !current->active;
+
+        // A level change reads the table back without matching: an entry that
+        // changed must not be left behind for another altitude band
+        auto profile = altitudeProfiles.find(callsign);
+        bool tabulated = profile != altitudeProfiles.end() && profile->second.match.IsBuilt();
+        if (!affected && tabulated)
+            affected = std::any_of(changed.begin(), changed.end(), [&](const LOAEntry* e) { return profile->second.match.Contains(e); });
+
+        if (!affected) {
+            EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+            if (!fp.IsValid()) {
+                CleanupCache(callsign);
+                continue;
+            }
+            std::string origin = fp.GetFlightPlanData().GetOrigin();
+            std::string destination = fp.GetFlightPlanData().GetDestination();
+            affected = std::any_of(changed.begin(), changed.end(), [&](const LOAEntry* e) {
+                if (!e->active) return false;
+                bool fallback = LocateLoaEntry(e).list == LOA_LIST_FALLBACK;  // fallbacks ignore the origin
+                return (fallback || e->originAirports.empty() || MatchesAirport(e->originAirportSet, e->originAirportPrefixes, origin)) &&
+                    (e->destinationAirports.empty() || MatchesAirport(e->destinationAirportSet, e->destinationAirportPrefixes, destination));
+            });
+        }
+
+        if (affected) {
+            if (tabulated) profile->second.match.Reset();
+            matchTimestamps.erase(callsign);
+            scheduler.Request(callsign, LOA_URGENCY_ROUTINE);
+            stats.activationReevaluations++;
+        }
+    }
+}
+
+const LOAEntry* LOAPlugin::EvaluateNow(const EuroScopePlugIn::CFlightPlan& fp, bool inlineRun)
+{
+    auto start = std::chrono::steady_clock::now();
+    matchTimestamps.erase(fp.GetCallsign());
+    // Inline runs are for the flight whose tag is being drawn: its route is already scanned
+    bool frameFlight = inlineRun && currentFrameCallsign == fp.GetCallsign();
+    const LOAEntry* result = MatchLoaEntry(fp, GetOnlineControllersCached(), frameFlight ? &currentFrameRoute : nullptr);
+    LoaViewClass view = inlineRun ? currentFrameView : visibility.Classify(fp, false, GetTickCount64());
+    if (view == LOA_VIEW_CULLED) stats.evaluationsCulled++;
+    else stats.evaluationsInView++;
+    scheduler.Charge(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), inlineRun);
+    return result;
+}
+
+const LOAEntry* LOAPlugin::GetScheduledMatch(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    // Same cheap gates as MatchLoaEntry: these flights never get a cached result
+    if (!fp.IsValid() || !IsLOARelevantState(fp.GetState())) return nullptr;
+    if (_stricmp(fp.GetFlightPlanData().GetPlanType(), "I") != 0) return nullptr;
+
+    const std::string callsign = fp.GetCallsign();
+    auto cached = matchedLOACache.find(callsign);
+    auto ts = matchTimestamps.find(callsign);
+    if (cached != matchedLOACache.end() && ts != matchTimestamps.end() && GetTickCount64() - ts->second < 5000)
+        return MatchLoaEntry(fp, GetOnlineControllersCached());  // cached, re-read at the current level
+
+    // Out of view (a list entry): the last result while it is young enough and
+    // nothing invalidated it, then one evaluation if the frame can afford it.
+    // Never queued; the next tag callback tries again.
+    if (currentFrameView == LOA_VIEW_CULLED) {
+        if (cached != matchedLOACache.end() && ts != matchTimestamps.end() &&
+            GetTickCount64() - ts->second < visibility.culledRefreshMs) {
+            stats.culledStale++;
+            return cached->second;
+        }
+        if (cached != matchedLOACache.end() && !scheduler.CanRunInline()) return cached->second;
+        scheduler.Remove(callsign);
+        return EvaluateNow(fp, true);
+    }
+
+    // A flight with nothing to show yet (first tag, just assumed) is matched
+    // now whatever the budget; only refreshes of a known result wait
+    if (cached == matchedLOACache.end() || scheduler.CanRunInline()) {
+        scheduler.Remove(callsign);
+        return EvaluateNow(fp, true);
+    }
+
+    // Over budget: keep showing the last good result until the queue gets here
+    scheduler.Request(callsign, LOA_URGENCY_VISIBLE);
+    return cached->second;
+}
+
+const LoaFlightProfile& LOAPlugin::GetAltitudeProfile(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    return GetAltitudeProfile(fp, lastTagData, currentFrameOnlineControllers, currentFrameRoute,
+        currentFrameView == LOA_VIEW_CULLED ? visibility.culledRefreshMs : 5000);
+}
+
+size_t LOAPlugin::AltitudeProfileKey(const EuroScopePlugIn::CFlightPlan& fp, const CachedTagData& data)
+{
+    // Every input of the tag tables except the cleared altitude
+    size_t key = std::hash<std::string>()(data.origin);
+    auto mix = [&](size_t v) { key ^= v + 0x9e3779b9 + (key << 6) + (key >> 2); };
+    mix(std::hash<std::string>()(data.destination));
+    const auto& fpd = fp.GetFlightPlanData();
+    mix(std::hash<std::string>()(fpd.GetRoute()));
+    mix(std::hash<std::string>()(fpd.GetSidName()));   // expand into the extracted route
+    mix(std::hash<std::string>()(fpd.GetStarName()));
+    mix(std::hash<std::string>()(fp.GetControllerAssignedData().GetDirectToPointName()));
+    mix((size_t)data.finalAltitude);
+    mix(cachedOnlineControllersHash);
+    mix((size_t)loadedConfigHash);
+    mix((size_t)activationGeneration);
+    mix(loaPredicates.FlightFingerprint(fp));
+    return key;
+}
+
+const LoaFlightProfile& LOAPlugin::GetAltitudeProfile(const EuroScopePlugIn::CFlightPlan& fp, const CachedTagData& data,
+    const std::unordered_set<std::string>& onlineControllers, LoaRouteWaypoints& route, ULONGLONG maxAgeMs)
+{
+    size_t key = AltitudeProfileKey(fp, data);
+    ULONGLONG now = GetTickCount64();
+    LoaFlightProfile& profile = altitudeProfiles[data.callsign];
+    if (!profile.xfl.IsBuilt() || profile.key != key || now - profile.builtAt > maxAgeMs) {
+        profile.key = key;
+        profile.builtAt = now;
+        BuildTagAltitudeTables(profile, fp, data.origin, data.destination, data.finalAltitude,
+            onlineControllers, route);
+        stats.altitudeProfileBuilds++;
+    }
+    return profile;
+}
+
+size_t LOAPlugin::ExitEstimateKey(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    size_t key = std::hash<std::string>()(fp.GetFlightPlanData().GetRoute());
+    auto mix = [&](size_t v) { key ^= v + 0x9e3779b9 + (key << 6) + (key >> 2); };
+    mix(std::hash<std::string>()(fp.GetControllerAssignedData().GetDirectToPointName()));
+    mix((size_t)loaGeometry.Generation());
+    return key;
+}
+
+const std::string* LOAPlugin::GetGeometricCop(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    if (!loaGeometry.IsLoaded()) return nullptr;
+
+    // Rerun only when the route text, a direct-to, the geometry or the route
+    // point the flight is nearest to changes. The last extraction's points
+    // answer the last one, so the route is only extracted to rerun.
+    size_t key = ExitEstimateKey(fp);
+
+    auto toGeo = [](const EuroScopePlugIn::CPosition& p) {
+        LoaGeoPoint g;
+        g.lat = p.m_Latitude;
+        g.lon = p.m_Longitude;
+        return g;
+    };
+    LoaGeoPoint position = toGeo(fp.GetFPTrackPosition());
+
+    LoaExitEstimate& estimate = exitEstimates[fp.GetCallsign()];
+    if (estimate.computed && estimate.key == key &&
+        loaGeometry.NearestVertex(estimate.routePoints, position) == estimate.nearestPoint) {
+        stats.exitEstimateHits++;
+        return estimate.found ? &estimate.cop : nullptr;
+    }
+
+    EuroScopePlugIn::CFlightPlanExtractedRoute route = fp.GetExtractedRoute();
+    int points = route.GetPointsNumber();
+    estimate.routePoints.clear();
+    for (int i = 0; i < points; ++i) estimate.routePoints.push_back(toGeo(route.GetPointPosition(i)));
+    estimate.nearestPoint = loaGeometry.NearestVertex(estimate.routePoints, position);
+    estimate.key = key;
+    estimate.computed = true;
+    estimate.found = false;
+    stats.exitEstimates++;
+
+    const LoaNamedPoint* cop = loaGeometry.RouteExitCop(estimate.routePoints, position,
+        route.GetPointsCalculatedIndex(), route.GetPointsAssignedIndex(), estimate.exit);
+    if (!cop) return nullptr;
+    estimate.found = true;
+    estimate.cop = cop->name;
+    return &estimate.cop;
+}
+
+void LOAPlugin::RunScheduledEvaluations(bool idle)
+{
+    std::string callsign;
+    while (scheduler.HasBudget() && scheduler.PopNext(callsign, idle ? LOA_URGENCY_WARMUP : LOA_URGENCY_ROUTINE)) {
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+        if (!fp.IsValid()) continue;
+        if (visibility.Classify(fp, false, GetTickCount64()) == LOA_VIEW_CULLED) {
+            // Its timestamp is already gone, so a list asking for it re-evaluates
+            warmFlights.erase(callsign);
+            stats.culledDropped++;
+            continue;
+        }
+        if (renderedFlights.count(callsign)) EvaluateNow(fp, false);
+        else WarmUp(fp);
+    }
+}
+
+bool LOAPlugin::HasFreshMatch(const std::string& callsign, ULONGLONG maxAgeMs)
+{
+    auto ts = matchTimestamps.find(callsign);
+    return ts != matchTimestamps.end() && GetTickCount64() - ts->second < maxAgeMs && matchedLOACache.count(callsign);
+}
+
+void LOAPlugin::RequestWarmup(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    if (_stricmp(fp.GetFlightPlanData().GetPlanType(), "I") != 0) return;
+
+    const std::string callsign = fp.GetCallsign();
+    if (renderedFlights.count(callsign)) return;  // the tag path keeps it fresh from here
+    warmFlights.insert(callsign);
+
+    // Nothing to do while its last result is still fresh
+    if (HasFreshMatch(callsign, 5000) || scheduler.IsQueued(callsign)) return;
+    scheduler.Request(callsign, LOA_URGENCY_WARMUP);
+    stats.warmupRequests++;
+}
+
+void LOAPlugin::WarmUp(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    auto start = std::chrono::steady_clock::now();
+    const std::string callsign = fp.GetCallsign();
+    const auto& fpd = fp.GetFlightPlanData();
+    const auto& onlineControllers = GetOnlineControllersCached();
+
+    // What the first tag callback would do: match, then build the tag tables
+    // from the same route scan. A result that is still fresh is kept, and the
+    // tables are only rebuilt when their key changed or they aged out.
+    LoaRouteWaypoints route;
+    route.Reset(fp);
+    if (!RestoreFromSnapshot(fp)) MatchLoaEntryAnyState(fp, onlineControllers, &route);
+
+    CachedTagData data = { callsign, fp.GetClearedAltitude(), fp.GetFinalAltitude(), fpd.GetOrigin(), fpd.GetDestination() };
+    GetAltitudeProfile(fp, data, onlineControllers, route);
+
+    scheduler.Charge(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count(), false);
+    stats.warmups++;
+}
+
 bool LOAPlugin::IsControllerOnlineCached(const std::string& controllerId, const std::unordered_set<std::string>& onlineControllers)
 {
     return onlineControllers.count(controllerId) > 0;
@@ -214,10 +741,56 @@ const std::vector<std::string>& LOAPlugin::GetCachedRoutePoints(const EuroScopeP
         return routeCache[callsign];
     }
 
-    auto route = fp.GetExtractedRoute();
+    // From the airway graph when it covers the route (see LoaAirways.h)
+    const auto& fpd = fp.GetFlightPlanData();
+    const char* routeText = fpd.GetRoute();
+    size_t routeHash = std::hash<std::string>()(routeText);
+    auto check = nativeRouteChecks.find(routeHash);
+    if (check != nativeRouteChecks.end() && now - check->second.checkedAt >= kRouteCheckMaxAgeMs) {
+        nativeRouteChecks.erase(check);
+        check = nativeRouteChecks.end();
+    }
     std::vector<std::string> routePoints;
-    for (int i = 0; i < route.GetPointsNumber(); ++i)
-        routePoints.emplace_back(route.GetPointName(i));
+    bool native = useNativeRoutes && loaAirways.IsLoaded() && *routeText && !*fpd.GetSidName() && !*fpd.GetStarName() &&
+        (check == nativeRouteChecks.end() || check->second.agreed);
+    if (native) {
+        auto start = std::chrono::steady_clock::now();
+        native = loaAirways.ExpandRoute(routeText, fpd.GetOrigin(), fpd.GetDestination(), routePoints);
+        stats.nativeRouteUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        (native ? stats.nativeRoutes : stats.nativeRoutesUncovered)++;
+    }
+
+    // A route text not compared yet always is, later ones one in routeCheckEvery
+    bool compare = check == nativeRouteChecks.end() || (routeCheckEvery > 0 && (stats.nativeRoutes - 1) % routeCheckEvery == 0);
+    if (!native || compare) {
+        auto start = std::chrono::steady_clock::now();
+        auto route = fp.GetExtractedRoute();
+        std::vector<std::string> extracted;
+        for (int i = 0; i < route.GetPointsNumber(); ++i)
+            extracted.emplace_back(route.GetPointName(i));
+        stats.sdkRouteUs += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        stats.sdkRoutes++;
+
+        if (native && nativeRouteChecks.size() >= kMaxRouteChecks) {
+            for (auto it = nativeRouteChecks.begin(); it != nativeRouteChecks.end();)
+                it = now - it->second.checkedAt >= kRouteCheckMaxAgeMs ? nativeRouteChecks.erase(it) : std::next(it);
+            if (nativeRouteChecks.size() >= kMaxRouteChecks) nativeRouteChecks.clear();
+        }
+        if (native) nativeRouteChecks[routeHash] = { extracted == routePoints, now };
+
+        if (native && extracted == routePoints) {
+            stats.nativeRoutesAgreed++;
+        }
+        else if (native) {
+            stats.nativeRoutesDisagreed++;
+            size_t at = 0;
+            while (at < extracted.size() && at < routePoints.size() && extracted[at] == routePoints[at]) ++at;
+            LOA_LOG_WARN("ROUTE MISMATCH %s: native %zu points, SDK %zu, first difference at %zu (%s/%s): %.120s",
+                callsign.c_str(), routePoints.size(), extracted.size(), at,
+                at < routePoints.size() ? routePoints[at].c_str() : "-", at < extracted.size() ? extracted[at].c_str() : "-", routeText);
+        }
+        routePoints = std::move(extracted);
+    }
 
     routeCache[callsign] = std::move(routePoints);
     routeCacheTime[callsign] = now;
@@ -225,24 +798,222 @@ const std::vector<std::string>& LOAPlugin::GetCachedRoutePoints(const EuroScopeP
     return routeCache[callsign];
 }
 
+bool LOAPlugin::RestoreFromSnapshot(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    if (!snapshot.IsRestoring() || !loadedConfigHash) return false;
+    const std::string callsign = fp.GetCallsign();
+    if (!snapshotProbed.insert(callsign).second) return false;
+
+    const LoaSnapshotRecord* record = snapshot.Find(callsign);
+    if (!record) return false;
+    if (record->routeFingerprint != SnapshotRouteFingerprint(fp)) {
+        stats.snapshotDiscarded++;  // refiled, or another flight under the same callsign
+        return false;
+    }
+
+    // Events since the restart are newer than anything saved
+    if ((record->flags & LOA_SNAPSHOT_COORDINATION) && !coordinationStates.count(callsign)) {
+        CoordinationInfo& info = coordinationStates[callsign];
+        info.exitAltitude = record->exitAltitude;
+        info.exitAltitudeState = record->exitAltitudeState;
+        info.exitPoint.assign(record->exitPoint, strnlen(record->exitPoint, sizeof(record->exitPoint)));
+        info.exitPointState = record->exitPointState;
+        stats.snapshotCoordinations++;
+    }
+
+    if (!(record->flags & LOA_SNAPSHOT_MATCH) || snapshot.RestoreConfigHash() != loadedConfigHash ||
+        matchedLOACache.count(callsign)) return false;
+    const LOAEntry* entry = record->ruleId < 0 ? nullptr : ResolveLoaMatch({ record->ruleId >> 16, record->ruleId & 0xFFFF });
+    if (record->ruleId >= 0 && (!entry || !entry->active)) {
+        stats.snapshotDiscarded++;
+        return false;
+    }
+
+    // Shown either way; only a current one counts as evaluated, a stale one
+    // is re-evaluated when the scheduler gets to it
+    matchedLOACache[callsign] = entry;
+    if (record->contextHash != SnapshotContextHash(fp, cachedOnlineControllersHash)) {
+        stats.snapshotStale++;
+        return false;
+    }
+    matchTimestamps[callsign] = GetTickCount64();
+    stats.snapshotFresh++;
+    return true;
+}
+
+void LOAPlugin::CheckpointSnapshot()
+{
+    ULONGLONG now = GetTickCount64();
+    std::unordered_set<std::string> callsigns;
+    for (const auto& cached : matchedLOACache) callsigns.insert(cached.first);
+    for (const auto& coordination : coordinationStates) callsigns.insert(coordination.first);
+
+    std::vector<LoaSnapshotRecord> records;
+    records.reserve(callsigns.size());
+    for (const auto& callsign : callsigns) {
+        if (callsign.size() >= sizeof(LoaSnapshotRecord::callsign)) continue;
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(callsign.c_str());
+        if (!fp.IsValid()) continue;
+
+        LoaSnapshotRecord record;
+        memset(&record, 0, sizeof(record));
+        memcpy(record.callsign, callsign.c_str(), callsign.size());
+        record.routeFingerprint = SnapshotRouteFingerprint(fp);
+        record.ruleId = -1;
+
+        auto match = matchedLOACache.find(callsign);
+        LoaMatchRef ref = match != matchedLOACache.end() ? LocateLoaEntry(match->second) : LoaMatchRef{ LOA_LIST_NONE, -1 };
+        if (match != matchedLOACache.end() && (!match->second || ref.list != LOA_LIST_NONE)) {
+            record.flags |= LOA_SNAPSHOT_MATCH;
+            if (match->second) record.ruleId = (ref.list << 16) | ref.index;
+            // Older results are saved for display only
+            auto ts = matchTimestamps.find(callsign);
+            if (ts != matchTimestamps.end() && now - ts->second < 5000)
+                record.contextHash = SnapshotContextHash(fp, cachedOnlineControllersHash);
+        }
+
+        auto coordination = coordinationStates.find(callsign);
+        if (coordination != coordinationStates.end()) {
+            record.flags |= LOA_SNAPSHOT_COORDINATION;
+            record.exitAltitude = coordination->second.exitAltitude;
+            record.exitAltitudeState = coordination->second.exitAltitudeState;
+            strncpy(record.exitPoint, coordination->second.exitPoint.c_str(), sizeof(record.exitPoint) - 1);
+            record.exitPointState = coordination->second.exitPointState;
+        }
+        records.push_back(record);
+    }
+
+    snapshot.Checkpoint(std::move(records), loadedConfigHash, LoaUtcNow());
+    if (!snapshot.IsRestoring()) snapshotProbed.clear();
+}
+
 void LOAPlugin::CleanupCache(const std::string& callsign) {
     matchedLOACache.erase(callsign);
     routeCache.erase(callsign);
     routeCacheTime.erase(callsign);
+    SetFlightSectorDependencies(callsign, {});
+    scheduler.Remove(callsign);
+    handoffTargets.erase(callsign);
+    altitudeProfiles.erase(callsign);
+    exitEstimates.erase(callsign);
+    resultExport.Remove(callsign);
+    renderedFlights.erase(callsign);
+    warmFlights.erase(callsign);
+}
+
+void LOAPlugin::TraceFlight(int recordType, EuroScopePlugIn::CFlightPlan& fp, const int* extra, int extraCount)
+{
+    const auto& fpd = fp.GetFlightPlanData();
+
+    LoaTraceFlight f;
+    CopyTraceField(f.callsign, sizeof(f.callsign), fp.GetCallsign());
+    CopyTraceField(f.origin, sizeof(f.origin), fpd.GetOrigin());
+    CopyTraceField(f.destination, sizeof(f.destination), fpd.GetDestination());
+    CopyTraceField(f.trackingController, sizeof(f.trackingController), fp.GetTrackingControllerId());
+    CopyTraceField(f.exitPoint, sizeof(f.exitPoint), fp.GetExitCoordinationPointName());
+    f.planType = fpd.GetPlanType()[0];
+    f.state = (int8_t)fp.GetState();
+    f.exitAltitudeState = (int8_t)fp.GetExitCoordinationAltitudeState();
+    f.exitPointState = (int8_t)fp.GetExitCoordinationNameState();
+    f.clearedAltitude = fp.GetClearedAltitude();
+    f.finalAltitude = fp.GetFinalAltitude();
+    f.exitAltitude = fp.GetExitCoordinationAltitude();
+    CopyTraceField(f.aircraftType, sizeof(f.aircraftType), fpd.GetAircraftFPType());
+    CopyTraceField(f.sid, sizeof(f.sid), fpd.GetSidName());
+    CopyTraceField(f.star, sizeof(f.star), fpd.GetStarName());
+    CopyTraceField(f.squawk, sizeof(f.squawk), fp.GetControllerAssignedData().GetSquawk());
+    f.wakeCategory = fpd.GetAircraftWtc();
+    EuroScopePlugIn::CRadarTarget target = fp.GetCorrelatedRadarTarget();
+    EuroScopePlugIn::CPosition position = target.IsValid() ? target.GetPosition().GetPosition() : fp.GetFPTrackPosition();
+    f.latitude = position.m_Latitude;
+    f.longitude = position.m_Longitude;
+    f.routeTextLength = 0;
+    f.routePointCount = 0;
+
+    // Only what is already cached: extracting here would change what is recorded
+    auto extracted = routeCache.find(fp.GetCallsign());
+    loaTrace.WriteFlight((LoaTraceRecordType)recordType, f, fpd.GetRoute(),
+        extracted != routeCache.end() ? &extracted->second : nullptr, extra, extraCount);
+}
+
+void LOAPlugin::TraceController(int recordType, EuroScopePlugIn::CController& controller)
+{
+    LoaTraceController c;
+    CopyTraceField(c.callsign, sizeof(c.callsign), controller.GetCallsign());
+    CopyTraceField(c.positionId, sizeof(c.positionId), controller.GetPositionId());
+    c.frequency = controller.GetPrimaryFrequency();
+    loaTrace.WriteController((LoaTraceRecordType)recordType, c);
 }
 
 void LOAPlugin::OnFlightPlanStateChange(EuroScopePlugIn::CFlightPlan fp) {
     if (!fp.IsValid()) return;
+    if (loaTrace.IsRecording()) TraceFlight(LOA_TRACE_STATE_CHANGE, fp, nullptr, 0);
 
     int state = fp.GetState();
     if (state == FLIGHT_PLAN_STATE_NON_CONCERNED || state == FLIGHT_PLAN_STATE_REDUNDANT) {
         CleanupCache(fp.GetCallsign());
     }
+    else if (state == FLIGHT_PLAN_STATE_ASSUMED) {
+        matchTimestamps.erase(fp.GetCallsign());
+        scheduler.Request(fp.GetCallsign(), LOA_URGENCY_ASSUMED);
+    }
+    else if (IsLOARelevantState(state)) {
+        RequestWarmup(fp);  // notified or being transferred to us: its tag is about to appear
+    }
+}
+
+void LOAPlugin::OnRadarTargetPositionUpdate(EuroScopePlugIn::CRadarTarget RadarTarget)
+{
+    if (!RadarTarget.IsValid()) return;
+    EuroScopePlugIn::CFlightPlan fp = RadarTarget.GetCorrelatedFlightPlan();
+    if (!fp.IsValid()) return;
+
+    EuroScopePlugIn::CPosition position = RadarTarget.GetPosition().GetPosition();
+    bool inRange = warmupRangeNm > 0 && hasMyPosition && position.DistanceTo(myPosition) <= warmupRangeNm;
+    LoaGeoPoint point;
+    point.lat = position.m_Latitude;
+    point.lon = position.m_Longitude;
+    bool inView = visibility.Classify(point, GetTickCount64()) != LOA_VIEW_CULLED;
+    if (inView && (inRange || IsLOARelevantState(fp.GetState()))) RequestWarmup(fp);
+    else warmFlights.erase(fp.GetCallsign());
+}
+
+EuroScopePlugIn::CRadarScreen* LOAPlugin::OnRadarScreenCreated(const char* sDisplayName, bool NeedRadarContent,
+    bool GeoReferenced, bool CanBeSaved, bool CanBeCreated)
+{
+    // Only a geographic display can tell which flights are in view
+    if (!GeoReferenced) return nullptr;
+    return new LoaRadarScreen(&visibility);
+}
+
+void LOAPlugin::OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFlightPlan fp, int dataType)
+{
+    if (!fp.IsValid()) return;
+    if (dataType != EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE && dataType != EuroScopePlugIn::CTR_DATA_TYPE_FINAL_ALTITUDE)
+        return;
+
+    // Fallback rules depend on the cleared altitude
+    std::string callsign = fp.GetCallsign();
+    if (!matchTimestamps.count(callsign)) return;
+
+    // The last match tabulated its result against the altitude: no re-match needed
+    auto profile = altitudeProfiles.find(callsign);
+    if (profile != altitudeProfiles.end() && profile->second.match.IsBuilt()) {
+        matchedLOACache[callsign] = profile->second.match.Lookup(fp.GetClearedAltitude());
+        stats.levelChangeLookups++;
+        return;
+    }
+    matchTimestamps.erase(callsign);
+    scheduler.Request(callsign, LOA_URGENCY_ALTITUDE);
 }
 
 void LOAPlugin::OnFlightPlanCoordinationStateChange(CFlightPlan fp, int coordinationType, int newState)
 {
     if (!fp.IsValid()) return;
+    if (loaTrace.IsRecording()) {
+        int extra[2] = { coordinationType, newState };
+        TraceFlight(LOA_TRACE_COORDINATION_CHANGE, fp, extra, 2);
+    }
 
     std::string callsign = fp.GetCallsign();
 
@@ -261,6 +1032,507 @@ void LOAPlugin::OnFlightPlanCoordinationStateChange(CFlightPlan fp, int coordina
     }
 }
 
+bool LOAPlugin::OnCompileCommand(const char* sCommandLine)
+{
+    std::istringstream args(sCommandLine);
+    std::string command, sub;
+    args >> command >> sub;
+    if (_stricmp(command.c_str(), ".loa") != 0) return false;
+
+    if (_stricmp(sub.c_str(), "stats") == 0) {
+        ReportStats();
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "diag") == 0) {
+        std::string target;
+        args >> target;
+        if (target.empty() || _stricmp(target.c_str(), "off") == 0) {
+            diagMode = DIAG_OFF;
+            diagCallsign.clear();
+        }
+        else if (_stricmp(target.c_str(), "all") == 0) {
+            diagMode = DIAG_ALL;
+        }
+        else {
+            diagMode = DIAG_FLIGHT;
+            diagCallsign = target;
+            std::transform(diagCallsign.begin(), diagCallsign.end(), diagCallsign.begin(), ::toupper);
+        }
+        DisplayUserMessage("LOA Plugin", "LOA Diagnostics",
+            (diagMode == DIAG_OFF ? std::string("Match diagnostics off") : "Match diagnostics -> " + loaLog.GetFilePath()).c_str(),
+            true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "record") == 0) {
+        std::string action, target;
+        args >> action >> target;
+        std::string msg;
+        if (_stricmp(action.c_str(), "start") == 0) {
+            if (target.empty())
+                target = GetPluginFilePath("LOAPlugin_" + std::to_string(GetTickCount64()) + ".loatrace");
+            msg = loaTrace.Start(target) ? "Recording callbacks to " + target : "Cannot record to " + target;
+        }
+        else if (_stricmp(action.c_str(), "stop") == 0) {
+            if (!loaTrace.IsRecording()) return true;
+            msg = "Recorded " + std::to_string(loaTrace.GetRecordCount()) + " callbacks (" +
+                std::to_string(loaTrace.GetBytesWritten() / 1024) + " KB) to " + loaTrace.GetPath();
+            loaTrace.Stop();
+        }
+        else {
+            return false;
+        }
+        LOA_LOG_INFO("%s", msg.c_str());
+        DisplayUserMessage("LOA Plugin", "LOA Record", msg.c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "compiled") == 0) {
+        std::string mode;
+        args >> mode;
+        useCompiledRulesets = _stricmp(mode.c_str(), "off") != 0;
+        activeCompiledRuleset = useCompiledRulesets && !loaPredicates.UsesFlightConditions() ?
+            FindCompiledRuleset(loadedSector, loadedConfigHash) : nullptr;
+        matchTimestamps.clear();
+        DisplayUserMessage("LOA Plugin", "LOA Matcher",
+            activeCompiledRuleset ? "Using compiled ruleset" : "Using JSON interpreter", true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "budget") == 0) {
+        int budget = -1;
+        args >> budget;
+        if (budget >= 0) scheduler.budgetUs = budget;
+        std::string msg = scheduler.budgetUs > 0 ? "Matching budget " + std::to_string(scheduler.budgetUs) + " us per frame"
+            : std::string("Matching budget off");
+        DisplayUserMessage("LOA Plugin", "LOA Scheduler", msg.c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "shadow") == 0) {
+        // ".loa shadow 1" re-checks 1% of evaluations against the reference engine
+        std::string mode;
+        args >> mode;
+        if (_stricmp(mode.c_str(), "off") == 0) loaShadow.Stop();
+        else if (!mode.empty() && atof(mode.c_str()) > 0) loaShadow.Start(atof(mode.c_str()));
+        else if (!mode.empty()) return false;
+        ReportShadow();
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "warmup") == 0) {
+        double range = -1;
+        args >> range;
+        if (range >= 0) warmupRangeNm = range;
+        std::string msg = warmupRangeNm > 0 ? "Warming up flights within " + std::to_string((int)warmupRangeNm) + " nm"
+            : std::string("Warming up flights on state changes only");
+        DisplayUserMessage("LOA Plugin", "LOA Warm-up", msg.c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "cull") == 0) {
+        std::string mode;
+        args >> mode;
+        if (_stricmp(mode.c_str(), "on") == 0 || _stricmp(mode.c_str(), "off") == 0) {
+            visibility.enabled = _stricmp(mode.c_str(), "on") == 0;
+        }
+        else if (!mode.empty() && isdigit((unsigned char)mode[0])) {
+            visibility.marginNm = atof(mode.c_str());
+            visibility.enabled = true;
+        }
+        ReportCulling();
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "snapshot") == 0) {
+        std::string mode;
+        args >> mode;
+        if (_stricmp(mode.c_str(), "on") == 0 && !snapshot.IsOpen()) {
+            if (!snapshot.Open(SnapshotPath())) {
+                DisplayUserMessage("LOA Plugin", "LOA Snapshot", ("Cannot open " + SnapshotPath()).c_str(), true, true, false, false, false);
+                return true;
+            }
+            lastCheckpoint = 0;
+        }
+        else if (_stricmp(mode.c_str(), "off") == 0 && snapshot.IsOpen()) {
+            snapshot.Close();
+            snapshotProbed.clear();
+            std::remove(SnapshotPath().c_str());
+        }
+
+        std::ostringstream msg;
+        if (!snapshot.IsOpen()) {
+            msg << "Snapshot off";
+        }
+        else {
+            LoaSnapshotStats s = snapshot.GetStats();
+            msg << "Snapshot " << snapshot.GetPath() << ": " << s.checkpoints << " checkpoints every " << snapshotIntervalS
+                << " s (last " << s.lastRecords << " flights in " << s.lastWriteMs << " ms, skipped " << s.skipped << ")"
+                << ", restored current/stale: " << stats.snapshotFresh << "/" << stats.snapshotStale
+                << ", discarded: " << stats.snapshotDiscarded << ", coordinations: " << stats.snapshotCoordinations;
+        }
+        DisplayUserMessage("LOA Plugin", "LOA Snapshot", msg.str().c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "airways") == 0) {
+        std::string mode;
+        std::getline(args >> std::ws, mode);
+        if (_stricmp(mode.c_str(), "on") == 0 || _stricmp(mode.c_str(), "off") == 0) {
+            useNativeRoutes = _stricmp(mode.c_str(), "on") == 0;
+            routeCache.clear();
+            routeCacheTime.clear();
+        }
+        else if (!mode.empty()) {
+            // Read with the next config load, on the worker
+            airwayFile = mode;
+            LoadLOAsFromJSON(true);
+        }
+        ReportAirways();
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "memo") == 0) {
+        int entries = -1;
+        args >> entries;
+        if (entries >= 0) matchMemo.SetCapacity((size_t)entries);
+        std::string msg = matchMemo.GetCapacity() > 0 ? "Match memo " + std::to_string(matchMemo.GetCapacity()) + " entries"
+            : std::string("Match memo off");
+        DisplayUserMessage("LOA Plugin", "LOA Memo", msg.c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "sectors") == 0) {
+        // ".loa sectors EDYY_H EDYY_B" bandboxes them with our position, ".loa sectors auto" reverts to bandboxes.json
+        std::vector<std::string> sectors;
+        std::string s;
+        while (args >> s) {
+            if (_stricmp(s.c_str(), "auto") == 0) {
+                sectors.clear();
+                break;
+            }
+            std::transform(s.begin(), s.end(), s.begin(), ::toupper);
+            sectors.push_back(s);
+        }
+        ownedSectorsOverride = sectors;
+        LoadLOAsFromJSON(true);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "condition") == 0) {
+        std::string name, state;
+        args >> name >> state;
+        std::transform(name.begin(), name.end(), name.begin(), ::toupper);
+        if (!name.empty() && (_stricmp(state.c_str(), "on") == 0 || _stricmp(state.c_str(), "off") == 0)) {
+            std::vector<const LOAEntry*> changed;
+            loaActivation.SetCondition(name, _stricmp(state.c_str(), "on") == 0, changed);
+            if (!changed.empty()) OnRulesActivationChanged(changed);
+            LOA_LOG_INFO("Condition %s %s: %zu rules changed", name.c_str(), state.c_str(), changed.size());
+        }
+        else if (!name.empty()) {
+            return false;
+        }
+
+        std::string active;
+        for (const auto& c : loaActivation.GetConditions()) active += (active.empty() ? "" : ", ") + c;
+        DisplayUserMessage("LOA Plugin", "LOA Conditions", ("Conditions on: " + (active.empty() ? std::string("none") : active)).c_str(),
+            true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "export") == 0) {
+        std::string mode, name;
+        args >> mode >> name;
+        std::string msg;
+        if (_stricmp(mode.c_str(), "on") == 0) {
+            if (name.empty()) name = LOA_EXPORT_DEFAULT_NAME;
+            msg = resultExport.Start(name) ? "Exporting results to shared memory " + name : "Cannot create shared memory " + name;
+            if (resultExport.IsRunning()) PublishResults();
+        }
+        else if (_stricmp(mode.c_str(), "off") == 0) {
+            resultExport.Stop();
+            msg = "Result export off";
+        }
+        else {
+            return false;
+        }
+        LOA_LOG_INFO("%s", msg.c_str());
+        DisplayUserMessage("LOA Plugin", "LOA Export", msg.c_str(), true, true, false, false, false);
+        return true;
+    }
+
+    if (_stricmp(sub.c_str(), "log") == 0) {
+        static const char* levels[] = { "debug", "info", "warn", "error" };
+        std::string level;
+        args >> level;
+        for (int i = LOA_LEVEL_DEBUG; i <= LOA_LEVEL_ERROR; ++i) {
+            if (_stricmp(level.c_str(), levels[i]) == 0) {
+                loaLog.SetLevel(i);
+                return true;
+            }
+        }
+        return false;
+    }
+    return false;
+}
+
+void LOAPlugin::OnTimer(int Counter)
+{
+    // Started here rather than in the constructor, which may run under the loader lock
+    loaLog.Start(GetPluginFilePath("LOAPlugin.log"));
+
+    // First idle moment: the first config load (see LoadLOAsFromJSON)
+    if (!idleReached) {
+        idleReached = true;
+        startup.idleWaitMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - constructedAt).count();
+    }
+    if (configLoad && configLoadReady.load(std::memory_order_acquire)) InstallConfigLoad();
+    if (!configLoad) {
+        bool force = configReloadWanted;
+        configReloadWanted = false;
+        LoadLOAsFromJSON(force);
+    }
+
+    EuroScopePlugIn::CController me = ControllerMyself();
+    hasMyPosition = me.IsValid() && me.IsController();
+    if (hasMyPosition) myPosition = me.GetPosition();
+
+    // Flights not drawn yet are re-queued once their warm result has expired
+    for (const auto& callsign : warmFlights) {
+        if (HasFreshMatch(callsign, 5000) || scheduler.IsQueued(callsign)) continue;
+        scheduler.Request(callsign, LOA_URGENCY_WARMUP);
+        stats.warmupRequests++;
+    }
+
+    // Queued evaluations also drain when no tags are being drawn, warm-ups last
+    scheduler.BeginFrame(true);
+    RunScheduledEvaluations(true);
+
+    // Rules entering or leaving their activation windows
+    std::vector<const LOAEntry*> changed;
+    loaActivation.Advance(LoaUtcNow(), changed);
+    if (!changed.empty()) OnRulesActivationChanged(changed);
+
+    if (resultExport.IsRunning()) PublishResults();
+
+    if (snapshot.IsOpen() && loadedConfigHash && GetTickCount64() - lastCheckpoint >= snapshotIntervalS * 1000ULL) {
+        lastCheckpoint = GetTickCount64();
+        CheckpointSnapshot();
+    }
+
+    // Only a summary ever reaches the chat window; the detail is in the log file
+    LoaLogger::Summary summary = loaLog.TakeSummary();
+    if (summary.warnings || summary.errors || summary.dropped) {
+        std::ostringstream msg;
+        msg << summary.errors << " error(s), " << summary.warnings << " warning(s)";
+        if (summary.dropped) msg << ", " << summary.dropped << " dropped";
+        msg << " - see " << loaLog.GetFilePath();
+        DisplayUserMessage("LOA Plugin", "LOA Log", msg.str().c_str(), true, true, false, false, false);
+    }
+}
+
+void LOAPlugin::OnFunctionCall(int FunctionId, const char* sItemString, POINT Pt, RECT Area)
+{
+    if (FunctionId != ItemCodes::CUSTOM_FUNC_HANDOFF_NEXT_SECTOR) return;
+
+    EuroScopePlugIn::CFlightPlan fp = FlightPlanSelectASEL();
+    if (!fp.IsValid()) return;
+
+    // Target resolved by the last render of the next-sector tag item
+    auto it = handoffTargets.find(fp.GetCallsign());
+    if (it == handoffTargets.end()) return;
+
+    EuroScopePlugIn::CController target = ControllerSelectByPositionId(it->second.first.c_str());
+    if (!target.IsValid()) return;
+    fp.InitiateHandoff(target.GetCallsign());
+}
+
+void LOAPlugin::PublishResults()
+{
+    ULONGLONG now = GetTickCount64();
+    const auto& onlineControllers = GetOnlineControllersCached();
+    LoaRouteWaypoints route;
+    auto start = std::chrono::steady_clock::now();
+    auto charge = [&]() {
+        auto end = std::chrono::steady_clock::now();
+        scheduler.ChargeWork(std::chrono::duration<double, std::micro>(end - start).count());
+        start = end;
+    };
+
+    for (const auto& cached : matchedLOACache) {
+        if (warmFlights.count(cached.first)) continue;  // warmed up ahead of its tag, maybe not ours yet
+        EuroScopePlugIn::CFlightPlan fp = FlightPlanSelect(cached.first.c_str());
+        if (!fp.IsValid()) continue;
+
+        // XFL and COP as the tag items show them at the current cleared altitude,
+        // read from the tables the tags left behind while their key still holds.
+        // Only a flight without current tables needs its route scanned.
+        const auto& fpd = fp.GetFlightPlanData();
+        CachedTagData tag = { cached.first, fp.GetClearedAltitude(), fp.GetFinalAltitude(), fpd.GetOrigin(), fpd.GetDestination() };
+        auto stored = altitudeProfiles.find(cached.first);
+        bool current = stored != altitudeProfiles.end() && stored->second.xfl.IsBuilt() &&
+            stored->second.key == AltitudeProfileKey(fp, tag);
+        if (!current && !scheduler.HasBudget()) {
+            stats.exportDeferred++;
+            continue;
+        }
+        if (!current) {
+            route.Reset(fp);
+            GetAltitudeProfile(fp, tag, onlineControllers, route);
+            stats.exportRebuilds++;
+        }
+        const LoaFlightProfile& profile = altitudeProfiles[cached.first];
+        const std::string& cop = profile.cop.Lookup(tag.clearedAltitude);
+
+        // No rule names a COP: the COP tag's last sector exit while its key holds
+        const std::string* derived = nullptr;
+        bool geometric = false;
+        if (cop == "COPX") {
+            auto estimate = exitEstimates.find(cached.first);
+            if (estimate != exitEstimates.end() && estimate->second.computed && estimate->second.key == ExitEstimateKey(fp)) {
+                derived = estimate->second.found ? &estimate->second.cop : nullptr;
+            }
+            else if (!current || scheduler.HasBudget()) {
+                derived = GetGeometricCop(fp);
+                geometric = true;
+            }
+            else {
+                stats.exportDeferred++;
+                continue;
+            }
+        }
+        if (!current || geometric) charge();
+
+        const LOAEntry* entry = cached.second;
+        LoaExportData data;
+        memset(&data, 0, sizeof(data));
+        strncpy_s(data.callsign, sizeof(data.callsign), cached.first.c_str(), _TRUNCATE);
+
+        LoaMatchRef ref = LocateLoaEntry(entry);
+        data.ruleId = ref.list == LOA_LIST_NONE ? -1 : (ref.list << 16) | ref.index;
+        if (entry) {
+            if (const std::string* next = FirstOnlineNextSector(*entry, onlineControllers))
+                strncpy_s(data.nextSector, sizeof(data.nextSector), next->c_str(), _TRUNCATE);
+        }
+
+        data.xfl = atoi(profile.xfl.Lookup(tag.clearedAltitude).c_str());
+        strncpy_s(data.cop, sizeof(data.cop), derived ? derived->c_str() : cop.c_str(), _TRUNCATE);
+
+        auto coordination = coordinationStates.find(cached.first);
+        if (coordination != coordinationStates.end()) {
+            data.exitAltitude = coordination->second.exitAltitude;
+            data.exitAltitudeState = coordination->second.exitAltitudeState;
+            strncpy_s(data.exitPoint, sizeof(data.exitPoint), coordination->second.exitPoint.c_str(), _TRUNCATE);
+            data.exitPointState = coordination->second.exitPointState;
+        }
+
+        data.updatedMs = now;
+        resultExport.Publish(data);
+    }
+    resultExport.Heartbeat(now, loadedConfigHash);
+    charge();
+}
+
+void LOAPlugin::ReportShadow()
+{
+    LoaShadowStats shadow = loaShadow.GetStats();
+    std::ostringstream msg;
+    if (!loaShadow.IsRunning()) msg << "Shadow matching off";
+    else msg << "Shadow matching " << loaShadow.GetPercent() << "% of evaluations";
+    if (shadow.samples) {
+        msg << ": " << shadow.samples << " checked, " << shadow.disagreements << " disagreed"
+            << ", " << shadow.dropped << " dropped"
+            << ", optimized " << (int)(shadow.optimizedUs / shadow.samples + 0.5) << " us"
+            << " vs reference " << (int)(shadow.referenceUs / shadow.samples + 0.5) << " us per flight";
+        if (shadow.optimizedUs > 0) msg << " (" << (int)(shadow.referenceUs / shadow.optimizedUs * 10 + 0.5) / 10.0 << "x)";
+    }
+    if (shadow.submitted)
+        msg << ", sampling " << (int)(shadow.sampleUs / shadow.submitted + 0.5) << " us per sample on the UI thread";
+    if (shadow.disagreements) msg << " - see " << loaLog.GetFilePath();
+    DisplayUserMessage("LOA Plugin", "LOA Shadow", msg.str().c_str(), true, true, false, false, false);
+}
+
+void LOAPlugin::ReportAirways()
+{
+    std::ostringstream msg;
+    if (!loaAirways.IsLoaded()) {
+        msg << "No airways loaded";
+    }
+    else {
+        LoaAirwayGraph::SegmentStats segments = loaAirways.GetSegmentStats();
+        msg << "Airways " << loaAirways.GetPath() << ": " << loaAirways.NodeCount() << " points, "
+            << loaAirways.AirwayCount() << " airways, native expansion " << (useNativeRoutes ? "on" : "off")
+            << "; routes expanded " << stats.nativeRoutes << " (not covered " << stats.nativeRoutesUncovered << ")"
+            << ", checked against the SDK: " << stats.nativeRoutesAgreed << " agreed, " << stats.nativeRoutesDisagreed
+            << " disagreed (" << std::count_if(nativeRouteChecks.begin(), nativeRouteChecks.end(),
+                [](const std::pair<const size_t, RouteCheck>& c) { return !c.second.agreed; }) << " route texts left to the SDK)"
+            << "; segments cached " << segments.cached << " (" << segments.hits << " hits, " << segments.searches << " searched)";
+        if (stats.nativeRoutes && stats.sdkRoutes) {
+            double nativeUs = stats.nativeRouteUs / (stats.nativeRoutes + stats.nativeRoutesUncovered);
+            double sdkUs = stats.sdkRouteUs / stats.sdkRoutes;
+            msg << "; per route " << (int)(nativeUs * 10 + 0.5) / 10.0 << " us native vs " << (int)(sdkUs * 10 + 0.5) / 10.0 << " us SDK";
+            if (nativeUs > 0) msg << " (" << (int)(sdkUs / nativeUs * 10 + 0.5) / 10.0 << "x)";
+        }
+    }
+    DisplayUserMessage("LOA Plugin", "LOA Airways", msg.str().c_str(), true, true, false, false, false);
+}
+
+void LOAPlugin::ReportCulling()
+{
+    ULONGLONG now = GetTickCount64();
+    std::ostringstream msg;
+    if (!visibility.enabled) msg << "Culling off";
+    else msg << "Culling flights beyond " << (int)visibility.marginNm << " nm of the display";
+    msg << " (" << visibility.AreaCount(now) << "/" << visibility.ScreenCount() << " displays reporting"
+        << (visibility.enabled && !visibility.IsActive(now) ? ", every flight in view until one does" : "") << ")"
+        << "; full evaluations: " << stats.evaluationsInView << " in view, " << stats.evaluationsCulled << " culled"
+        << "; culled tags answered from an older result: " << stats.culledStale
+        << ", queued evaluations and warm-ups dropped: " << stats.culledDropped;
+    DisplayUserMessage("LOA Plugin", "LOA Culling", msg.str().c_str(), true, true, false, false, false);
+}
+
+void LOAPlugin::ReportStats()
+{
+    std::ostringstream msg;
+    msg << "Sector events: " << stats.controllerEvents
+        << ", re-evaluations: " << stats.controllerEventReevaluations
+        << " (last event: " << stats.lastEventReevaluations << ")"
+        << ", indexed sectors: " << sectorDependents.size()
+        << ", dependent flights: " << flightSectorDependencies.size()
+        << ", matcher: " << (activeCompiledRuleset ? "compiled" : "interpreted")
+        << ", route scans: " << stats.routeScans
+        << " (extracted route needed: " << stats.routeExtractions << ")"
+        << ", waypoint signature false positives: " << stats.signatureFalsePositives << "/"
+        << (stats.signatureFalsePositives + stats.signatureRejects)
+        << ", tag altitude tables built: " << stats.altitudeProfileBuilds
+        << ", sector exits computed: " << stats.exitEstimates << " (reused " << stats.exitEstimateHits << ")"
+        << ", level changes by lookup: " << stats.levelChangeLookups
+        << ", memo: " << matchMemo.Size() << "/" << matchMemo.GetCapacity()
+        << " (hit rate " << (int)(matchMemo.HitRate() * 100 + 0.5) << "%, " << matchMemo.stats.hits << " hits, "
+        << matchMemo.stats.evictions << " evicted)"
+        << ", export: " << (resultExport.IsRunning() ? std::to_string(resultExport.Size()) + " flights, " +
+            std::to_string(resultExport.writes) + " writes, " + std::to_string(resultExport.dropped) + " dropped, " +
+            std::to_string(stats.exportRebuilds) + " tables built, " + std::to_string(stats.exportDeferred) + " deferred" : std::string("off"))
+        << ", scheduled rules: " << loaActivation.ScheduledRules()
+        << " (transitions: " << loaActivation.transitions << ", flights re-evaluated: " << stats.activationReevaluations << ")"
+        << ", warm-ups: " << stats.warmups << " (" << warmFlights.size() << " flights kept warm)"
+        << ", first renders from cache: " << stats.firstRenderHits << "/" << (stats.firstRenderHits + stats.firstRenderMisses)
+        << ", evaluations in view/culled: " << stats.evaluationsInView << "/" << stats.evaluationsCulled
+        << " (culled from an older result: " << stats.culledStale << ", dropped: " << stats.culledDropped << ")"
+        << ", frames: " << scheduler.stats.frames
+        << " (over " << scheduler.budgetUs << " us budget: " << scheduler.stats.overruns
+        << ", worst " << (long long)scheduler.stats.worstFrameUs << " us)"
+        << ", evaluations inline/queued: " << scheduler.stats.inlineEvaluations << "/" << scheduler.stats.queuedEvaluations
+        << ", queue: " << scheduler.QueueDepth() << " (max " << scheduler.stats.maxQueueDepth << ")";
+    if (startup.complete) {
+        msg << ", startup: construct " << startup.constructMs << " ms, discovery " << startup.discoverMs
+            << " ms + parse " << startup.parseMs << " ms (worker), install " << startup.installMs
+            << " ms, rules ready after " << (long long)startup.totalMs << " ms";
+    }
+    DisplayUserMessage("LOA Plugin", "LOA Stats", msg.str().c_str(), true, true, false, false, false);
+}
+
 void LOAPlugin::OnGetTagItem(
     EuroScopePlugIn::CFlightPlan flightPlan,
     EuroScopePlugIn::CRadarTarget radarTarget,
@@ -271,6 +1543,11 @@ void LOAPlugin::OnGetTagItem(
     COLORREF* pRGB,
     double* pFontSize)
 {
+    if (loaTrace.IsRecording()) TraceFlight(LOA_TRACE_TAG_ITEM, flightPlan, &itemCode, 1);
+
+    // Queued work gets the start of each frame's budget, ahead of newly expired tags
+    if (scheduler.BeginFrame()) RunScheduledEvaluations();
+
     const std::string callsign = flightPlan.GetCallsign();
     const auto& fpd = flightPlan.GetFlightPlanData();
     int clearedAltitude = flightPlan.GetClearedAltitude();
@@ -278,16 +1555,24 @@ void LOAPlugin::OnGetTagItem(
     std::string origin = fpd.GetOrigin();
     std::string destination = fpd.GetDestination();
 
-    plugin.lastTagData = { callsign, clearedAltitude, finalAltitude, origin, destination };
+    lastTagData = { callsign, clearedAltitude, finalAltitude, origin, destination };
 
     // Precompute and cache route + controller data per frame
     ULONGLONG now = GetTickCount64();
-    if (callsign != plugin.currentFrameCallsign || now - plugin.currentFrameTimestamp > 100) {
-        plugin.currentFrameCallsign = callsign;
-        plugin.currentFrameTimestamp = now;
-        plugin.currentFrameOnlineControllers = plugin.GetOnlineControllersCached();
-        plugin.currentFrameRoutePoints = plugin.GetCachedRoutePoints(flightPlan);
-        plugin.currentFrameMatchedLOA = MatchLoaEntry(flightPlan, plugin.currentFrameOnlineControllers); // ✅ Add this
+    if (callsign != currentFrameCallsign || now - currentFrameTimestamp > 100) {
+        currentFrameCallsign = callsign;
+        currentFrameTimestamp = now;
+        currentFrameOnlineControllers = GetOnlineControllersCached();
+        currentFrameRoute.Reset(flightPlan);
+        currentFrameView = visibility.Classify(flightPlan, true, now);
+        RestoreFromSnapshot(flightPlan);
+
+        if (IsLOARelevantState(flightPlan.GetState()) && renderedFlights.insert(callsign).second) {
+            warmFlights.erase(callsign);
+            if (HasFreshMatch(callsign, 5000)) stats.firstRenderHits++;
+            else stats.firstRenderMisses++;
+        }
+        currentFrameMatchedLOA = GetScheduledMatch(flightPlan);
 
     }
 
@@ -302,9 +1587,12 @@ void LOAPlugin::OnGetTagItem(
     case 1997:
         RenderCOPTagItem(flightPlan, radarTarget, tagData, sItemString, pColorCode, pRGB, pFontSize);
         break;
+    case ItemCodes::CUSTOM_TAG_NEXT_SECTOR:
+        RenderNextSectorTagItem(flightPlan, radarTarget, tagData, sItemString, pColorCode, pRGB, pFontSize);
+        break;
     default:
         break;
     }
 }
 
-LOAPlugin plugin;
\ No newline at end of file
+LOAPlugin* plugin = nullptr;
\ No newline at end of file
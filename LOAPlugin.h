@@ -1,36 +1,30 @@
 ﻿#pragma once
 
 #include "EuroScopePlugIn.h"
+#include "LoaRules.h"
+#include "LoaRouteScan.h"
+#include "LoaScheduler.h"
+#include "LoaAltitudeProfile.h"
+#include "LoaMemo.h"
+#include "LoaExport.h"
+#include "LoaActivation.h"
+#include "LoaGeometry.h"
+#include "LoaSnapshot.h"
+#include "LoaAirways.h"
+#include "LoaVisibility.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
 #include <map>
+#include <cstdint>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <chrono>
 
 using namespace EuroScopePlugIn;
 
-// =============================
-// LOAEntry Struct
-// =============================
-struct LOAEntry {
-    std::vector<std::string> sectors;
-    std::vector<std::string> waypoints;
-    std::vector<std::string> originAirports;
-    std::vector<std::string> destinationAirports;
-    std::vector<std::string> nextSectors;
-    int xfl = 0;
-    std::string copText = "COPX";
-    bool requireNextSectorOnline = false;
-    int minAltitudeFt = 0;  // For fallbackLoas: minimum altitude (e.g. 24500 for FL245)
-   
-
-    // ✅ NEW: Optimized airport matching
-    std::unordered_set<std::string> originAirportSet;
-    std::vector<std::string> originAirportPrefixes;
-    std::unordered_set<std::string> destinationAirportSet;
-    std::vector<std::string> destinationAirportPrefixes;
-};
-
 struct CachedTagData {
     std::string callsign;
     int clearedAltitude = 0;
@@ -47,6 +41,57 @@ struct CoordinationInfo {
     int exitPointState = 0;
 };
 
+// Counters surfaced through ".loa stats"
+struct LOAPluginStats {
+    unsigned long long controllerEvents = 0;             // sector online/offline transitions seen
+    unsigned long long controllerEventReevaluations = 0; // flights queued for re-matching because of them
+    unsigned long long lastEventReevaluations = 0;       // flights queued by the latest transition
+    unsigned long long routeScans = 0;                   // route texts scanned for LOA waypoints
+    unsigned long long routeExtractions = 0;             // of those, flights that still needed GetExtractedRoute
+    unsigned long long signatureRejects = 0;             // entries turned away by the waypoint signature alone
+    unsigned long long signatureFalsePositives = 0;      // entries that passed it but were not on the route
+    unsigned long long altitudeProfileBuilds = 0;        // route/airport/sector stage runs for the tag items
+    unsigned long long levelChangeLookups = 0;           // level changes answered from an altitude table
+    unsigned long long exitEstimates = 0;                // sector exits computed from the boundary
+    unsigned long long exitEstimateHits = 0;             // COP tags that reused a flight's last one
+    unsigned long long activationReevaluations = 0;      // flights queued because a rule became (in)active
+    unsigned long long warmupRequests = 0;               // flights queued ahead of their first tag
+    unsigned long long warmups = 0;                      // of those, evaluated from the timer
+    unsigned long long firstRenderHits = 0;              // first tag of a flight answered from the cache
+    unsigned long long firstRenderMisses = 0;            // first tag of a flight that had to evaluate
+    unsigned long long snapshotFresh = 0;                // matches restored from the snapshot as current
+    unsigned long long snapshotStale = 0;                // restored for display, re-evaluated when due
+    unsigned long long snapshotDiscarded = 0;            // records whose route or rule no longer fits
+    unsigned long long snapshotCoordinations = 0;        // coordination states restored
+    unsigned long long nativeRoutes = 0;                 // routes expanded from the airway graph
+    unsigned long long nativeRoutesUncovered = 0;        // tried, but a token was not in the graph
+    unsigned long long nativeRoutesAgreed = 0;           // checked against GetExtractedRoute and equal
+    unsigned long long nativeRoutesDisagreed = 0;
+    unsigned long long sdkRoutes = 0;                    // GetExtractedRoute calls
+    double nativeRouteUs = 0;                            // total time of each kind
+    double sdkRouteUs = 0;
+    unsigned long long evaluationsInView = 0;            // full evaluations of flights in view (see LoaVisibility.h)
+    unsigned long long evaluationsCulled = 0;            // of culled flights, asked for by a list
+    unsigned long long culledStale = 0;                  // culled tags answered from an older result
+    unsigned long long culledDropped = 0;                // queued evaluations and warm-ups dropped out of view
+    unsigned long long exportRebuilds = 0;               // tag tables the export had to build itself
+    unsigned long long exportDeferred = 0;               // flights left to a later second for lack of budget
+};
+
+// Startup phases in milliseconds, logged when the first ruleset is installed
+// and shown by ".loa stats". Only the constructor runs inside EuroScope's
+// plugin load; the sector files are read when the first timer callback fires,
+// on a worker thread.
+struct LoaStartupTimings {
+    double constructMs = 0;  // EuroScopePlugInInit: tag item registration
+    double idleWaitMs = 0;   // constructor to the first timer callback
+    double discoverMs = 0;   // bandboxes.json and the sector file paths (worker)
+    double parseMs = 0;      // reading, parsing and merging the files (worker)
+    double installMs = 0;    // swapping the lists in and building the indices (timer)
+    double totalMs = 0;      // constructor to the first installed ruleset
+    bool complete = false;
+};
+
 // =============================
 // Custom Tag Item IDs
 // =============================
@@ -54,25 +99,56 @@ namespace ItemCodes {
     const int CUSTOM_TAG_ID = 1996;
     const int CUSTOM_TAG_ID_COP = 1997;
     const int CUSTOM_TAG_XFL_DETAILED = 2000;
+    const int CUSTOM_TAG_NEXT_SECTOR = 1998;
+
+    // Tag functions
+    const int CUSTOM_FUNC_HANDOFF_NEXT_SECTOR = 1998;
 }
 
 // =============================
 // Global LOA Containers
 // =============================
-extern std::vector<LOAEntry> destinationLoas;
-extern std::vector<LOAEntry> departureLoas;
-extern std::vector<LOAEntry> lorArrivals;
-extern std::vector<LOAEntry> lorDepartures;
-extern std::vector<LOAEntry> fallbackLoas;
+extern uint64_t loadedConfigHash;  // HashLoaConfig of the file the lists came from
+
+extern std::unordered_map<std::string, std::string> controllerFrequencies;  // online position ID -> "132.350"
+extern std::unordered_map<std::string, std::pair<std::string, std::string>> handoffTargets;  // callsign -> (next sector, frequency)
+
+// =============================
+// Hashing Utilities
+// =============================
+size_t HashVectorOfStrings(const std::vector<std::string>& vec);
+size_t HashSetOfStrings(const std::unordered_set<std::string>& set);
+
+// Parses one loa_configs_json file into the global LOA lists (lists untouched on failure)
+bool LoadLOAConfigFile(const std::string& filePath, std::string& error);
+
+// Several sector files merged into the global LOA lists, in file order. With
+// more than one owned sector, rules handing off only into owned sectors are
+// dropped. The first file must load; later missing files are skipped.
+bool LoadLOAConfigFiles(const std::vector<std::string>& filePaths, const std::vector<std::string>& ownedSectors,
+    std::string& error, LoaMergeReport* report = nullptr);
 
-extern std::unordered_map<std::string, std::string> controllerFrequencies;
-extern std::unordered_map<int, std::pair<std::string, EuroScopePlugIn::CFlightPlan>> handoffTargets;
+// LoadLOAConfigFiles in two halves: PrepareLOAConfigFiles (LoaRules.h), then
+// installing swaps the result into the global lists and rebuilds the indices
+void InstallLOAConfig(LoaPreparedConfig& config);
+
+// Owned sectors of a position: itself, then the override or its bandboxes.json entry
+std::vector<std::string> GetOwnedSectors(const std::string& position, const std::vector<std::string>& overrideSectors);
+
+// Directory the plugin DLL was loaded from (configs, logs and traces live here)
+std::string GetPluginDirectory();
+// A file under it; "loa_configs_json\\x.json" is joined with the platform's separator
+std::string GetPluginFilePath(const std::string& relative);
 
 // =============================
 // Match Function
 // =============================
-bool EqualsIgnoreCase(const std::string& a, const std::string& b);
-const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers);
+// route: the flight's waypoints if the caller already scanned them (reset for fp), else scanned here
+const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+    LoaRouteWaypoints* route = nullptr);
+// Same, for a flight not (yet) in an LOA-relevant state: warm-up fills the caches ahead of its first tag
+const LOAEntry* MatchLoaEntryAnyState(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+    LoaRouteWaypoints* route = nullptr);
 
 // =============================
 // Tag Render Functions
@@ -104,6 +180,15 @@ void RenderCOPTagItem(
     COLORREF* pRGB,
     double* pFontSize);
 
+void RenderNextSectorTagItem(
+    EuroScopePlugIn::CFlightPlan flightPlan,
+    EuroScopePlugIn::CRadarTarget radarTarget,
+    int tagData,
+    char sItemString[16],
+    int* pColorCode,
+    COLORREF* pRGB,
+    double* pFontSize);
+
 // =============================
 // LOAPlugin Class
 // =============================
@@ -113,7 +198,14 @@ public:
     virtual ~LOAPlugin();
 
     virtual void OnControllerPositionUpdate(EuroScopePlugIn::CController Controller);
+    virtual void OnControllerDisconnect(EuroScopePlugIn::CController Controller);
+    virtual bool OnCompileCommand(const char* sCommandLine);
+    virtual void OnTimer(int Counter);
+    virtual void OnRadarTargetPositionUpdate(EuroScopePlugIn::CRadarTarget RadarTarget);
+    virtual void OnFunctionCall(int FunctionId, const char* sItemString, POINT Pt, RECT Area);
     virtual void RequestRefreshRadarScreen() {}
+    virtual EuroScopePlugIn::CRadarScreen* OnRadarScreenCreated(const char* sDisplayName, bool NeedRadarContent,
+        bool GeoReferenced, bool CanBeSaved, bool CanBeCreated);
 
     bool IsLOARelevantState(int state);
     bool IsControllerOnlineCached(const std::string& controllerId, const std::unordered_set<std::string>& onlineControllers);
@@ -123,6 +215,9 @@ public:
 
     const std::unordered_set<std::string>& GetOnlineControllersCached();  // ✅ 5-second cache accessor
     size_t cachedOnlineControllersHash = 0;
+    unsigned long long onlineSectorGeneration = 0;  // bumped on every sector online/offline change
+    unsigned long long activationGeneration = 0;    // bumped whenever rules become active or inactive
+    bool IsCachedOnlineSet(const std::unordered_set<std::string>& set) const { return &set == &cachedOnlineControllers; }
 
     // LOA CACHE
     CachedTagData lastTagData;
@@ -133,16 +228,109 @@ public:
     std::unordered_map<std::string, ULONGLONG> matchTimestamps;
 
     std::unordered_set<std::string> currentFrameOnlineControllers;
-    std::vector<std::string> currentFrameRoutePoints;
+    LoaRouteWaypoints currentFrameRoute;
     std::string currentFrameCallsign;
     ULONGLONG currentFrameTimestamp = 0;
 
     const LOAEntry* currentFrameMatchedLOA = nullptr;
+    LoaViewClass currentFrameView = LOA_VIEW_MARGIN;
+
+    // Altitude-independent stage per flight (see LoaAltitudeProfile.h); rebuilt
+    // when any other input changes or after 5 s
+    std::unordered_map<std::string, LoaFlightProfile> altitudeProfiles;
+    size_t AltitudeProfileKey(const EuroScopePlugIn::CFlightPlan& fp, const CachedTagData& data);
+    const LoaFlightProfile& GetAltitudeProfile(const EuroScopePlugIn::CFlightPlan& fp);
+    const LoaFlightProfile& GetAltitudeProfile(const EuroScopePlugIn::CFlightPlan& fp, const CachedTagData& data,
+        const std::unordered_set<std::string>& onlineControllers, LoaRouteWaypoints& route, ULONGLONG maxAgeMs = 5000);
+
+    // COP nearest to where the route leaves our sector, for flights no rule
+    // gives one (see LoaGeometry.h); nullptr without a boundary or exit
+    std::unordered_map<std::string, LoaExitEstimate> exitEstimates;
+    size_t ExitEstimateKey(const EuroScopePlugIn::CFlightPlan& fp);
+    const std::string* GetGeometricCop(const EuroScopePlugIn::CFlightPlan& fp);
+
+    // Match results shared between flights with the same city pair and route
+    LoaMatchMemo matchMemo;
+
+    // Shared-memory copy of the cached results for companion tools (".loa export"),
+    // refreshed from the 1 s timer so the tag path never waits on it. XFL and COP
+    // come from the tables the tags or warm-ups left behind; rebuilding missing or
+    // outdated ones is charged to the scheduler and waits for budget.
+    LoaResultPublisher resultExport;
+    void PublishResults();
+
+    // Reverse dependency index: sector ID -> flights whose current or candidate
+    // match hinges on that sector being online (requireNextSectorOnline rules).
+    std::unordered_map<std::string, std::unordered_set<std::string>> sectorDependents;
+    std::unordered_map<std::string, std::vector<std::string>> flightSectorDependencies;
+    void SetFlightSectorDependencies(const std::string& callsign, const std::vector<std::string>& sectors);
+    void OnSectorOnlineChanged(const std::string& sectorId);
+    void OnRulesActivationChanged(const std::vector<const LOAEntry*>& changed);
 
+    LOAPluginStats stats;
+    LoaStartupTimings startup;
+    void ReportStats();
+    void ReportShadow();  // ".loa shadow", see LoaShadow.h
+
+    // Frame-budgeted evaluation (see LoaScheduler.h): the match to display now,
+    // possibly the last good one while a fresh evaluation waits in the queue
+    LoaEvaluationScheduler scheduler;
+    const LOAEntry* GetScheduledMatch(const EuroScopePlugIn::CFlightPlan& fp);
+    void RunScheduledEvaluations(bool idle = false);
+
+    // Warm-up (".loa warmup <nm>"): flights entering an LOA-relevant state, or
+    // within this distance of our position, are evaluated from the timer before
+    // their first tag is drawn. 0 keeps the state trigger only.
+    double warmupRangeNm = 80;
+    void RequestWarmup(const EuroScopePlugIn::CFlightPlan& fp);
+    bool HasFreshMatch(const std::string& callsign, ULONGLONG maxAgeMs);
+    std::unordered_set<std::string> renderedFlights;  // flights whose first tag has been drawn
+    std::unordered_set<std::string> warmFlights;      // not drawn yet, kept warm by the timer
+
+    // Visibility culling (".loa cull on|off|<nm>", see LoaVisibility.h): only
+    // flights in view are evaluated eagerly
+    LoaVisibility visibility;
+    void ReportCulling();
+
+    // Warm-cache snapshot (".loa snapshot on|off", see LoaSnapshot.h): flights
+    // are looked up once, when first seen after a restart; true if the match
+    // came back current
+    LoaSnapshotStore snapshot;
+    int snapshotIntervalS = 30;
+    bool RestoreFromSnapshot(const EuroScopePlugIn::CFlightPlan& fp);
+    void CheckpointSnapshot();
+    std::unordered_set<std::string> snapshotProbed;
+    ULONGLONG lastCheckpoint = 0;
+
+    bool useCompiledRulesets = true;  // ".loa compiled on|off"
+
+    // Native route expansion (".loa airways on|off|<file>", see LoaAirways.h).
+    // The first expansion of a route text is also extracted by the SDK and
+    // compared, and after that one native route in routeCheckEvery; route texts
+    // the two disagree on are left to the SDK. Verdicts expire and are capped
+    // like the route cache's entries (see GetCachedRoutePoints).
+    std::string airwayFile;           // empty: loa_configs_json\airways.sct
+    bool useNativeRoutes = true;
+    int routeCheckEvery = 20;
+    struct RouteCheck {
+        bool agreed;
+        ULONGLONG checkedAt;
+    };
+    std::unordered_map<size_t, RouteCheck> nativeRouteChecks;  // route text hash -> last comparison
+    void ReportAirways();
+
+    // Per-flight match diagnostics (".loa diag <callsign>|all|off"), written to the log
+    enum DiagnosticsMode { DIAG_OFF, DIAG_FLIGHT, DIAG_ALL };
+    DiagnosticsMode diagMode = DIAG_OFF;
+    std::string diagCallsign;
+    bool IsDiagnosticFlight(const std::string& callsign) const {
+        return diagMode != DIAG_OFF && (diagMode == DIAG_ALL || callsign == diagCallsign);
+    }
 
     void CleanupCache(const std::string& callsign);
     virtual void OnFlightPlanStateChange(EuroScopePlugIn::CFlightPlan fp);
     virtual void OnFlightPlanCoordinationStateChange(EuroScopePlugIn::CFlightPlan fp, int coordinationType, int newState);
+    virtual void OnFlightPlanControllerAssignedDataUpdate(EuroScopePlugIn::CFlightPlan fp, int dataType);
 
     virtual void OnGetTagItem(
         EuroScopePlugIn::CFlightPlan flightPlan,
@@ -159,13 +347,53 @@ public:
 
 private:
     std::string loadedSector;
-    void LoadLOAsFromJSON();
+    std::vector<std::string> loadedSectors;    // every sector the loaded rules were merged from
+    std::vector<std::string> ownedSectorsOverride;  // ".loa sectors", empty = from bandboxes.json
+
+    // Config loads run on a worker and are installed from the timer. Nothing
+    // loads before the first timer callback, so EuroScope's startup only pays
+    // for the constructor.
+    struct ConfigLoad {
+        std::string sector;
+        std::vector<std::string> sectors;
+        std::vector<std::string> filePaths;
+        LoaPreparedConfig config;
+        LoaMergeReport report;
+        std::string error;
+        bool ok = false;
+        double discoverMs = 0;
+        double parseMs = 0;
+        LoaAirwayGraph airways;
+        std::string airwaysError;  // empty when there was no file to read
+        bool airwaysOk = false;
+    };
+    void LoadLOAsFromJSON(bool force = false);
+    void InstallConfigLoad();
+    std::unique_ptr<ConfigLoad> configLoad;   // in flight while set
+    std::thread configLoadWorker;
+    std::atomic<bool> configLoadReady{ false };
+    bool configReloadWanted = false;          // a forced load arrived while one was in flight
+    bool idleReached = false;                 // first timer callback seen
+    std::chrono::steady_clock::time_point constructedAt;
 
     std::unordered_set<std::string> cachedOnlineControllers;  // ✅ Cached online controllers
     ULONGLONG lastOnlineFetchTime = 0;
+    bool onlineFetched = false;  // the first fetch has no earlier set to diff against
+
+    bool IsSectorController(EuroScopePlugIn::CController& controller);
+    void UpdateControllerFrequency(EuroScopePlugIn::CController& controller);
+    const LOAEntry* EvaluateNow(const EuroScopePlugIn::CFlightPlan& fp, bool inlineRun);
+    void WarmUp(const EuroScopePlugIn::CFlightPlan& fp);
+    EuroScopePlugIn::CPosition myPosition;  // refreshed by the timer
+    bool hasMyPosition = false;
+
+    // Callback recording (".loa record start|stop"), see LoaTrace.h
+    void TraceFlight(int recordType, EuroScopePlugIn::CFlightPlan& fp, const int* extra, int extraCount);
+    void TraceController(int recordType, EuroScopePlugIn::CController& controller);
 };
 
 // =============================
 // Plugin Instance
 // =============================
-extern LOAPlugin plugin;
\ No newline at end of file
+// The one instance, created by EuroScopePlugInInit (LOAPlugin2.cpp)
+extern LOAPlugin* plugin;
\ No newline at end of file
@@ -1,21 +1,20 @@
-// NonDiscreteSquawk.cpp : Defines the exported functions for the DLL application.
+// LOAPlugin2.cpp : Defines the exported functions for the DLL application.
 //
 
 #include "stdafx.h"
 #include "LOAPlugin.h"
 
-LOAPlugin* pMyPlugIn = NULL;
-
 void __declspec (dllexport)
 EuroScopePlugInInit(EuroScopePlugIn::CPlugIn** ppPlugInInstance)
 {
-	// allocate
-	*ppPlugInInstance = pMyPlugIn =
+	// allocate the one instance (see LOAPlugin.h)
+	*ppPlugInInstance = plugin =
 		new LOAPlugin;
 }
 
 void __declspec (dllexport)
 EuroScopePlugInExit(void)
 {
-	delete pMyPlugIn;
+	delete plugin;
+	plugin = nullptr;
 }
\ No newline at end of file
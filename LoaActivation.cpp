@@ -0,0 +1,183 @@
+﻿// =========================
+// File: LoaActivation.cpp
+// =========================
+
+#include "LoaActivation.h"
+#include "LoaRules.h"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+
+LoaActivationSchedule loaActivation;
+
+uint64_t LoaUtcNow()
+{
+    return (uint64_t)time(nullptr);
+}
+
+bool ParseLoaActivationWindow(const std::string& text, LoaActivationWindow& window)
+{
+    if (text.size() != 9 || text[4] != '-') return false;
+    for (size_t i : { 0, 1, 2, 3, 5, 6, 7, 8 })
+        if (!isdigit((unsigned char)text[i])) return false;
+
+    auto minutes = [&](size_t at) { return ((text[at] - '0') * 10 + (text[at + 1] - '0')) * 60 + (text[at + 2] - '0') * 10 + (text[at + 3] - '0'); };
+    int from = minutes(0), to = minutes(5);
+    if (from > 1440 || to > 1440 || text[2] > '5' || text[7] > '5') return false;
+    window.fromMinute = from % 1440;
+    window.toMinute = to % 1440;
+    return true;
+}
+
+// =============================
+// Timer wheel
+// =============================
+
+void LoaTimerWheel::Reset(uint64_t nowMinute)
+{
+    for (auto& level : slots)
+        for (auto& slot : level) slot.clear();
+    current = nowMinute;
+    pending = 0;
+}
+
+void LoaTimerWheel::Schedule(uint64_t dueMinute, uint32_t id)
+{
+    Place({ std::max(dueMinute, current + 1), id });
+    pending++;
+}
+
+void LoaTimerWheel::Place(const Timer& timer)
+{
+    // Inside Advance a timer due now lands in the slot about to fire
+    uint64_t due = std::max(timer.due, current);
+    uint64_t delta = due - current;
+    int level = 0;
+    while (level < kLevels - 1 && delta >= (1ull << (kBits * (level + 1)))) level++;
+    slots[level][(due >> (kBits * level)) & (kSlots - 1)].push_back(timer);
+}
+
+void LoaTimerWheel::Cascade(int level)
+{
+    std::vector<Timer> moving;
+    moving.swap(slots[level][(current >> (kBits * level)) & (kSlots - 1)]);
+    for (const auto& timer : moving) Place(timer);
+}
+
+void LoaTimerWheel::Advance(uint64_t nowMinute, std::vector<uint32_t>& due)
+{
+    while (current < nowMinute && pending > 0) {
+        current++;
+        // Higher levels first, so their timers can still land in this tick's slot
+        for (int level = kLevels - 1; level > 0; --level)
+            if ((current & ((1ull << (kBits * level)) - 1)) == 0) Cascade(level);
+
+        std::vector<Timer> firing;
+        firing.swap(slots[0][current & (kSlots - 1)]);
+        for (const auto& timer : firing) {
+            if (timer.due <= current) {
+                due.push_back(timer.id);
+                pending--;
+            }
+            else {
+                Place(timer);  // a top-level timer more than one turn ahead
+            }
+        }
+    }
+    current = std::max(current, nowMinute);
+}
+
+// =============================
+// Activation schedule
+// =============================
+
+bool LoaRuleActiveAt(const LOAEntry& entry, uint64_t nowMinute, const std::unordered_set<std::string>& conditions)
+{
+    if (!entry.activeWhen.empty() && !conditions.count(entry.activeWhen)) return false;
+    if (entry.activeUtc.empty()) return true;
+
+    int minute = (int)(nowMinute % 1440);
+    return std::any_of(entry.activeUtc.begin(), entry.activeUtc.end(), [&](const LoaActivationWindow& w) {
+        if (w.fromMinute == w.toMinute) return true;
+        if (w.fromMinute < w.toMinute) return minute >= w.fromMinute && minute < w.toMinute;
+        return minute >= w.fromMinute || minute < w.toMinute;
+    });
+}
+
+bool LoaActivationSchedule::Evaluate(const LOAEntry& entry, uint64_t nowMinute) const
+{
+    return LoaRuleActiveAt(entry, nowMinute, conditions);
+}
+
+void LoaActivationSchedule::ScheduleNext(uint32_t id, uint64_t nowMinute)
+{
+    const LOAEntry& entry = *rules[id];
+    if (entry.activeUtc.empty()) return;
+
+    // Next window edge strictly after now; the flag can only change there
+    int minute = (int)(nowMinute % 1440);
+    int next = 1440;
+    for (const auto& w : entry.activeUtc) {
+        for (int edge : { w.fromMinute, w.toMinute }) {
+            int delta = (edge - minute + 1440) % 1440;
+            if (delta == 0) delta = 1440;
+            next = std::min(next, delta);
+        }
+    }
+    wheel.Schedule(nowMinute + next, id);
+}
+
+void LoaActivationSchedule::Update(uint32_t id, uint64_t nowMinute, std::vector<const LOAEntry*>& changed)
+{
+    LOAEntry& entry = *rules[id];
+    bool active = Evaluate(entry, nowMinute);
+    if (active == entry.active) return;
+    entry.active = active;
+    transitions++;
+    changed.push_back(&entry);
+}
+
+void LoaActivationSchedule::Rebuild(uint64_t nowUtcSeconds)
+{
+    rules.clear();
+    byCondition.clear();
+    lastMinute = nowUtcSeconds / 60;
+    wheel.Reset(lastMinute);
+
+    for (auto* list : { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas }) {
+        for (auto& entry : *list) {
+            if (entry.activeUtc.empty() && entry.activeWhen.empty()) {
+                entry.active = true;
+                continue;
+            }
+            uint32_t id = (uint32_t)rules.size();
+            rules.push_back(&entry);
+            if (!entry.activeWhen.empty()) byCondition[entry.activeWhen].push_back(id);
+            entry.active = Evaluate(entry, lastMinute);
+            ScheduleNext(id, lastMinute);
+        }
+    }
+}
+
+void LoaActivationSchedule::Advance(uint64_t nowUtcSeconds, std::vector<const LOAEntry*>& changed)
+{
+    uint64_t nowMinute = nowUtcSeconds / 60;
+    if (nowMinute <= lastMinute) return;
+    lastMinute = nowMinute;
+
+    std::vector<uint32_t> due;
+    wheel.Advance(nowMinute, due);
+    for (uint32_t id : due) {
+        Update(id, nowMinute, changed);
+        ScheduleNext(id, nowMinute);
+    }
+}
+
+void LoaActivationSchedule::SetCondition(const std::string& name, bool on, std::vector<const LOAEntry*>& changed)
+{
+    if (on ? !conditions.insert(name).second : conditions.erase(name) == 0) return;
+
+    auto it = byCondition.find(name);
+    if (it == byCondition.end()) return;
+    for (uint32_t id : it->second) Update(id, lastMinute, changed);
+}
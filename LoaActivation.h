@@ -0,0 +1,88 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct LOAEntry;
+
+// =============================
+// Rule Activation Windows
+// =============================
+// A rule may be limited to UTC time windows ("activeUtc": ["2200-0600"]) and/or
+// to a named condition toggled with ".loa condition <name> on|off"
+// ("activeWhen": "TRA_ACTIVE"). The matchers only read LOAEntry::active; it is
+// flipped here at transition times, never tested against the clock per match.
+
+struct LoaActivationWindow {
+    int fromMinute = 0;  // minutes into the UTC day; from > to wraps past midnight
+    int toMinute = 0;    // exclusive; from == to is the whole day
+};
+
+// "2200-0600" -> { 1320, 360 }; false if malformed
+bool ParseLoaActivationWindow(const std::string& text, LoaActivationWindow& window);
+
+// Whether a rule applies at a UTC minute with the given named conditions on
+bool LoaRuleActiveAt(const LOAEntry& entry, uint64_t nowMinute, const std::unordered_set<std::string>& conditions);
+
+// Hierarchical timing wheel with one-minute ticks: three levels of 64 slots
+// reach about 68 hours ahead in O(1) per timer; further timers wait in the top
+// level and are re-placed as it turns.
+class LoaTimerWheel {
+public:
+    void Reset(uint64_t nowMinute);
+    void Schedule(uint64_t dueMinute, uint32_t id);
+    // Moves the wheel to nowMinute, appending every id that came due
+    void Advance(uint64_t nowMinute, std::vector<uint32_t>& due);
+    size_t Pending() const { return pending; }
+
+private:
+    static const int kLevels = 3;
+    static const int kBits = 6;
+    static const int kSlots = 1 << kBits;
+
+    struct Timer {
+        uint64_t due;
+        uint32_t id;
+    };
+
+    void Place(const Timer& timer);
+    void Cascade(int level);
+
+    std::vector<Timer> slots[kLevels][kSlots];
+    uint64_t current = 0;
+    size_t pending = 0;
+};
+
+class LoaActivationSchedule {
+public:
+    // Indexes the windowed/conditioned rules of the loaded lists and sets
+    // every rule's active flag for the given time
+    void Rebuild(uint64_t nowUtcSeconds);
+
+    // Rules whose active flag flipped since the last call
+    void Advance(uint64_t nowUtcSeconds, std::vector<const LOAEntry*>& changed);
+    void SetCondition(const std::string& name, bool on, std::vector<const LOAEntry*>& changed);
+
+    const std::unordered_set<std::string>& GetConditions() const { return conditions; }
+    size_t ScheduledRules() const { return rules.size(); }
+    unsigned long long transitions = 0;  // active flags flipped
+
+private:
+    bool Evaluate(const LOAEntry& entry, uint64_t nowMinute) const;
+    void Update(uint32_t id, uint64_t nowMinute, std::vector<const LOAEntry*>& changed);
+    void ScheduleNext(uint32_t id, uint64_t nowMinute);
+
+    std::vector<LOAEntry*> rules;  // timer ids index this
+    std::unordered_map<std::string, std::vector<uint32_t>> byCondition;
+    std::unordered_set<std::string> conditions;  // named conditions currently on; kept across reloads
+    LoaTimerWheel wheel;
+    uint64_t lastMinute = 0;
+};
+
+extern LoaActivationSchedule loaActivation;
+
+// Seconds since the epoch, UTC
+uint64_t LoaUtcNow();
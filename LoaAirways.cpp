@@ -0,0 +1,318 @@
+﻿// =========================
+// File: LoaAirways.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaAirways.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+LoaAirwayGraph loaAirways;
+const uint32_t LoaAirwayGraph::kNone;
+const uint32_t LoaAirwayGraph::kUnnamed;
+
+namespace {
+
+std::string Upper(std::string s)
+{
+    for (auto& ch : s) ch = (char)toupper((unsigned char)ch);
+    return s;
+}
+
+// "N052.18.30.000" (hemisphere, degrees, minutes, seconds)
+bool ParseSctCoordinate(const std::string& text, const char* hemispheres, double& value)
+{
+    if (text.size() < 2) return false;
+    char h = (char)toupper((unsigned char)text[0]);
+    if (h != hemispheres[0] && h != hemispheres[1]) return false;
+    int degrees = 0, minutes = 0;
+    double seconds = 0;
+    if (sscanf(text.c_str() + 1, "%d.%d.%lf", &degrees, &minutes, &seconds) != 3) return false;
+    value = degrees + minutes / 60.0 + seconds / 3600.0;
+    if (h == hemispheres[1]) value = -value;
+    return true;
+}
+
+// Same point whether a file writes it as coordinates or by name
+int64_t PositionKey(double lat, double lon)
+{
+    return (int64_t)std::llround((lat + 90) * 1e4) * 4000000 + (int64_t)std::llround((lon + 180) * 1e4);
+}
+
+// Speed/level groups: N0450F350, M082F370, K0830S1000
+bool IsSpeedLevel(const std::string& token)
+{
+    return token.size() >= 8 && (token[0] == 'N' || token[0] == 'K' || token[0] == 'M') && isdigit((unsigned char)token[1]);
+}
+
+} // namespace
+
+void LoaAirwayGraph::Clear()
+{
+    path.clear();
+    names.clear();
+    nameIds.clear();
+    firstNodeOfName.clear();
+    nodes.clear();
+    linkStart.assign(1, 0);
+    links.clear();
+    airwayNames.clear();
+    airwayIds.clear();
+    segments.clear();
+    segmentStats = SegmentStats();
+}
+
+bool LoaAirwayGraph::Load(const std::string& file, std::string& error)
+{
+    std::ifstream in(file);
+    if (!in) {
+        error = "cannot open " + file;
+        return false;
+    }
+    Clear();
+
+    std::unordered_map<int64_t, uint32_t> byPosition;
+    auto addName = [&](const std::string& name) -> uint32_t {
+        auto it = nameIds.find(name);
+        if (it != nameIds.end()) return it->second;
+        names.push_back(name);
+        firstNodeOfName.push_back(kNone);
+        return nameIds[name] = (uint32_t)names.size() - 1;
+    };
+    auto addNode = [&](uint32_t name, double lat, double lon) -> uint32_t {
+        Node node = { name, kNone, (float)lat, (float)lon };
+        uint32_t id = (uint32_t)nodes.size();
+        if (name != kUnnamed) {
+            // Appended at the end of the name's chain, so the first definition stays first
+            uint32_t* tail = &firstNodeOfName[name];
+            while (*tail != kNone) tail = &nodes[*tail].nextSameName;
+            *tail = id;
+        }
+        nodes.push_back(node);
+        byPosition.emplace(PositionKey(lat, lon), id);
+        return id;
+    };
+
+    // Airway lines may come before the points they name; they are resolved last
+    struct AirwayLine {
+        std::string airway;
+        std::string ends[4];  // lat, lon, lat, lon (or name, name, name, name)
+    };
+    std::vector<AirwayLine> airwayLines;
+
+    enum { OTHER, NAVAIDS, FIXES, AIRWAYS } section = OTHER;
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t comment = line.find(';');
+        if (comment != std::string::npos) line.erase(comment);
+        std::istringstream tokens(line);
+        std::vector<std::string> t;
+        for (std::string token; tokens >> token;) t.push_back(token);
+        if (t.empty()) continue;
+
+        if (t[0][0] == '[') {
+            std::string header = Upper(line.substr(line.find('['), line.find(']') - line.find('[') + 1));
+            section = header == "[VOR]" || header == "[NDB]" ? NAVAIDS : header == "[FIXES]" ? FIXES
+                : header == "[HIGH AIRWAY]" || header == "[LOW AIRWAY]" ? AIRWAYS : OTHER;
+            continue;
+        }
+
+        double lat = 0, lon = 0;
+        switch (section) {
+        case NAVAIDS:  // name frequency lat lon
+            if (t.size() >= 4 && ParseSctCoordinate(t[2], "NS", lat) && ParseSctCoordinate(t[3], "EW", lon))
+                addNode(addName(Upper(t[0])), lat, lon);
+            break;
+        case FIXES:    // name lat lon
+            if (t.size() >= 3 && ParseSctCoordinate(t[1], "NS", lat) && ParseSctCoordinate(t[2], "EW", lon))
+                addNode(addName(Upper(t[0])), lat, lon);
+            break;
+        case AIRWAYS: {
+            if (t.size() < 5) break;
+            AirwayLine a;
+            size_t n = t.size() - 4;
+            for (size_t i = 0; i < n; ++i) a.airway += (i ? " " : "") + t[i];
+            a.airway = Upper(a.airway);
+            for (int i = 0; i < 4; ++i) a.ends[i] = t[n + i];
+            airwayLines.push_back(a);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // A segment end is a position (named if a point was defined there) or a point's name
+    auto resolve = [&](const std::string& latText, const std::string& lonText) -> uint32_t {
+        double lat = 0, lon = 0;
+        if (ParseSctCoordinate(latText, "NS", lat) && ParseSctCoordinate(lonText, "EW", lon)) {
+            auto it = byPosition.find(PositionKey(lat, lon));
+            return it != byPosition.end() ? it->second : addNode(kUnnamed, lat, lon);
+        }
+        uint32_t name = NameId(Upper(latText));
+        return name == kNone ? kNone : firstNodeOfName[name];
+    };
+
+    std::vector<Link> pending;  // node a -> (node b, airway), both directions
+    std::vector<uint32_t> from;
+    for (const auto& a : airwayLines) {
+        uint32_t first = resolve(a.ends[0], a.ends[1]);
+        uint32_t second = resolve(a.ends[2], a.ends[3]);
+        if (first == kNone || second == kNone || first == second) continue;
+
+        auto it = airwayIds.find(a.airway);
+        uint32_t airway;
+        if (it == airwayIds.end()) {
+            airway = (uint32_t)airwayNames.size();
+            airwayNames.push_back(a.airway);
+            airwayIds[a.airway] = airway;
+        }
+        else {
+            airway = it->second;
+        }
+        from.push_back(first);
+        pending.push_back({ second, airway });
+        from.push_back(second);
+        pending.push_back({ first, airway });
+    }
+
+    // Compressed adjacency: count, prefix-sum, fill
+    linkStart.assign(nodes.size() + 1, 0);
+    for (uint32_t node : from) linkStart[node + 1]++;
+    for (size_t i = 0; i < nodes.size(); ++i) linkStart[i + 1] += linkStart[i];
+    links.resize(pending.size());
+    std::vector<uint32_t> fill(linkStart.begin(), linkStart.end() - 1);
+    for (size_t i = 0; i < pending.size(); ++i) links[fill[from[i]]++] = pending[i];
+
+    if (nodes.empty() || links.empty()) {
+        error = file + " has no airways";
+        Clear();
+        return false;
+    }
+    path = file;
+    return true;
+}
+
+uint32_t LoaAirwayGraph::NameId(const std::string& upper) const
+{
+    auto it = nameIds.find(upper);
+    return it == nameIds.end() ? kNone : it->second;
+}
+
+uint32_t LoaAirwayGraph::AirwayId(const std::string& upper) const
+{
+    auto it = airwayIds.find(upper);
+    return it == airwayIds.end() ? kNone : it->second;
+}
+
+uint32_t LoaAirwayGraph::NearestNode(uint32_t name, uint32_t from) const
+{
+    uint32_t best = firstNodeOfName[name];
+    if (from == kNone || nodes[best].nextSameName == kNone) return best;
+
+    // Names repeat across regions (navaid idents especially): take the closest one
+    double bestDistance = 1e30;
+    double lonScale = std::cos(nodes[from].lat * 3.14159265358979 / 180);
+    for (uint32_t n = best; n != kNone; n = nodes[n].nextSameName) {
+        double dLat = nodes[n].lat - nodes[from].lat;
+        double dLon = (nodes[n].lon - nodes[from].lon) * lonScale;
+        double distance = dLat * dLat + dLon * dLon;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = n;
+        }
+    }
+    return best;
+}
+
+const std::vector<uint32_t>* LoaAirwayGraph::Segment(uint32_t entryNode, uint32_t airway, uint32_t exitName) const
+{
+    uint64_t key = ((uint64_t)entryNode << 42) | ((uint64_t)(airway & 0xFFFFF) << 22) | (exitName & 0x3FFFFF);
+    auto cached = segments.find(key);
+    if (cached != segments.end()) {
+        segmentStats.hits++;
+        return cached->second.connected ? &cached->second.nodes : nullptr;
+    }
+    segmentStats.searches++;
+
+    // Breadth first along the airway's links only, from the entry the route
+    // resolved: another point of the same name may lie on an airway of the same
+    // name elsewhere
+    std::unordered_map<uint32_t, uint32_t> parent;
+    std::vector<uint32_t> queue;
+    parent[entryNode] = kNone;
+    queue.push_back(entryNode);
+    uint32_t exit = kNone;
+    for (size_t head = 0; head < queue.size() && exit == kNone; ++head) {
+        uint32_t node = queue[head];
+        for (uint32_t l = linkStart[node]; l < linkStart[node + 1]; ++l) {
+            if (links[l].airway != airway || parent.count(links[l].to)) continue;
+            parent[links[l].to] = node;
+            if (nodes[links[l].to].name == exitName) {
+                exit = links[l].to;
+                break;
+            }
+            queue.push_back(links[l].to);
+        }
+    }
+
+    CachedSegment& segment = segments[key];
+    segment.connected = exit != kNone;
+    for (uint32_t n = exit; n != kNone && parent[n] != kNone; n = parent[n]) segment.nodes.push_back(n);
+    std::reverse(segment.nodes.begin(), segment.nodes.end());
+    return segment.connected ? &segment.nodes : nullptr;
+}
+
+bool LoaAirwayGraph::ExpandRoute(const char* routeText, const std::string& origin, const std::string& destination,
+    std::vector<std::string>& out) const
+{
+    out.clear();
+    if (!IsLoaded() || !routeText) return false;
+
+    // Points and airways only: "SUPUR/N0450F360" is SUPUR, speed/level groups and DCT go
+    std::vector<std::string> tokens;
+    std::string token;
+    for (const char* p = routeText; *p;) {
+        while (*p && isspace((unsigned char)*p)) ++p;
+        token.clear();
+        for (; *p && !isspace((unsigned char)*p); ++p) token += (char)toupper((unsigned char)*p);
+        token.erase(std::min(token.find('/'), token.size()));
+        if (token.empty() || token == "DCT" || IsSpeedLevel(token) || token == origin || token == destination) continue;
+        tokens.push_back(token);
+    }
+
+    out.push_back(origin);
+    uint32_t previous = kNone;
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        uint32_t airway = AirwayId(tokens[i]);
+        if (airway != kNone && previous != kNone && i + 1 < tokens.size()) {
+            uint32_t exitName = NameId(tokens[i + 1]);
+            const std::vector<uint32_t>* segment = exitName == kNone ? nullptr : Segment(previous, airway, exitName);
+            if (segment) {
+                for (uint32_t n : *segment)
+                    if (nodes[n].name != kUnnamed) out.push_back(names[nodes[n].name]);
+                previous = segment->back();
+                ++i;
+                continue;
+            }
+        }
+
+        uint32_t name = NameId(tokens[i]);
+        if (name == kNone) return false;
+        previous = NearestNode(name, previous);
+        out.push_back(names[name]);
+    }
+    out.push_back(destination);
+    return true;
+}
+
+LoaAirwayGraph::SegmentStats LoaAirwayGraph::GetSegmentStats() const
+{
+    SegmentStats s = segmentStats;
+    s.cached = segments.size();
+    return s;
+}
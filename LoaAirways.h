@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// =============================
+// Native Route Expansion
+// =============================
+// Airways and fixes read from a sector file (loa_configs_json\airways.sct by
+// default, or ".loa airways <file>"): the [VOR], [NDB] and [FIXES] sections
+// name the points, [HIGH AIRWAY] and [LOW AIRWAY] connect them. An airway
+// segment end may be written as coordinates or as a fix name repeated for
+// latitude and longitude:
+//
+//   UL607 N051.11.23.000 E003.57.41.000 N050.54.12.000 E004.28.03.000
+//   UL607 SPI SPI KOK KOK
+//
+// The points become nodes of a compact graph: one array of links per node
+// (CSR), each link tagged with its airway. ExpandRoute turns filed route text
+// into the point list GetExtractedRoute would give. "ENTRY UL607 EXIT" is
+// expanded by a search along UL607 starting at ENTRY, the point of that name
+// nearest the route's previous point. Expanded segments are memoized by (entry
+// point, airway, exit fix), so a segment many flights file is searched once. Routes with tokens the graph cannot resolve (SIDs and
+// STARs, coordinates, unknown names) are left to the SDK.
+
+class LoaAirwayGraph {
+public:
+    bool Load(const std::string& path, std::string& error);
+    void Clear();
+    bool IsLoaded() const { return !nodes.empty(); }
+    const std::string& GetPath() const { return path; }
+
+    size_t NodeCount() const { return nodes.size(); }
+    size_t AirwayCount() const { return airwayNames.size(); }
+    size_t LinkCount() const { return links.size(); }
+
+    // Origin, the route's points with airways expanded, destination. False
+    // (out unspecified) if some token cannot be resolved.
+    bool ExpandRoute(const char* routeText, const std::string& origin, const std::string& destination,
+        std::vector<std::string>& out) const;
+
+    struct SegmentStats {
+        unsigned long long hits = 0;
+        unsigned long long searches = 0;   // segments expanded by a graph search
+        size_t cached = 0;
+    };
+    SegmentStats GetSegmentStats() const;
+    void ClearSegmentCache() const { segments.clear(); }
+
+private:
+    struct Node {
+        uint32_t name;        // index into names; kUnnamed for bare coordinates
+        uint32_t nextSameName;  // next node with this name, kNone at the end
+        float lat, lon;
+    };
+    struct Link {
+        uint32_t to;
+        uint32_t airway;
+    };
+    static const uint32_t kNone = 0xFFFFFFFF;
+    static const uint32_t kUnnamed = 0xFFFFFFFE;
+
+    uint32_t NameId(const std::string& upper) const;
+    uint32_t AirwayId(const std::string& upper) const;
+    uint32_t NearestNode(uint32_t name, uint32_t from) const;
+
+    // Nodes after the entry node up to and including the exit, nullptr if the
+    // airway does not connect the two
+    const std::vector<uint32_t>* Segment(uint32_t entryNode, uint32_t airway, uint32_t exitName) const;
+
+    std::string path;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, uint32_t> nameIds;
+    std::vector<uint32_t> firstNodeOfName;
+    std::vector<Node> nodes;
+    std::vector<uint32_t> linkStart;  // links of node i: [linkStart[i], linkStart[i + 1])
+    std::vector<Link> links;
+    std::vector<std::string> airwayNames;
+    std::unordered_map<std::string, uint32_t> airwayIds;
+
+    struct CachedSegment {
+        bool connected = false;
+        std::vector<uint32_t> nodes;
+    };
+    mutable std::unordered_map<uint64_t, CachedSegment> segments;
+    mutable SegmentStats segmentStats;
+};
+
+extern LoaAirwayGraph loaAirways;
@@ -0,0 +1,80 @@
+﻿// =========================
+// File: LoaAltitudeProfile.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaAltitudeProfile.h"
+#include "LOAPlugin.h"
+#include "LoaPredicate.h"
+
+void BuildTagAltitudeTables(LoaFlightProfile& profile, const EuroScopePlugIn::CFlightPlan& fp,
+    const std::string& origin, const std::string& destination, int finalAltitude,
+    const std::unordered_set<std::string>& onlineControllers, LoaRouteWaypoints& route)
+{
+    // Same rule programs as the matcher, minus the tracking-sector condition
+    LoaPredicateRun run;
+    run.fp = &fp;
+    run.route = &route;
+    run.onlineControllers = &onlineControllers;
+    run.matcher = false;
+    loaPredicates.Begin(run, origin, destination, std::string());
+
+    auto matches = [&](const LOAEntry& entry) -> bool {
+        return entry.active && loaPredicates.Run(entry, run);
+        };
+
+    auto firstMatch = [&](const std::vector<LOAEntry>& list) -> const LOAEntry* {
+        for (const auto& entry : list)
+            if (matches(entry)) return &entry;
+        return nullptr;
+        };
+
+    // Stage 1: the first match of each list, in tag order, and the fallback
+    // entries whose only remaining condition is the altitude
+    const LOAEntry* dep = firstMatch(departureLoas);
+    const LOAEntry* dest = firstMatch(destinationLoas);
+    const LOAEntry* lorDep = firstMatch(lorDepartures);
+    const LOAEntry* lorArr = firstMatch(lorArrivals);
+
+    std::vector<const LOAEntry*> fallbacks;
+    for (const auto& entry : fallbackLoas)
+        if (matches(entry)) fallbacks.push_back(&entry);
+
+    // XFL items use the first match over all lists; departures count down to the
+    // XFL, arrivals from above it
+    const LOAEntry* first = dep ? dep : dest ? dest : lorDep ? lorDep : lorArr;
+    bool departure = dep || (!dest && lorDep);
+    std::string finalText = std::to_string(finalAltitude / 100);
+
+    std::vector<int> points = { finalAltitude };
+    for (const LOAEntry* e : { dep, dest, lorDep, lorArr })
+        if (e) points.push_back(e->xfl * 100);
+    for (const LOAEntry* e : fallbacks) points.push_back(e->minAltitudeFt);
+
+    // Stage 2 of each tag item, tabulated
+    profile.xfl.Build(points, [&](int cleared) -> std::string {
+        if (!first) return cleared == finalAltitude ? std::string() : finalText;
+        int xfl = first->xfl * 100;
+        if (departure && cleared < xfl && finalAltitude > xfl) return std::to_string(first->xfl);
+        if (!departure && cleared > xfl) return std::to_string(first->xfl);
+        if (cleared == xfl || cleared == finalAltitude) return std::string();
+        return finalText;
+        });
+
+    profile.xflDetailed.Build(points, [&](int cleared) -> std::string {
+        if (!first) return finalText;
+        int xfl = first->xfl * 100;
+        if (departure) return (cleared <= xfl && finalAltitude > xfl) ? std::to_string(first->xfl) : finalText;
+        return cleared < xfl ? std::string("XFL") : std::to_string(first->xfl);
+        });
+
+    profile.cop.Build(points, [&](int cleared) -> std::string {
+        if (dep && cleared <= dep->xfl * 100) return dep->copText;
+        if (dest && cleared >= dest->xfl * 100) return dest->copText;
+        if (lorDep && cleared <= lorDep->xfl * 100) return lorDep->copText;
+        if (lorArr && cleared >= lorArr->xfl * 100) return lorArr->copText;
+        for (const LOAEntry* e : fallbacks)
+            if (cleared >= e->minAltitudeFt) return e->copText;
+        return std::string("COPX");
+        });
+}
@@ -0,0 +1,85 @@
+﻿#pragma once
+
+#include "EuroScopePlugIn.h"
+#include <algorithm>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct LOAEntry;
+class LoaRouteWaypoints;
+
+// =============================
+// Altitude Tables
+// =============================
+// LOA outputs depend on the cleared altitude only through threshold comparisons
+// (entry.xfl * 100, minAltitudeFt, the final altitude), so between two thresholds
+// the output cannot change. Once the route/airport/sector stage has picked the
+// candidate entries, the output for every cleared altitude fits in a sorted
+// breakpoint table and a level change is a binary search.
+template <typename T>
+class LoaAltitudeTable {
+public:
+    // evaluate(altitude) is the altitude stage; it is called once per breakpoint
+    // and once per interval between breakpoints
+    template <typename Evaluate>
+    void Build(std::vector<int> points, Evaluate evaluate)
+    {
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        breakpoints = points;
+        at.clear();
+        above.clear();
+        below = evaluate(points.empty() ? 0 : points.front() - 1);
+        for (int p : points) {
+            at.push_back(evaluate(p));
+            above.push_back(evaluate(p + 1));
+        }
+        built = true;
+    }
+
+    const T& Lookup(int altitude) const
+    {
+        size_t i = std::upper_bound(breakpoints.begin(), breakpoints.end(), altitude) - breakpoints.begin();
+        if (i == 0) return below;
+        return breakpoints[i - 1] == altitude ? at[i - 1] : above[i - 1];
+    }
+
+    // True when some cleared altitude maps to value
+    bool Contains(const T& value) const
+    {
+        return built && (below == value || std::find(at.begin(), at.end(), value) != at.end() ||
+            std::find(above.begin(), above.end(), value) != above.end());
+    }
+
+    bool IsBuilt() const { return built; }
+    void Reset() { built = false; }
+    size_t Size() const { return breakpoints.size(); }
+
+private:
+    std::vector<int> breakpoints;  // sorted, unique
+    std::vector<T> at;             // output at exactly breakpoints[i]
+    std::vector<T> above;          // output between breakpoints[i] and breakpoints[i + 1]
+    T below = T();                 // output below breakpoints[0]
+    bool built = false;
+};
+
+// Per-flight results of the altitude-independent stage
+struct LoaFlightProfile {
+    size_t key = 0;  // hash of every non-altitude input of the tag tables
+    unsigned long long builtAt = 0;
+
+    LoaAltitudeTable<std::string> xfl;          // "LOA XFL"
+    LoaAltitudeTable<std::string> xflDetailed;  // "LOA XFL Detailed"
+    LoaAltitudeTable<std::string> cop;          // "COP"
+
+    // MatchLoaEntry's result while it is cached (interpreter only)
+    LoaAltitudeTable<const LOAEntry*> match;
+};
+
+// Route/airport/sector stage of the XFL, XFL Detailed and COP tag items; fills
+// their altitude tables for the flight's current final altitude
+void BuildTagAltitudeTables(LoaFlightProfile& profile, const EuroScopePlugIn::CFlightPlan& fp,
+    const std::string& origin, const std::string& destination, int finalAltitude,
+    const std::unordered_set<std::string>& onlineControllers, LoaRouteWaypoints& route);
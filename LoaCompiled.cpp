@@ -0,0 +1,61 @@
+﻿// =========================
+// File: LoaCompiled.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaCompiled.h"
+#include "LOAPlugin.h"
+#include <algorithm>
+
+const LoaCompiledRuleset* activeCompiledRuleset = nullptr;
+
+// Function-local so generated files can register from their static initializers
+static std::vector<const LoaCompiledRuleset*>& CompiledRulesets()
+{
+    static std::vector<const LoaCompiledRuleset*> rulesets;
+    return rulesets;
+}
+
+void RegisterCompiledRuleset(const LoaCompiledRuleset* ruleset)
+{
+    CompiledRulesets().push_back(ruleset);
+}
+
+const LoaCompiledRuleset* FindCompiledRuleset(const std::string& positionId, uint64_t configHash)
+{
+    for (const LoaCompiledRuleset* r : CompiledRulesets()) {
+        if (configHash == r->configHash && _stricmp(positionId.c_str(), r->positionId) == 0)
+            return r;
+    }
+    return nullptr;
+}
+
+bool LoaSlowAirportMatch(const std::string& airport, const char* const* exact, int exactCount,
+    const char* const* prefixes, int prefixCount)
+{
+    for (int i = 0; i < exactCount; ++i)
+        if (airport == exact[i]) return true;
+    for (int i = 0; i < prefixCount; ++i) {
+        std::string prefix(prefixes[i]);
+        if (airport.compare(0, prefix.length(), prefix) == 0) return true;
+    }
+    return false;
+}
+
+bool LoaSlowAnyEqualsIgnoreCase(const std::string& value, const char* const* candidates, int count)
+{
+    for (int i = 0; i < count; ++i)
+        if (EqualsIgnoreCase(value, candidates[i])) return true;
+    return false;
+}
+
+bool LoaRouteHasInOrder(const std::vector<std::string>& routePoints, const char* const* waypoints, int count)
+{
+    auto pos = routePoints.begin();
+    for (int i = 0; i < count; ++i) {
+        pos = std::find_if(pos, routePoints.end(), [&](const std::string& r) { return EqualsIgnoreCase(r, waypoints[i]); });
+        if (pos == routePoints.end()) return false;
+        ++pos;
+    }
+    return true;
+}
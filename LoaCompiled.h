@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// =============================
+// Ahead-of-time compiled rulesets
+// =============================
+// tools/LoaCodegen.cpp turns a loa_configs_json file into a C++ source file with
+// the rules unrolled into specialized code: waypoint and airport lookups become
+// switch statements over names packed into 64-bit keys (an exact, collision-free
+// hash for names of up to 8 characters), and each rule becomes a handful of mask
+// tests. Generated files register themselves here; InstallConfigLoad activates
+// one only when both the position and the hash of the JSON it was generated from
+// match, so a stale build silently falls back to the interpreter.
+
+// LOA lists, in MatchLoaEntry's search order
+enum LoaListId {
+    LOA_LIST_NONE = -1,
+    LOA_LIST_DESTINATION = 0,
+    LOA_LIST_DEPARTURE = 1,
+    LOA_LIST_LOR_ARRIVALS = 2,
+    LOA_LIST_LOR_DEPARTURES = 3,
+    LOA_LIST_FALLBACK = 4
+};
+
+struct LoaMatchRef {
+    int list;
+    int index;
+};
+
+struct LoaCompiledInput {
+    const std::string* origin;
+    const std::string* destination;
+    const std::string* controller;
+    // Route point names, fetched on the first rule whose airports match (the
+    // route may have to be extracted)
+    const std::vector<std::string>& (*routePoints)(void* context);
+    void* routeContext;
+    const std::unordered_set<std::string>* onlineControllers;
+    int clearedAltitude;
+    std::vector<std::string>* dependsOn;  // sectors the result hinges on (see sectorDependents)
+};
+
+typedef LoaMatchRef(*LoaCompiledMatchFn)(const LoaCompiledInput& in);
+
+struct LoaCompiledRuleset {
+    const char* positionId;
+    uint64_t configHash;
+    int ruleCount;
+    LoaCompiledMatchFn match;
+};
+
+// Up to 8 bytes packed little-endian (first character in the low byte)
+struct LoaKey {
+    uint64_t value;
+    bool packed;
+};
+
+inline LoaKey PackLoaKey(const std::string& s, bool upper)
+{
+    LoaKey k = { 0, s.size() <= 8 };
+    if (!k.packed) return k;
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = (unsigned char)s[i];
+        if (upper && c >= 'a' && c <= 'z') c = (unsigned char)(c - 'a' + 'A');
+        k.value |= (uint64_t)c << (8 * i);
+    }
+    return k;
+}
+
+inline uint64_t LoaPrefixMask(size_t length)
+{
+    return length >= 8 ? ~0ull : ((1ull << (8 * length)) - 1);
+}
+
+// Airport lists that cannot be packed (names longer than 8 characters)
+bool LoaSlowAirportMatch(const std::string& airport, const char* const* exact, int exactCount,
+    const char* const* prefixes, int prefixCount);
+bool LoaSlowAnyEqualsIgnoreCase(const std::string& value, const char* const* candidates, int count);
+
+// Rules with waypointsOrdered: each waypoint appears after the previous one
+bool LoaRouteHasInOrder(const std::vector<std::string>& routePoints, const char* const* waypoints, int count);
+
+uint64_t HashLoaConfig(const std::string& bytes);
+
+void RegisterCompiledRuleset(const LoaCompiledRuleset* ruleset);
+const LoaCompiledRuleset* FindCompiledRuleset(const std::string& positionId, uint64_t configHash);
+
+struct LoaCompiledRegistrar {
+    explicit LoaCompiledRegistrar(const LoaCompiledRuleset* ruleset) { RegisterCompiledRuleset(ruleset); }
+};
+
+// Entry a LoaMatchRef points at in the loaded lists (nullptr for LOA_LIST_NONE)
+struct LOAEntry;
+const LOAEntry* ResolveLoaMatch(const LoaMatchRef& ref);
+
+// Rules with activation windows or conditions (see LoaActivation.h)
+bool LoaRuleActive(int list, int index);
+
+// Inverse of ResolveLoaMatch ({ LOA_LIST_NONE, -1 } for nullptr or a stale pointer)
+LoaMatchRef LocateLoaEntry(const LOAEntry* entry);
+
+// Ruleset MatchLoaEntry dispatches to, or nullptr for the JSON interpreter
+extern const LoaCompiledRuleset* activeCompiledRuleset;
@@ -0,0 +1,148 @@
+﻿// =========================
+// File: LoaExport.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaExport.h"
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool LoaResultPublisher::Start(const std::string& regionName)
+{
+    Stop();
+    mappedBytes = sizeof(LoaExportHeader) + LOA_EXPORT_CAPACITY * sizeof(LoaExportRecord);
+
+#ifdef _WIN32
+    std::string fullName = "Local\\" + regionName;
+    HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)mappedBytes, fullName.c_str());
+    if (!handle) return false;
+    void* view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, mappedBytes);
+    if (!view) {
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = handle;
+#else
+    std::string fullName = "/" + regionName;
+    int fd = shm_open(fullName.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)mappedBytes) != 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+
+    // Readers may still hold the region from an earlier run: invalidate the
+    // header first, clear the records, then publish the new header
+    memset(view, 0, sizeof(LoaExportHeader));
+    records = reinterpret_cast<LoaExportRecord*>(static_cast<char*>(view) + sizeof(LoaExportHeader));
+    for (size_t i = 0; i < LOA_EXPORT_CAPACITY; ++i) {
+        LoaExportRecord* r = new (&records[i]) LoaExportRecord();
+        r->sequence.store(0, std::memory_order_relaxed);
+        memset(&r->data, 0, sizeof(r->data));
+    }
+
+    header = new (view) LoaExportHeader();
+    header->version = LOA_EXPORT_VERSION;
+    header->headerSize = sizeof(LoaExportHeader);
+    header->recordSize = sizeof(LoaExportRecord);
+    header->capacity = (uint32_t)LOA_EXPORT_CAPACITY;
+    header->highWater.store(0, std::memory_order_relaxed);
+    header->configHash.store(0, std::memory_order_relaxed);
+    header->heartbeatMs.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, "LOAXPORT", 8);
+
+    name = regionName;
+    published.assign(LOA_EXPORT_CAPACITY, LoaExportData());
+    freeSlots.clear();
+    for (uint32_t i = (uint32_t)LOA_EXPORT_CAPACITY; i > 0; --i) freeSlots.push_back(i - 1);
+    slots.clear();
+    return true;
+}
+
+void LoaResultPublisher::Stop()
+{
+    if (!header) return;
+    memset(header->magic, 0, sizeof(header->magic));
+
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle((HANDLE)mapping);
+#else
+    munmap(header, mappedBytes);
+    shm_unlink(("/" + name).c_str());
+#endif
+    mapping = nullptr;
+    header = nullptr;
+    records = nullptr;
+    slots.clear();
+    freeSlots.clear();
+    published.clear();
+}
+
+void LoaResultPublisher::Write(uint32_t slot, const LoaExportData& data)
+{
+    LoaExportRecord& record = records[slot];
+    uint32_t sequence = record.sequence.load(std::memory_order_relaxed);
+    record.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&record.data, &data, sizeof(data));
+    record.sequence.store(sequence + 2, std::memory_order_release);
+
+    published[slot] = data;
+    if (slot >= header->highWater.load(std::memory_order_relaxed))
+        header->highWater.store(slot + 1, std::memory_order_release);
+    writes++;
+}
+
+void LoaResultPublisher::Publish(const LoaExportData& data)
+{
+    if (!header) return;
+
+    auto it = slots.find(data.callsign);
+    if (it == slots.end()) {
+        if (freeSlots.empty()) {
+            dropped++;
+            return;
+        }
+        it = slots.emplace(data.callsign, freeSlots.back()).first;
+        freeSlots.pop_back();
+    }
+    else {
+        LoaExportData previous = published[it->second];
+        previous.updatedMs = data.updatedMs;
+        if (memcmp(&previous, &data, sizeof(data)) == 0) return;
+    }
+    Write(it->second, data);
+}
+
+void LoaResultPublisher::Remove(const std::string& callsign)
+{
+    if (!header) return;
+
+    auto it = slots.find(callsign);
+    if (it == slots.end()) return;
+    LoaExportData empty;
+    memset(&empty, 0, sizeof(empty));
+    Write(it->second, empty);
+    freeSlots.push_back(it->second);
+    slots.erase(it);
+}
+
+void LoaResultPublisher::Heartbeat(uint64_t nowMs, uint64_t configHash)
+{
+    if (!header) return;
+    header->configHash.store(configHash, std::memory_order_relaxed);
+    header->heartbeatMs.store(nowMs, std::memory_order_release);
+}
@@ -0,0 +1,112 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// =============================
+// Shared-memory Result Export
+// =============================
+// Optional (".loa export on") table of per-flight LOA results for companion
+// tools, in a named shared-memory region: Local\<name> on Windows,
+// /<name> (shm_open) on Linux. Default name LOAPluginResults.
+//
+//   LoaExportHeader            64 bytes, magic "LOAXPORT", version 2
+//   LoaExportRecord[capacity]  128 bytes each
+//
+// One writer (the plugin's 1 s timer), any number of readers. Each record is
+// a seqlock: the writer makes its sequence odd, rewrites the payload and makes
+// it even again. A reader copies the payload between two reads of an even,
+// unchanged sequence (LoaExportTryRead); it never blocks the writer and gives
+// up after a few torn copies instead of spinning. Records [0, highWater) have
+// been used; an empty callsign marks a free slot. Strings are zero-padded.
+
+const size_t LOA_EXPORT_CAPACITY = 2048;
+const uint32_t LOA_EXPORT_VERSION = 2;  // 2: xfl and cop as the tag items show them
+#define LOA_EXPORT_DEFAULT_NAME "LOAPluginResults"
+
+struct LoaExportData {
+    char callsign[12];
+    int32_t ruleId;               // (list << 16) | index in the loaded config, -1 = no rule matched
+    int32_t xfl;                  // "LOA XFL" tag at the cleared altitude, 0 = blank
+    char cop[16];                 // "COP" tag without coordination (derived from the sector exit if no rule names one)
+    char nextSector[16];          // first online next sector, as the tag item shows it
+    int32_t exitAltitude;         // coordinated exit level and its COORDINATION_STATE_*
+    int32_t exitAltitudeState;
+    char exitPoint[16];
+    int32_t exitPointState;
+    uint64_t updatedMs;           // plugin GetTickCount64() at the last change
+};
+
+struct LoaExportRecord {
+    std::atomic<uint32_t> sequence;
+    uint32_t reserved;
+    LoaExportData data;
+    char padding[128 - 8 - sizeof(LoaExportData)];
+};
+
+struct LoaExportHeader {
+    char magic[8];                // "LOAXPORT"
+    uint32_t version;             // LOA_EXPORT_VERSION
+    uint32_t headerSize;          // sizeof(LoaExportHeader)
+    uint32_t recordSize;          // sizeof(LoaExportRecord)
+    uint32_t capacity;
+    std::atomic<uint32_t> highWater;
+    uint32_t reserved;
+    std::atomic<uint64_t> configHash;   // loadedConfigHash of the rules the results came from
+    std::atomic<uint64_t> heartbeatMs;  // refreshed every publish, also when nothing changed
+    char padding[64 - 48];
+};
+
+static_assert(sizeof(LoaExportRecord) == 128, "LoaExportRecord layout");
+static_assert(sizeof(LoaExportHeader) == 64, "LoaExportHeader layout");
+
+// Consistent copy of one record's payload, false if the writer kept it busy
+inline bool LoaExportTryRead(const LoaExportRecord& record, LoaExportData& out)
+{
+    for (int attempt = 0; attempt < 4; ++attempt) {
+        uint32_t before = record.sequence.load(std::memory_order_acquire);
+        if (before & 1) continue;
+        memcpy(&out, &record.data, sizeof(out));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (record.sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return false;
+}
+
+class LoaResultPublisher {
+public:
+    ~LoaResultPublisher() { Stop(); }
+
+    bool Start(const std::string& name);
+    void Stop();
+    bool IsRunning() const { return header != nullptr; }
+    const std::string& GetName() const { return name; }
+
+    // Rewrites the flight's record only if the payload changed since the last
+    // publish (updatedMs aside)
+    void Publish(const LoaExportData& data);
+    void Remove(const std::string& callsign);
+    void Heartbeat(uint64_t nowMs, uint64_t configHash);
+
+    size_t Size() const { return slots.size(); }
+    unsigned long long writes = 0;
+    unsigned long long dropped = 0;   // flights that found the table full
+
+private:
+    void Write(uint32_t slot, const LoaExportData& data);
+
+    std::string name;
+    void* mapping = nullptr;          // HANDLE on Windows, unused on Linux
+    LoaExportHeader* header = nullptr;
+    LoaExportRecord* records = nullptr;
+    size_t mappedBytes = 0;
+
+    std::unordered_map<std::string, uint32_t> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<LoaExportData> published;  // last payload per slot
+};
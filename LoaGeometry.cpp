@@ -0,0 +1,215 @@
+﻿// =========================
+// File: LoaGeometry.cpp
+// =========================
+
+#include "LoaGeometry.h"
+#include <algorithm>
+#include <cmath>
+
+LoaSectorGeometry loaGeometry;
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+double Cross(double ax, double ay, double bx, double by) { return ax * by - ay * bx; }
+
+} // namespace
+
+void LoaSectorGeometry::Build(const std::vector<std::vector<LoaGeoPoint>>& boundaries, const std::vector<LoaNamedPoint>& newCops)
+{
+    polygons.clear();
+    edges.clear();
+    cells.clear();
+    cops = newCops;
+    copPositions.clear();
+    generation++;
+
+    double latSum = 0;
+    size_t count = 0;
+    for (const auto& boundary : boundaries) {
+        if (boundary.size() < 3) continue;
+        for (const auto& p : boundary) latSum += p.lat;
+        count += boundary.size();
+    }
+    lonScale = count ? 60 * std::cos(latSum / count * kPi / 180) : 60;
+
+    double maxX = 0, maxY = 0;
+    bool first = true;
+    for (const auto& boundary : boundaries) {
+        if (boundary.size() < 3) continue;
+        polygons.emplace_back();
+        for (const auto& p : boundary) {
+            Vec v = Project(p);
+            polygons.back().push_back(v);
+            if (first || v.x < minX) minX = v.x;
+            if (first || v.y < minY) minY = v.y;
+            if (first || v.x > maxX) maxX = v.x;
+            if (first || v.y > maxY) maxY = v.y;
+            first = false;
+        }
+        const auto& poly = polygons.back();
+        for (size_t i = 0; i < poly.size(); ++i)
+            edges.push_back({ poly[i], poly[(i + 1) % poly.size()] });
+    }
+    for (const auto& cop : cops) copPositions.push_back(Project(cop.position));
+    edgeStamps.assign(edges.size(), 0);
+    if (edges.empty()) return;
+
+    cellWidth = std::max((maxX - minX) / kGridCells, 1e-6);
+    cellHeight = std::max((maxY - minY) / kGridCells, 1e-6);
+    cells.assign(kGridCells * kGridCells, std::vector<int>());
+    for (size_t e = 0; e < edges.size(); ++e) {
+        const Edge& edge = edges[e];
+        int x0 = CellX(std::min(edge.a.x, edge.b.x)), x1 = CellX(std::max(edge.a.x, edge.b.x));
+        int y0 = CellY(std::min(edge.a.y, edge.b.y)), y1 = CellY(std::max(edge.a.y, edge.b.y));
+        for (int y = y0; y <= y1; ++y)
+            for (int x = x0; x <= x1; ++x) cells[y * kGridCells + x].push_back((int)e);
+    }
+}
+
+LoaSectorGeometry::Vec LoaSectorGeometry::Project(const LoaGeoPoint& p) const
+{
+    return { p.lon * lonScale, p.lat * 60 };
+}
+
+LoaGeoPoint LoaSectorGeometry::Unproject(const Vec& v) const
+{
+    LoaGeoPoint p;
+    p.lat = v.y / 60;
+    p.lon = v.x / lonScale;
+    return p;
+}
+
+int LoaSectorGeometry::CellX(double x) const
+{
+    return std::min(std::max((int)((x - minX) / cellWidth), 0), kGridCells - 1);
+}
+
+int LoaSectorGeometry::CellY(double y) const
+{
+    return std::min(std::max((int)((y - minY) / cellHeight), 0), kGridCells - 1);
+}
+
+bool LoaSectorGeometry::Contains(const LoaGeoPoint& point) const
+{
+    return ContainsProjected(Project(point));
+}
+
+bool LoaSectorGeometry::ContainsProjected(const Vec& v) const
+{
+    for (const auto& poly : polygons) {
+        bool inside = false;
+        for (size_t i = 0, j = poly.size() - 1; i < poly.size(); j = i++) {
+            if ((poly[i].y > v.y) != (poly[j].y > v.y) &&
+                v.x < (poly[j].x - poly[i].x) * (v.y - poly[i].y) / (poly[j].y - poly[i].y) + poly[i].x)
+                inside = !inside;
+        }
+        if (inside) return true;
+    }
+    return false;
+}
+
+bool LoaSectorGeometry::FindExit(const std::vector<LoaGeoPoint>& polyline, LoaGeoPoint& exit) const
+{
+    if (!IsLoaded() || polyline.size() < 2) return false;
+
+    std::vector<double> crossings;
+    Vec a = Project(polyline[0]);
+    bool inside = ContainsProjected(a);
+
+    for (size_t i = 1; i < polyline.size(); ++i) {
+        Vec b = Project(polyline[i]);
+        double dx = b.x - a.x, dy = b.y - a.y;
+
+        // Edges in the grid cells the segment's bounding box covers, each tested once
+        crossings.clear();
+        if (++stamp == 0) {
+            std::fill(edgeStamps.begin(), edgeStamps.end(), 0);
+            stamp = 1;
+        }
+        int x0 = CellX(std::min(a.x, b.x)), x1 = CellX(std::max(a.x, b.x));
+        int y0 = CellY(std::min(a.y, b.y)), y1 = CellY(std::max(a.y, b.y));
+        bool offGrid = std::max(a.x, b.x) < minX || std::min(a.x, b.x) > minX + cellWidth * kGridCells ||
+            std::max(a.y, b.y) < minY || std::min(a.y, b.y) > minY + cellHeight * kGridCells;
+        for (int y = y0; y <= y1 && !offGrid; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                for (int e : cells[y * kGridCells + x]) {
+                    if (edgeStamps[e] == stamp) continue;
+                    edgeStamps[e] = stamp;
+
+                    const Edge& edge = edges[e];
+                    double ex = edge.b.x - edge.a.x, ey = edge.b.y - edge.a.y;
+                    double denom = Cross(dx, dy, ex, ey);
+                    if (denom == 0) continue;  // parallel
+                    double t = Cross(edge.a.x - a.x, edge.a.y - a.y, ex, ey) / denom;
+                    double u = Cross(edge.a.x - a.x, edge.a.y - a.y, dx, dy) / denom;
+                    if (t >= 0 && t <= 1 && u >= 0 && u <= 1) crossings.push_back(t);
+                }
+            }
+        }
+        std::sort(crossings.begin(), crossings.end());
+
+        // Bandboxed polygons may overlap: check which side each crossing leads to
+        for (double t : crossings) {
+            double after = std::min(t + 1e-6, 1.0);
+            bool nowInside = ContainsProjected({ a.x + dx * after, a.y + dy * after });
+            if (inside && !nowInside) {
+                exit = Unproject({ a.x + dx * t, a.y + dy * t });
+                return true;
+            }
+            inside = nowInside;
+        }
+        inside = ContainsProjected(b);
+        a = b;
+    }
+    return false;
+}
+
+const LoaNamedPoint* LoaSectorGeometry::NearestCop(const LoaGeoPoint& point, double maxNm) const
+{
+    // A sector publishes tens of COPs; a linear pass once per route change is enough
+    Vec v = Project(point);
+    const LoaNamedPoint* nearest = nullptr;
+    double best = maxNm * maxNm;
+    for (size_t i = 0; i < cops.size(); ++i) {
+        double dx = copPositions[i].x - v.x, dy = copPositions[i].y - v.y;
+        double d = dx * dx + dy * dy;
+        if (d <= best) {
+            best = d;
+            nearest = &cops[i];
+        }
+    }
+    return nearest;
+}
+
+int LoaSectorGeometry::NearestVertex(const std::vector<LoaGeoPoint>& polyline, const LoaGeoPoint& point) const
+{
+    Vec v = Project(point);
+    int nearest = -1;
+    double best = 0;
+    for (size_t i = 0; i < polyline.size(); ++i) {
+        Vec p = Project(polyline[i]);
+        double dx = p.x - v.x, dy = p.y - v.y;
+        double d = dx * dx + dy * dy;
+        if (nearest < 0 || d < best) {
+            best = d;
+            nearest = (int)i;
+        }
+    }
+    return nearest;
+}
+
+const LoaNamedPoint* LoaSectorGeometry::RouteExitCop(const std::vector<LoaGeoPoint>& routePoints, const LoaGeoPoint& position,
+    int nextPoint, int directTo, LoaGeoPoint& exit) const
+{
+    std::vector<LoaGeoPoint> polyline;
+    int points = (int)routePoints.size();
+    int next = std::max(directTo >= 0 ? directTo : nextPoint, 0);
+    if (directTo >= 0) polyline.push_back(position);
+    else if (next > 0) next--;
+    polyline.insert(polyline.end(), routePoints.begin() + std::min(next, points), routePoints.end());
+
+    if (!FindExit(polyline, exit)) return nullptr;
+    return NearestCop(exit, kMaxCopDistanceNm);
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+// =============================
+// Sector Geometry
+// =============================
+// Optional sector boundary and published COP positions from the sector file:
+//
+//   "boundary": [[52.10, 3.25], [52.80, 4.10], ...],   // [lat, lon], any winding
+//   "cops": { "SUPUR": [52.42, 3.51], "RESMI": [51.95, 4.62] }
+//
+// When a flight matches no rule with a COP, the COP tag shows the published COP
+// nearest to where its route leaves the sector. Positions are projected onto a
+// plane in nautical miles around the boundary's mean latitude, which is accurate
+// enough at sector scale. Boundary edges are bucketed in a uniform grid, so a
+// route segment is only tested against the edges in the cells it spans.
+
+struct LoaGeoPoint {
+    double lat = 0;
+    double lon = 0;
+};
+
+struct LoaNamedPoint {
+    std::string name;
+    LoaGeoPoint position;
+};
+
+class LoaSectorGeometry {
+public:
+    // Bandboxes pass one polygon per sector file; inside any of them counts as ours
+    void Build(const std::vector<std::vector<LoaGeoPoint>>& boundaries, const std::vector<LoaNamedPoint>& cops);
+    void Clear() { Build({}, {}); }
+    bool IsLoaded() const { return !edges.empty(); }
+    unsigned Generation() const { return generation; }
+
+    bool Contains(const LoaGeoPoint& point) const;
+
+    // First point where the polyline goes from inside the sector to outside
+    bool FindExit(const std::vector<LoaGeoPoint>& polyline, LoaGeoPoint& exit) const;
+
+    // Published COP closest to the point (nullptr if none within maxNm)
+    const LoaNamedPoint* NearestCop(const LoaGeoPoint& point, double maxNm) const;
+
+    // Index of the polyline vertex closest to the point (-1 for an empty polyline)
+    int NearestVertex(const std::vector<LoaGeoPoint>& polyline, const LoaGeoPoint& point) const;
+
+    // What the COP tag falls back to: the published COP nearest to where the rest
+    // of the extracted route leaves the sector. nextPoint and directTo are the
+    // route's calculated and assigned point indices (-1 for none); when cleared
+    // direct the rest starts at the position, else at the last point passed.
+    const LoaNamedPoint* RouteExitCop(const std::vector<LoaGeoPoint>& routePoints, const LoaGeoPoint& position,
+        int nextPoint, int directTo, LoaGeoPoint& exit) const;
+
+private:
+    struct Vec {
+        double x, y;
+    };
+    struct Edge {
+        Vec a, b;
+    };
+
+    Vec Project(const LoaGeoPoint& p) const;
+    LoaGeoPoint Unproject(const Vec& v) const;
+    bool ContainsProjected(const Vec& v) const;
+    int CellX(double x) const;
+    int CellY(double y) const;
+
+    static const int kGridCells = 32;  // per side, over the boundaries' bounding box
+    static constexpr double kMaxCopDistanceNm = 40;  // for RouteExitCop
+
+    std::vector<std::vector<Vec>> polygons;
+    std::vector<Edge> edges;
+    std::vector<LoaNamedPoint> cops;
+    std::vector<Vec> copPositions;
+
+    double lonScale = 60;  // nm per degree of longitude at the reference latitude
+    double minX = 0, minY = 0, cellWidth = 1, cellHeight = 1;
+    std::vector<std::vector<int>> cells;  // edge indices per grid cell, row-major
+
+    mutable std::vector<unsigned> edgeStamps;  // edges already tested in the current query
+    mutable unsigned stamp = 0;
+    unsigned generation = 0;
+};
+
+extern LoaSectorGeometry loaGeometry;
+
+// Per-flight exit estimate, recomputed only when the route, direct-to, the
+// route point the flight is nearest to or the geometry changes
+struct LoaExitEstimate {
+    size_t key = 0;
+    bool computed = false;
+    bool found = false;
+    LoaGeoPoint exit;
+    std::string cop;
+    std::vector<LoaGeoPoint> routePoints;  // extracted route as of the last computation
+    int nearestPoint = -1;                 // of routePoints, to the flight's position then
+};
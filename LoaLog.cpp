@@ -0,0 +1,186 @@
+﻿// =========================
+// File: LoaLog.cpp
+// =========================
+
+#include "LoaLog.h"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <fstream>
+
+LoaLogger loaLog;
+
+LoaLogger::LoaLogger()
+    : slots(new Slot[kSlotCount]), enqueuePos(0), runtimeLevel(LOA_LEVEL_INFO), running(false),
+    warnCount(0), errorCount(0), droppedCount(0)
+{
+    for (size_t i = 0; i < kSlotCount; ++i)
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+LoaLogger::~LoaLogger()
+{
+    Stop();
+    delete[] slots;
+}
+
+void LoaLogger::Start(const std::string& path, size_t maxBytes, int files)
+{
+    if (running.load()) return;
+    filePath = path;
+    maxFileBytes = maxBytes;
+    maxFiles = files < 1 ? 1 : files;
+    running.store(true);
+    drainThread = std::thread(&LoaLogger::DrainLoop, this);
+}
+
+void LoaLogger::Stop()
+{
+    if (!running.exchange(false)) return;
+    if (drainThread.joinable()) drainThread.join();
+}
+
+void LoaLogger::Write(int level, const char* format, ...)
+{
+    if (level == LOA_LEVEL_WARN) warnCount.fetch_add(1, std::memory_order_relaxed);
+    else if (level == LOA_LEVEL_ERROR) errorCount.fetch_add(1, std::memory_order_relaxed);
+
+    // Claim a slot (bounded MPMC sequence scheme; we only ever have one consumer)
+    size_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot* slot = nullptr;
+    for (;;) {
+        slot = &slots[pos & (kSlotCount - 1)];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        ptrdiff_t diff = (ptrdiff_t)seq - (ptrdiff_t)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        }
+        else if (diff < 0) {
+            droppedCount.fetch_add(1, std::memory_order_relaxed);  // ring full, never block the caller
+            return;
+        }
+        else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    slot->timestampMs = (unsigned long long)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    slot->level = level;
+
+    va_list args;
+    va_start(args, format);
+    vsnprintf(slot->text, kTextSize, format, args);
+    va_end(args);
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+}
+
+LoaLogger::Summary LoaLogger::TakeSummary()
+{
+    Summary now;
+    now.warnings = warnCount.load(std::memory_order_relaxed);
+    now.errors = errorCount.load(std::memory_order_relaxed);
+    now.dropped = droppedCount.load(std::memory_order_relaxed);
+
+    Summary delta;
+    delta.warnings = now.warnings - reported.warnings;
+    delta.errors = now.errors - reported.errors;
+    delta.dropped = now.dropped - reported.dropped;
+    reported = now;
+    return delta;
+}
+
+bool LoaLogger::TryPop(Slot*& slot, size_t& pos)
+{
+    pos = dequeuePos;
+    slot = &slots[pos & (kSlotCount - 1)];
+    size_t seq = slot->sequence.load(std::memory_order_acquire);
+    return (ptrdiff_t)seq - (ptrdiff_t)(pos + 1) >= 0;
+}
+
+// "2026-10-19 08:49:47.123" in UTC, without the CRT's non-reentrant time calls.
+// Sized for six fields of any long long value, which the compiler cannot rule out.
+static const size_t kTimestampSize = 6 * 21 + 8;
+
+static void FormatTimestamp(unsigned long long ms, char* out, size_t size)
+{
+    long long secs = (long long)(ms / 1000);
+    long long days = secs / 86400;
+    long long rem = secs % 86400;
+
+    // Days since 1970-01-01 to civil date (H. Hinnant)
+    days += 719468;
+    long long era = days / 146097;
+    long long doe = days - era * 146097;
+    long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    long long mp = (5 * doy + 2) / 153;
+    long long d = doy - (153 * mp + 2) / 5 + 1;
+    long long m = mp < 10 ? mp + 3 : mp - 9;
+    long long y = yoe + era * 400 + (m <= 2 ? 1 : 0);
+
+    snprintf(out, size, "%04lld-%02lld-%02lld %02lld:%02lld:%02lld.%03llu",
+        y, m, d, rem / 3600, (rem % 3600) / 60, rem % 60, ms % 1000);
+}
+
+void LoaLogger::DrainLoop()
+{
+    static const char* levelNames[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+    std::ofstream out;
+    size_t fileBytes = 0;
+
+    auto rotate = [&]() {
+        out.close();
+        std::remove((filePath + "." + std::to_string(maxFiles - 1)).c_str());
+        for (int i = maxFiles - 2; i >= 1; --i)
+            std::rename((filePath + "." + std::to_string(i)).c_str(), (filePath + "." + std::to_string(i + 1)).c_str());
+        if (maxFiles > 1) std::rename(filePath.c_str(), (filePath + ".1").c_str());
+        else std::remove(filePath.c_str());
+        fileBytes = 0;
+    };
+
+    for (;;) {
+        bool keepRunning = running.load();
+        bool wroteAny = false;
+
+        Slot* slot;
+        size_t pos;
+        while (TryPop(slot, pos)) {
+            if (!out.is_open()) {
+                // Opened lazily so a session that never logs leaves no file behind
+                out.clear();
+                out.open(filePath, std::ios::app);
+                out.seekp(0, std::ios::end);
+                std::streamoff end = out.tellp();
+                fileBytes = end > 0 ? (size_t)end : 0;
+            }
+            if (!out.is_open()) {
+                // Unwritable path: counted like a full ring, retried on the next record
+                droppedCount.fetch_add(1, std::memory_order_relaxed);
+                slot->sequence.store(pos + kSlotCount, std::memory_order_release);
+                dequeuePos = pos + 1;
+                continue;
+            }
+
+            char stamp[kTimestampSize];
+            FormatTimestamp(slot->timestampMs, stamp, sizeof(stamp));
+            int level = (slot->level >= 0 && slot->level <= LOA_LEVEL_ERROR) ? slot->level : LOA_LEVEL_INFO;
+
+            std::string line = std::string(stamp) + " " + levelNames[level] + " " + slot->text + "\n";
+            out << line;
+            fileBytes += line.size();
+            wroteAny = true;
+
+            slot->sequence.store(pos + kSlotCount, std::memory_order_release);
+            dequeuePos = pos + 1;
+
+            if (fileBytes >= maxFileBytes) rotate();
+        }
+
+        if (wroteAny && out.is_open()) out.flush();
+        if (!keepRunning) break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+}
@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <thread>
+
+// =============================
+// Log Levels
+// =============================
+enum LoaLogLevel {
+    LOA_LEVEL_DEBUG = 0,
+    LOA_LEVEL_INFO = 1,
+    LOA_LEVEL_WARN = 2,
+    LOA_LEVEL_ERROR = 3
+};
+
+// Anything below this level is compiled out entirely (define it in the project
+// settings, e.g. LOA_LOG_MIN_LEVEL=2 to keep only warnings and errors).
+#ifndef LOA_LOG_MIN_LEVEL
+#define LOA_LOG_MIN_LEVEL LOA_LEVEL_DEBUG
+#endif
+
+#define LOA_LOG(level, ...) \
+    do { if ((level) >= LOA_LOG_MIN_LEVEL && loaLog.IsEnabled(level)) loaLog.Write((level), __VA_ARGS__); } while (0)
+
+#define LOA_LOG_DEBUG(...) LOA_LOG(LOA_LEVEL_DEBUG, __VA_ARGS__)
+#define LOA_LOG_INFO(...)  LOA_LOG(LOA_LEVEL_INFO, __VA_ARGS__)
+#define LOA_LOG_WARN(...)  LOA_LOG(LOA_LEVEL_WARN, __VA_ARGS__)
+#define LOA_LOG_ERROR(...) LOA_LOG(LOA_LEVEL_ERROR, __VA_ARGS__)
+
+// Records the user asked for explicitly (".loa diag"): written at INFO whatever
+// the runtime level, so ".loa log warn" does not silence them
+#define LOA_LOG_DIAG(...) \
+    do { if (LOA_LEVEL_INFO >= LOA_LOG_MIN_LEVEL) loaLog.Write(LOA_LEVEL_INFO, __VA_ARGS__); } while (0)
+
+// =============================
+// LoaLogger
+// =============================
+// Lock-free bounded ring (multi-producer, single consumer). Write() formats into
+// a fixed slot and never blocks: when the ring is full the record is dropped and
+// counted. A background thread drains the ring to a rotating log file; only the
+// per-interval summary from TakeSummary() is meant for the chat window.
+class LoaLogger {
+public:
+    struct Summary {
+        unsigned long long warnings = 0;
+        unsigned long long errors = 0;
+        unsigned long long dropped = 0;
+    };
+
+    LoaLogger();
+    ~LoaLogger();
+
+    void Start(const std::string& filePath, size_t maxFileBytes = 1024 * 1024, int maxFiles = 3);
+    void Stop();
+
+    bool IsEnabled(int level) const { return level >= runtimeLevel.load(std::memory_order_relaxed); }
+    void SetLevel(int level) { runtimeLevel.store(level, std::memory_order_relaxed); }
+    int GetLevel() const { return runtimeLevel.load(std::memory_order_relaxed); }
+
+    void Write(int level, const char* format, ...);
+
+    // Counts since the previous call
+    Summary TakeSummary();
+    const std::string& GetFilePath() const { return filePath; }
+
+private:
+    static const size_t kSlotCount = 2048;  // power of two
+    static const size_t kTextSize = 200;
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        unsigned long long timestampMs;
+        int level;
+        char text[kTextSize];
+    };
+
+    bool TryPop(Slot*& slot, size_t& pos);
+    void DrainLoop();
+
+    Slot* slots;
+    std::atomic<size_t> enqueuePos;
+    size_t dequeuePos = 0;
+
+    std::atomic<int> runtimeLevel;
+    std::atomic<bool> running;
+    std::thread drainThread;
+
+    std::string filePath;
+    size_t maxFileBytes = 0;
+    int maxFiles = 0;
+
+    std::atomic<unsigned long long> warnCount;
+    std::atomic<unsigned long long> errorCount;
+    std::atomic<unsigned long long> droppedCount;
+    Summary reported;
+};
+
+extern LoaLogger loaLog;
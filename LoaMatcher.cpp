@@ -1,20 +1,66 @@
 ﻿#include "stdafx.h"
 #include "LOAPlugin.h"
+#include "LoaLog.h"
+#include "LoaCompiled.h"
+#include "LoaShadow.h"
+#include "LoaPredicate.h"
 #include <algorithm>
 #include <cctype>
 #include <unordered_map>
 #include <unordered_set>
 #include <chrono>
 
-// Case-insensitive compare
-bool EqualsIgnoreCase(const std::string& a, const std::string& b) {
-    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
-        [](char a, char b) { return tolower(a) == tolower(b); });
+const LOAEntry* ResolveLoaMatch(const LoaMatchRef& ref)
+{
+    const std::vector<LOAEntry>* lists[] = { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas };
+    if (ref.list < 0 || ref.list > LOA_LIST_FALLBACK) return nullptr;
+    const auto& list = *lists[ref.list];
+    return (ref.index >= 0 && ref.index < (int)list.size()) ? &list[ref.index] : nullptr;
+}
+
+bool LoaRuleActive(int list, int index)
+{
+    const LOAEntry* entry = ResolveLoaMatch({ list, index });
+    return entry && entry->active;
+}
+
+LoaMatchRef LocateLoaEntry(const LOAEntry* entry)
+{
+    const std::vector<LOAEntry>* lists[] = { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas };
+    for (int l = LOA_LIST_DESTINATION; entry && l <= LOA_LIST_FALLBACK; ++l) {
+        const auto& list = *lists[l];
+        if (!list.empty() && entry >= list.data() && entry < list.data() + list.size())
+            return { l, (int)(entry - list.data()) };
+    }
+    return { LOA_LIST_NONE, -1 };
+}
+
+namespace {
+
+struct CompiledRouteContext {
+    LoaRouteWaypoints* route;
+    const EuroScopePlugIn::CFlightPlan* fp;
+};
+
+const std::vector<std::string>& CompiledRoutePoints(void* context)
+{
+    CompiledRouteContext* c = static_cast<CompiledRouteContext*>(context);
+    return c->route->Names(*c->fp);
 }
 
-const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers)
+} // namespace
+
+const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+    LoaRouteWaypoints* route)
 {
-    if (!fp.IsValid() || !plugin.IsLOARelevantState(fp.GetState())) return nullptr;
+    if (!fp.IsValid() || !plugin->IsLOARelevantState(fp.GetState())) return nullptr;
+    return MatchLoaEntryAnyState(fp, onlineControllers, route);
+}
+
+const LOAEntry* MatchLoaEntryAnyState(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+    LoaRouteWaypoints* route)
+{
+    if (!fp.IsValid()) return nullptr;
 
     const char* planType = fp.GetFlightPlanData().GetPlanType();
     if (_stricmp(planType, "I") != 0) return nullptr;
@@ -23,46 +69,98 @@ const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std:
     DWORD now = GetTickCount64();
 
     // Check if result is cached and still valid (5 seconds)
-    auto tsIt = plugin.matchTimestamps.find(callsign);
-    if (tsIt != plugin.matchTimestamps.end() && now - tsIt->second < 5000) {
-        auto matchIt = plugin.matchedLOACache.find(callsign);
-        if (matchIt != plugin.matchedLOACache.end()) {
+    auto tsIt = plugin->matchTimestamps.find(callsign);
+    if (tsIt != plugin->matchTimestamps.end() && now - tsIt->second < 5000) {
+        auto matchIt = plugin->matchedLOACache.find(callsign);
+        if (matchIt != plugin->matchedLOACache.end()) {
+            // Only the fallback stage reads the cleared altitude; follow it through the table
+            auto profile = plugin->altitudeProfiles.find(callsign);
+            if (profile != plugin->altitudeProfiles.end() && profile->second.match.IsBuilt())
+                matchIt->second = profile->second.match.Lookup(fp.GetClearedAltitude());
             return matchIt->second;
         }
     }
 
+    auto evaluationStart = std::chrono::steady_clock::now();
     std::string origin = fp.GetFlightPlanData().GetOrigin();
     std::string destination = fp.GetFlightPlanData().GetDestination();
     std::string controller = fp.GetTrackingControllerId();
 
-    const auto& routePoints = plugin.GetCachedRoutePoints(fp);
+    // Sectors whose online state could change this result (see sectorDependents)
+    std::vector<std::string> dependsOn;
+
+    auto store = [&](const LOAEntry* result) -> const LOAEntry* {
+        plugin->matchedLOACache[callsign] = result;
+        plugin->matchTimestamps[callsign] = now;
+        plugin->SetFlightSectorDependencies(callsign, dependsOn);
+        if (plugin->IsDiagnosticFlight(callsign)) {
+            LOA_LOG_DIAG("MATCH %s %s->%s CFL %d: %s xfl=%d cop=%s online-deps=%zu",
+                callsign.c_str(), origin.c_str(), destination.c_str(), fp.GetClearedAltitude(),
+                result ? "hit" : "none", result ? result->xfl : 0, result ? result->copText.c_str() : "-", dependsOn.size());
+        }
+        if (loaShadow.IsRunning() && loaShadow.ShouldSample()) {
+            loaShadow.Submit(fp, onlineControllers, result,
+                std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - evaluationStart).count(), route);
+        }
+        return result;
+        };
+
+    LoaAltitudeTable<const LOAEntry*>& altitudeTable = plugin->altitudeProfiles[callsign].match;
+
+    // Another flight with the same city pair, route and tracking sector may
+    // already have been matched against this online set. Without route text
+    // there is nothing to fingerprint the extracted route by; an assigned SID or
+    // STAR changes the extracted route, so both are part of the fingerprint.
+    const char* routeText = fp.GetFlightPlanData().GetRoute();
+    bool memoize = !activeCompiledRuleset && *routeText;
+    LoaMemoKey memoKey;
+    if (memoize) {
+        memoKey.origin = origin;
+        memoKey.destination = destination;
+        memoKey.controller = controller;
+        const auto& fpd = fp.GetFlightPlanData();
+        memoKey.routeFingerprint = std::hash<std::string>()(std::string(routeText) + '\n' + fpd.GetSidName() + '\n' + fpd.GetStarName());
+        memoKey.pluginOnlineSet = plugin->IsCachedOnlineSet(onlineControllers);
+        memoKey.onlineGeneration = memoKey.pluginOnlineSet ? plugin->onlineSectorGeneration : HashSetOfStrings(onlineControllers);
+        memoKey.flightFingerprint = loaPredicates.FlightFingerprint(fp);
+
+        if (const LoaMemoResult* memo = plugin->matchMemo.Find(memoKey)) {
+            altitudeTable = memo->match;
+            dependsOn = memo->dependsOn;
+            return store(altitudeTable.Lookup(fp.GetClearedAltitude()));
+        }
+    }
+
+    // LOA waypoints from the route text; GetExtractedRoute only if the text is not decisive
+    LoaRouteWaypoints localRoute;
+    if (!route) {
+        localRoute.Reset(fp);
+        route = &localRoute;
+    }
+
+    if (activeCompiledRuleset) {
+        altitudeTable.Reset();  // generated code folds the altitude in; re-match on level changes
+        CompiledRouteContext routeContext = { route, &fp };
+        LoaCompiledInput in = { &origin, &destination, &controller, &CompiledRoutePoints, &routeContext, &onlineControllers,
+            fp.GetClearedAltitude(), &dependsOn };
+        return store(ResolveLoaMatch(activeCompiledRuleset->match(in)));
+    }
+
+    // Each rule is a short predicate program (see LoaPredicate.h); conditions
+    // many rules share are evaluated once per flight. The online check comes
+    // last: a rule that fails only there is a candidate that a controller
+    // logging on would turn into the match.
+    LoaPredicateRun run;
+    run.fp = &fp;
+    run.route = route;
+    run.onlineControllers = &onlineControllers;
+    run.dependsOn = &dependsOn;
+    run.matcher = true;
+    loaPredicates.Begin(run, origin, destination, controller);
 
     auto matchIn = [&](const std::vector<LOAEntry>& entries) -> const LOAEntry* {
-        for (const auto& entry : entries) {
-            if (!entry.originAirports.empty() &&
-                !plugin.MatchesAirport(entry.originAirportSet, entry.originAirportPrefixes, origin)) continue;
-
-            if (!entry.destinationAirports.empty() &&
-                !plugin.MatchesAirport(entry.destinationAirportSet, entry.destinationAirportPrefixes, destination)) continue;
-
-            if (entry.requireNextSectorOnline && !entry.nextSectors.empty()) {
-                bool online = std::any_of(entry.nextSectors.begin(), entry.nextSectors.end(),
-                    [&](const std::string& ns) { return onlineControllers.count(ns) > 0; });
-                if (!online) continue;
-            }
-
-            bool wpMatch = std::all_of(entry.waypoints.begin(), entry.waypoints.end(),
-                [&](const std::string& wp) {
-                    return std::any_of(routePoints.begin(), routePoints.end(),
-                        [&](const std::string& r) { return EqualsIgnoreCase(r, wp); });
-                });
-
-            bool nextSectorMatch = entry.nextSectors.empty() || std::any_of(entry.nextSectors.begin(), entry.nextSectors.end(),
-                [&](const std::string& ns) { return EqualsIgnoreCase(ns, controller); });
-
-            if (wpMatch && nextSectorMatch)
-                return &entry;
-        }
+        for (const auto& entry : entries)
+            if (entry.active && loaPredicates.Run(entry, run)) return &entry;
         return nullptr;
         };
 
@@ -72,33 +170,29 @@ const LOAEntry* MatchLoaEntry(const EuroScopePlugIn::CFlightPlan& fp, const std:
         (result = matchIn(departureLoas)) ||
         (result = matchIn(lorArrivals)) ||
         (result = matchIn(lorDepartures))) {
-        plugin.matchedLOACache[callsign] = result;
-        plugin.matchTimestamps[callsign] = now;
-        return result;
+        altitudeTable.Build({}, [&](int) { return result; });
+        if (memoize) plugin->matchMemo.Insert(memoKey, { altitudeTable, dependsOn });
+        return store(result);
     }
 
-    int clearedAltitude = fp.GetClearedAltitude();
+    // Altitude stage: tabulate the fallback candidates against their minimum
+    // altitudes so a level change is a lookup instead of a re-match
+    std::vector<const LOAEntry*> fallbacks;
+    std::vector<int> breakpoints;
     for (const auto& entry : fallbackLoas) {
-        if (clearedAltitude < entry.minAltitudeFt) continue;
-
-        if (!entry.destinationAirports.empty() &&
-            !plugin.MatchesAirport(entry.destinationAirportSet, entry.destinationAirportPrefixes, destination)) continue;
-
-        bool wpMatch = std::all_of(entry.waypoints.begin(), entry.waypoints.end(),
-            [&](const std::string& wp) {
-                return std::any_of(routePoints.begin(), routePoints.end(),
-                    [&](const std::string& r) { return EqualsIgnoreCase(r, wp); });
-            });
-
-        if (wpMatch) {
-            plugin.matchedLOACache[callsign] = &entry;
-            plugin.matchTimestamps[callsign] = now;
-            return &entry;
+        if (entry.active && loaPredicates.Run(entry, run)) {
+            fallbacks.push_back(&entry);
+            breakpoints.push_back(entry.minAltitudeFt);
         }
     }
 
-    // No match found — cache null to avoid re-evaluation within 5s
-    plugin.matchedLOACache[callsign] = nullptr;
-    plugin.matchTimestamps[callsign] = now;
-    return nullptr;
+    altitudeTable.Build(breakpoints, [&](int altitude) -> const LOAEntry* {
+        for (const LOAEntry* entry : fallbacks)
+            if (altitude >= entry->minAltitudeFt) return entry;
+        return nullptr;
+        });
+    if (memoize) plugin->matchMemo.Insert(memoKey, { altitudeTable, dependsOn });
+
+    // A null result is cached too, to avoid re-evaluation within 5s
+    return store(altitudeTable.Lookup(fp.GetClearedAltitude()));
 }
\ No newline at end of file
@@ -0,0 +1,73 @@
+﻿// =========================
+// File: LoaMemo.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaMemo.h"
+
+size_t LoaMemoKeyHash::operator()(const LoaMemoKey& key) const
+{
+    std::hash<std::string> hashString;
+    size_t seed = key.routeFingerprint;
+    for (size_t v : { hashString(key.origin), hashString(key.destination), hashString(key.controller),
+        (size_t)key.onlineGeneration, (size_t)key.pluginOnlineSet, key.flightFingerprint }) {
+        seed ^= v + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+    }
+    return seed;
+}
+
+const LoaMemoResult* LoaMatchMemo::Find(const LoaMemoKey& key)
+{
+    if (capacity == 0) return nullptr;
+
+    auto it = index.find(key);
+    if (it == index.end()) {
+        stats.misses++;
+        return nullptr;
+    }
+    stats.hits++;
+    entries.splice(entries.begin(), entries, it->second);
+    return &it->second->second;
+}
+
+void LoaMatchMemo::Insert(const LoaMemoKey& key, const LoaMemoResult& result)
+{
+    if (capacity == 0) return;
+
+    auto it = index.find(key);
+    if (it != index.end()) {
+        it->second->second = result;
+        entries.splice(entries.begin(), entries, it->second);
+        return;
+    }
+
+    while (index.size() >= capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+        stats.evictions++;
+    }
+    entries.emplace_front(key, result);
+    index[key] = entries.begin();
+}
+
+void LoaMatchMemo::Clear()
+{
+    entries.clear();
+    index.clear();
+}
+
+void LoaMatchMemo::SetCapacity(size_t maxEntries)
+{
+    capacity = maxEntries;
+    while (index.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+        stats.evictions++;
+    }
+}
+
+double LoaMatchMemo::HitRate() const
+{
+    unsigned long long lookups = stats.hits + stats.misses;
+    return lookups ? (double)stats.hits / lookups : 0.0;
+}
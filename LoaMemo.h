@@ -0,0 +1,70 @@
+﻿#pragma once
+
+#include "LoaAltitudeProfile.h"
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LOAEntry;
+
+// =============================
+// Cross-flight Match Memo
+// =============================
+// Flights that file the same city pair and route under the same tracking
+// sector get the same altitude-independent match, so the first one's result is
+// shared: its fallback altitude table and the sectors it depends on. Bounded,
+// least recently used entry evicted first; cleared whenever the rules change.
+
+struct LoaMemoKey {
+    std::string origin;
+    std::string destination;
+    std::string controller;              // tracking sector, tested against nextSectors
+    size_t routeFingerprint = 0;         // hash of the filed route text, SID and STAR
+    unsigned long long onlineGeneration = 0;
+    bool pluginOnlineSet = true;         // false: onlineGeneration is a hash of a caller's set
+    size_t flightFingerprint = 0;        // flight-condition fields the rules read (LoaPredicateVM)
+
+    bool operator==(const LoaMemoKey& other) const {
+        return routeFingerprint == other.routeFingerprint && onlineGeneration == other.onlineGeneration &&
+            pluginOnlineSet == other.pluginOnlineSet && flightFingerprint == other.flightFingerprint && origin == other.origin &&
+            destination == other.destination && controller == other.controller;
+    }
+};
+
+struct LoaMemoKeyHash {
+    size_t operator()(const LoaMemoKey& key) const;
+};
+
+struct LoaMemoResult {
+    LoaAltitudeTable<const LOAEntry*> match;
+    std::vector<std::string> dependsOn;
+};
+
+struct LoaMemoStats {
+    unsigned long long hits = 0;
+    unsigned long long misses = 0;
+    unsigned long long evictions = 0;
+};
+
+class LoaMatchMemo {
+public:
+    // nullptr on a miss; a hit becomes the most recently used entry
+    const LoaMemoResult* Find(const LoaMemoKey& key);
+    void Insert(const LoaMemoKey& key, const LoaMemoResult& result);
+    void Clear();
+
+    void SetCapacity(size_t maxEntries);   // ".loa memo", 0 = off
+    size_t GetCapacity() const { return capacity; }
+    size_t Size() const { return index.size(); }
+    double HitRate() const;
+
+    LoaMemoStats stats;
+
+private:
+    typedef std::list<std::pair<LoaMemoKey, LoaMemoResult>> Entries;
+
+    size_t capacity = 4096;
+    Entries entries;  // most recently used first
+    std::unordered_map<LoaMemoKey, Entries::iterator, LoaMemoKeyHash> index;
+};
@@ -0,0 +1,246 @@
+﻿// =========================
+// File: LoaPredicate.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaPredicate.h"
+#include "LOAPlugin.h"
+#include <algorithm>
+#include <cctype>
+#include <functional>
+
+LoaPredicateVM loaPredicates;
+
+namespace {
+
+// Leading characters of a and b equal, ignoring case
+bool PrefixEqualsIgnoreCase(const std::string& a, const std::string& b, size_t length)
+{
+    if (a.size() < length || b.size() < length) return false;
+    for (size_t i = 0; i < length; ++i)
+        if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    return true;
+}
+
+std::string JoinKey(const std::vector<std::string>& values)
+{
+    std::string key;
+    for (const auto& v : values) key += v + ",";
+    return key;
+}
+
+} // namespace
+
+void LoaPredicateVM::CompileEntry(const LOAEntry& entry, bool fallback, std::vector<LoaInstruction>& out,
+    std::vector<LoaOperand>& pool, bool shareSlots)
+{
+    auto emit = [&](uint8_t op, uint8_t field, uint8_t flags, const std::string& key, LoaOperand operand) {
+        if (field < LOA_FIELD_COUNT) usedFields |= 1u << field;
+        if (shareSlots && !key.empty()) {
+            std::string fullKey = std::to_string(op) + ":" + std::to_string(field) + ":" + std::to_string(flags) + ":" + key;
+            auto it = interned.find(fullKey);
+            if (it != interned.end()) {
+                out.push_back(it->second);
+                return;
+            }
+            LoaInstruction insn = { op, field, flags, (uint32_t)pool.size(), (uint32_t)slotCount++ };
+            pool.push_back(std::move(operand));
+            interned.emplace(fullKey, insn);
+            out.push_back(insn);
+            return;
+        }
+        out.push_back({ op, field, flags, (uint32_t)pool.size(), kNoSlot });
+        pool.push_back(std::move(operand));
+    };
+    auto list = [](const std::vector<std::string>& values) {
+        LoaOperand operand;
+        operand.values = values;
+        return operand;
+    };
+
+    // Same order as the hand-written matchers had: airports, sector, the flight
+    // conditions, then the route (may need the extracted route) and the online
+    // check (records what the result depends on) last
+    if (!fallback && !entry.originAirports.empty()) {
+        LoaOperand operand;
+        operand.exact = entry.originAirportSet;
+        operand.values = entry.originAirportPrefixes;
+        emit(LOA_OP_AIRPORT, LOA_FIELD_ORIGIN, 0, JoinKey(entry.originAirports), std::move(operand));
+    }
+    if (!entry.destinationAirports.empty()) {
+        LoaOperand operand;
+        operand.exact = entry.destinationAirportSet;
+        operand.values = entry.destinationAirportPrefixes;
+        emit(LOA_OP_AIRPORT, LOA_FIELD_DESTINATION, 0, JoinKey(entry.destinationAirports), std::move(operand));
+    }
+    if (!fallback && !entry.nextSectors.empty())
+        emit(LOA_OP_ONE_OF, LOA_FIELD_CONTROLLER, LOA_INSN_MATCHER_ONLY, JoinKey(entry.nextSectors), list(entry.nextSectors));
+
+    if (!entry.aircraftTypes.empty())
+        emit(LOA_OP_TYPE, LOA_FIELD_AIRCRAFT_TYPE, 0, JoinKey(entry.aircraftTypes), list(entry.aircraftTypes));
+    if (!entry.wakeCategories.empty())
+        emit(LOA_OP_ONE_OF, LOA_FIELD_WAKE, 0, JoinKey(entry.wakeCategories), list(entry.wakeCategories));
+    if (!entry.sids.empty())
+        emit(LOA_OP_ONE_OF, LOA_FIELD_SID, 0, JoinKey(entry.sids), list(entry.sids));
+    if (!entry.stars.empty())
+        emit(LOA_OP_ONE_OF, LOA_FIELD_STAR, 0, JoinKey(entry.stars), list(entry.stars));
+    if (entry.rflMinFt >= 0) {
+        LoaOperand operand;
+        operand.low = entry.rflMinFt;
+        operand.high = entry.rflMaxFt;
+        emit(LOA_OP_RANGE, LOA_FIELD_RFL, 0, std::to_string(operand.low) + "-" + std::to_string(operand.high), std::move(operand));
+    }
+    if (entry.squawkMin >= 0) {
+        LoaOperand operand;
+        operand.low = entry.squawkMin;
+        operand.high = entry.squawkMax;
+        emit(LOA_OP_RANGE, LOA_FIELD_SQUAWK, 0, std::to_string(operand.low) + "-" + std::to_string(operand.high), std::move(operand));
+    }
+
+    if (!entry.waypoints.empty())
+        emit(LOA_OP_ROUTE, LOA_FIELD_COUNT, 0, std::to_string(entry.waypointsOrdered) + JoinKey(entry.waypoints), LoaOperand());
+    if (!fallback && entry.requireNextSectorOnline)
+        emit(LOA_OP_NEXT_ONLINE, LOA_FIELD_COUNT, 0, std::string(), LoaOperand());
+}
+
+void LoaPredicateVM::Compile()
+{
+    code.clear();
+    operands.clear();
+    interned.clear();
+    slotCount = 0;
+    usedFields = 0;
+    generation++;
+
+    for (auto* list : { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas }) {
+        bool fallback = list == &fallbackLoas;
+        for (auto& entry : *list) {
+            size_t start = code.size();
+            CompileEntry(entry, fallback, code, operands, true);
+            entry.programStart = (uint32_t)start;
+            entry.programLength = (uint16_t)(code.size() - start);
+            entry.programGeneration = generation;
+        }
+    }
+    interned.clear();
+    slotEpoch.assign(slotCount, 0);
+    slotValue.assign(slotCount, 0);
+    epoch = 0;
+}
+
+size_t LoaPredicateVM::FlightFingerprint(const EuroScopePlugIn::CFlightPlan& fp) const
+{
+    if (!UsesFlightConditions()) return 0;
+
+    LoaPredicateRun run;
+    run.fp = &fp;
+    size_t hash = 0;
+    for (int field = LOA_FIELD_AIRCRAFT_TYPE; field < LOA_FIELD_COUNT; ++field) {
+        if (!(usedFields & (1u << field))) continue;
+        Load(field, run);
+        size_t v = std::hash<std::string>()(run.text[field]) ^ (size_t)run.number[field];
+        hash ^= v + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+    }
+    return hash ? hash : 1;
+}
+
+void LoaPredicateVM::Begin(LoaPredicateRun& run, const std::string& origin, const std::string& destination,
+    const std::string& controller)
+{
+    run.text[LOA_FIELD_ORIGIN] = origin;
+    run.text[LOA_FIELD_DESTINATION] = destination;
+    run.text[LOA_FIELD_CONTROLLER] = controller;
+    run.loaded = (1u << LOA_FIELD_ORIGIN) | (1u << LOA_FIELD_DESTINATION) | (1u << LOA_FIELD_CONTROLLER);
+
+    if (++epoch == 0) {
+        std::fill(slotEpoch.begin(), slotEpoch.end(), 0);
+        epoch = 1;
+    }
+}
+
+void LoaPredicateVM::Load(int field, LoaPredicateRun& run)
+{
+    const auto& fpd = run.fp->GetFlightPlanData();
+    switch (field) {
+    case LOA_FIELD_AIRCRAFT_TYPE: run.text[field] = fpd.GetAircraftFPType(); break;
+    case LOA_FIELD_WAKE: run.text[field] = std::string(1, fpd.GetAircraftWtc()); break;
+    case LOA_FIELD_SID: run.text[field] = fpd.GetSidName(); break;
+    case LOA_FIELD_STAR: run.text[field] = fpd.GetStarName(); break;
+    case LOA_FIELD_RFL: run.number[field] = run.fp->GetFinalAltitude(); break;
+    case LOA_FIELD_SQUAWK: run.number[field] = ParseLoaSquawk(run.fp->GetControllerAssignedData().GetSquawk()); break;
+    default: break;
+    }
+    run.loaded |= 1u << field;
+}
+
+bool LoaPredicateVM::Evaluate(const LoaInstruction& insn, const LoaOperand& operand, const LOAEntry& entry, LoaPredicateRun& run)
+{
+    if (insn.field < LOA_FIELD_COUNT && !(run.loaded & (1u << insn.field))) Load(insn.field, run);
+
+    switch (insn.op) {
+    case LOA_OP_AIRPORT: {
+        const std::string& airport = run.text[insn.field];
+        if (operand.exact.count(airport)) return true;
+        return std::any_of(operand.values.begin(), operand.values.end(),
+            [&](const std::string& prefix) { return airport.compare(0, prefix.length(), prefix) == 0; });
+    }
+    case LOA_OP_ONE_OF:
+        return std::any_of(operand.values.begin(), operand.values.end(),
+            [&](const std::string& v) { return EqualsIgnoreCase(v, run.text[insn.field]); });
+    case LOA_OP_TYPE: {
+        const std::string& type = run.text[insn.field];
+        return std::any_of(operand.values.begin(), operand.values.end(), [&](const std::string& v) {
+            if (v.empty() || v.back() != '*') return EqualsIgnoreCase(v, type);
+            return PrefixEqualsIgnoreCase(v, type, v.size() - 1);
+        });
+    }
+    case LOA_OP_RANGE:
+        return run.number[insn.field] >= operand.low && run.number[insn.field] <= operand.high;
+    case LOA_OP_ROUTE:
+        return run.route->Matches(entry, *run.fp);
+    case LOA_OP_NEXT_ONLINE:
+        // The matcher only applies the check to rules naming next sectors; the
+        // tag tables have always rejected a rule requiring an online next
+        // sector without naming one
+        if (entry.nextSectors.empty()) return run.matcher;
+        if (run.dependsOn) run.dependsOn->insert(run.dependsOn->end(), entry.nextSectors.begin(), entry.nextSectors.end());
+        return FirstOnlineNextSector(entry, *run.onlineControllers) != nullptr;
+    default:
+        return false;
+    }
+}
+
+bool LoaPredicateVM::Execute(const LoaInstruction* begin, const LoaInstruction* end, const std::vector<LoaOperand>& pool,
+    const LOAEntry& entry, LoaPredicateRun& run)
+{
+    for (const LoaInstruction* insn = begin; insn != end; ++insn) {
+        if ((insn->flags & LOA_INSN_MATCHER_ONLY) && !run.matcher) continue;
+
+        bool result;
+        if (insn->slot != kNoSlot && slotEpoch[insn->slot] == epoch) {
+            result = slotValue[insn->slot] != 0;
+        }
+        else {
+            result = Evaluate(*insn, pool[insn->operand], entry, run);
+            if (insn->slot != kNoSlot) {
+                slotEpoch[insn->slot] = epoch;
+                slotValue[insn->slot] = result;
+            }
+        }
+        if (!result) return false;
+    }
+    return true;
+}
+
+bool LoaPredicateVM::Run(const LOAEntry& entry, LoaPredicateRun& run)
+{
+    if (entry.programGeneration == generation)
+        return Execute(code.data() + entry.programStart, code.data() + entry.programStart + entry.programLength, operands, entry, run);
+
+    // Added or copied after the last Compile: compile just this rule, unshared
+    std::vector<LoaInstruction> local;
+    std::vector<LoaOperand> pool;
+    bool fallback = !fallbackLoas.empty() && &entry >= fallbackLoas.data() && &entry < fallbackLoas.data() + fallbackLoas.size();
+    CompileEntry(entry, fallback, local, pool, false);
+    return Execute(local.data(), local.data() + local.size(), pool, entry, run);
+}
@@ -0,0 +1,138 @@
+﻿#pragma once
+
+#include "EuroScopePlugIn.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct LOAEntry;
+class LoaRouteWaypoints;
+
+// =============================
+// Rule Predicate Programs
+// =============================
+// Every rule's conditions are compiled at load into a short program of
+// predicate instructions. Each instruction names the flight field it tests
+// (a register) and an operand in a shared pool. A match loads the registers
+// once, then runs the programs in list order and stops a program at its first
+// false predicate. Identical predicates in different rules share a slot, so a
+// destination list or waypoint set that appears in fifty rules is evaluated
+// once per flight. A field no rule tests is never read from the flight plan.
+//
+// Flight conditions beyond airports, route and sectors (all optional):
+//   "aircraftTypes": ["A320", "B73*"]     ICAO type, "*" suffix = prefix
+//   "wakeCategories": ["H", "J"]
+//   "sids": ["RESMI1A"], "stars": ["ARTIP2B"]
+//   "rflRangeFt": [24500, 66000]          requested (final) level, inclusive
+//   "squawkRange": ["1000", "1077"]       octal, inclusive
+
+enum LoaField : uint8_t {
+    LOA_FIELD_ORIGIN = 0,
+    LOA_FIELD_DESTINATION,
+    LOA_FIELD_CONTROLLER,      // tracking controller, tested against nextSectors
+    LOA_FIELD_AIRCRAFT_TYPE,
+    LOA_FIELD_WAKE,
+    LOA_FIELD_SID,
+    LOA_FIELD_STAR,
+    LOA_FIELD_RFL,
+    LOA_FIELD_SQUAWK,
+    LOA_FIELD_COUNT
+};
+
+// Fields only the flight conditions read: results depending on them cannot be
+// shared by city pair and route alone
+const unsigned LOA_FLIGHT_CONDITION_FIELDS =
+    (1u << LOA_FIELD_AIRCRAFT_TYPE) | (1u << LOA_FIELD_WAKE) | (1u << LOA_FIELD_SID) |
+    (1u << LOA_FIELD_STAR) | (1u << LOA_FIELD_RFL) | (1u << LOA_FIELD_SQUAWK);
+
+enum LoaOp : uint8_t {
+    LOA_OP_AIRPORT,      // text register in an airport list (4 letters exact, shorter = prefix)
+    LOA_OP_ONE_OF,       // text register equals one of the operand's values, ignoring case
+    LOA_OP_TYPE,         // like ONE_OF, values ending in '*' match by prefix
+    LOA_OP_RANGE,        // number register within [low, high]
+    LOA_OP_ROUTE,        // route passes the rule's waypoints
+    LOA_OP_NEXT_ONLINE   // one of the rule's next sectors is online
+};
+
+enum LoaInstructionFlags : uint8_t {
+    LOA_INSN_MATCHER_ONLY = 1   // skipped by the tag tables (next sector is the tracking controller)
+};
+
+struct LoaInstruction {
+    uint8_t op;
+    uint8_t field;
+    uint8_t flags;
+    uint32_t operand;
+    uint32_t slot;       // shared result slot, kNoSlot for predicates with side effects
+};
+
+struct LoaOperand {
+    std::unordered_set<std::string> exact;
+    std::vector<std::string> values;   // prefixes for AIRPORT, candidates for ONE_OF/TYPE
+    int low = 0;
+    int high = 0;
+};
+
+// One evaluation of one flight: the registers and everything the route and
+// online predicates need
+struct LoaPredicateRun {
+    const EuroScopePlugIn::CFlightPlan* fp = nullptr;
+    LoaRouteWaypoints* route = nullptr;
+    const std::unordered_set<std::string>* onlineControllers = nullptr;
+    std::vector<std::string>* dependsOn = nullptr;  // next sectors of online checks reached
+    bool matcher = true;                            // false: the tag tables' conditions
+
+    std::string text[LOA_FIELD_COUNT];
+    int number[LOA_FIELD_COUNT] = {};
+    unsigned loaded = 0;  // registers filled so far; flight-condition fields load on first use
+};
+
+class LoaPredicateVM {
+public:
+    static const uint32_t kNoSlot = 0xFFFFFFFF;
+
+    // Compiles every rule in the global lists (after IndexLoaWaypoints)
+    void Compile();
+
+    unsigned UsedFields() const { return usedFields; }
+    bool UsesFlightConditions() const { return (usedFields & LOA_FLIGHT_CONDITION_FIELDS) != 0; }
+
+    // Hash of the flight-condition fields the rules read (0 when none do)
+    size_t FlightFingerprint(const EuroScopePlugIn::CFlightPlan& fp) const;
+
+    // Phase one: loads the airport and controller registers (run.fp must be set)
+    // and forgets shared results. One run at a time; the matcher and the tag
+    // tables never nest.
+    void Begin(LoaPredicateRun& run, const std::string& origin, const std::string& destination,
+        const std::string& controller);
+
+    // The rule's program against the current run (activation is checked by the caller)
+    bool Run(const LOAEntry& entry, LoaPredicateRun& run);
+
+    size_t CodeSize() const { return code.size(); }
+    size_t SlotCount() const { return slotCount; }
+
+private:
+    void CompileEntry(const LOAEntry& entry, bool fallback, std::vector<LoaInstruction>& out,
+        std::vector<LoaOperand>& pool, bool shareSlots);
+    bool Execute(const LoaInstruction* begin, const LoaInstruction* end, const std::vector<LoaOperand>& pool,
+        const LOAEntry& entry, LoaPredicateRun& run);
+    bool Evaluate(const LoaInstruction& insn, const LoaOperand& operand, const LOAEntry& entry, LoaPredicateRun& run);
+    static void Load(int field, LoaPredicateRun& run);
+
+    std::vector<LoaInstruction> code;
+    std::vector<LoaOperand> operands;
+    std::unordered_map<std::string, LoaInstruction> interned;  // predicate key -> its shared instruction
+    size_t slotCount = 0;
+    unsigned usedFields = 0;
+    uint32_t generation = 0;
+
+    // Shared results of the current run, valid while slotEpoch matches epoch
+    std::vector<uint32_t> slotEpoch;
+    std::vector<uint8_t> slotValue;
+    uint32_t epoch = 0;
+};
+
+extern LoaPredicateVM loaPredicates;
@@ -0,0 +1,119 @@
+﻿// =========================
+// File: LoaReference.cpp
+// =========================
+
+#include "LoaReference.h"
+#include <algorithm>
+
+namespace {
+
+// Airport lists as written in the JSON: four letters exact, anything shorter a prefix
+bool ReferenceAirportMatch(const std::vector<std::string>& airports, const std::string& airport)
+{
+    return std::any_of(airports.begin(), airports.end(), [&](const std::string& a) {
+        return a.length() == 4 ? a == airport : airport.compare(0, a.length(), a) == 0;
+    });
+}
+
+bool ReferenceRouteMatch(const LOAEntry& entry, const std::vector<std::string>& routePoints)
+{
+    return entry.waypointsOrdered ? RouteContainsWaypointsInOrder(routePoints, entry.waypoints)
+        : RouteContainsAllWaypoints(routePoints, entry.waypoints);
+}
+
+// aircraftTypes, wakeCategories, sids, stars, rflRangeFt, squawkRange
+bool ReferenceFlightMatch(const LOAEntry& entry, const LoaReferenceFlight& flight)
+{
+    auto anyOf = [](const std::vector<std::string>& values, const std::string& v) {
+        return values.empty() || std::any_of(values.begin(), values.end(), [&](const std::string& c) { return EqualsIgnoreCase(c, v); });
+    };
+    bool type = entry.aircraftTypes.empty() || std::any_of(entry.aircraftTypes.begin(), entry.aircraftTypes.end(), [&](const std::string& t) {
+        if (t.empty() || t.back() != '*') return EqualsIgnoreCase(t, flight.aircraftType);
+        return flight.aircraftType.size() >= t.size() - 1 && EqualsIgnoreCase(t.substr(0, t.size() - 1), flight.aircraftType.substr(0, t.size() - 1));
+    });
+    int squawk = ParseLoaSquawk(flight.squawk);
+    return type && anyOf(entry.wakeCategories, flight.wake) && anyOf(entry.sids, flight.sid) && anyOf(entry.stars, flight.star) &&
+        (entry.rflMinFt < 0 || (flight.finalAltitude >= entry.rflMinFt && flight.finalAltitude <= entry.rflMaxFt)) &&
+        (entry.squawkMin < 0 || (squawk >= entry.squawkMin && squawk <= entry.squawkMax));
+}
+
+// The tag callbacks' conditions: no tracking sector, and a rule requiring an
+// online next sector must name one
+bool ReferenceTagMatch(const LOAEntry& entry, const LoaReferenceFlight& flight, bool fallback)
+{
+    if (!entry.active) return false;
+    if (!fallback && !entry.originAirports.empty() && !ReferenceAirportMatch(entry.originAirports, flight.origin)) return false;
+    if (!entry.destinationAirports.empty() && !ReferenceAirportMatch(entry.destinationAirports, flight.destination)) return false;
+    if (!ReferenceFlightMatch(entry, flight) || !ReferenceRouteMatch(entry, flight.routePoints)) return false;
+    return fallback || !entry.requireNextSectorOnline || FirstOnlineNextSector(entry, flight.onlineControllers);
+}
+
+}  // namespace
+
+const LOAEntry* ReferenceMatchLoaEntry(const LoaReferenceRules& rules, const LoaReferenceFlight& flight)
+{
+    const std::vector<LOAEntry>* lists[] = { &rules.destination, &rules.departure, &rules.lorArrivals, &rules.lorDepartures };
+    for (const auto* list : lists) {
+        for (const auto& entry : *list) {
+            if (!entry.active) continue;
+            if (!entry.originAirports.empty() && !ReferenceAirportMatch(entry.originAirports, flight.origin)) continue;
+            if (!entry.destinationAirports.empty() && !ReferenceAirportMatch(entry.destinationAirports, flight.destination)) continue;
+            if (!ReferenceFlightMatch(entry, flight)) continue;
+
+            bool nextSectorMatch = entry.nextSectors.empty() || std::any_of(entry.nextSectors.begin(), entry.nextSectors.end(),
+                [&](const std::string& ns) { return EqualsIgnoreCase(ns, flight.controller); });
+            if (!nextSectorMatch || !ReferenceRouteMatch(entry, flight.routePoints)) continue;
+
+            if (entry.requireNextSectorOnline && !entry.nextSectors.empty() &&
+                !FirstOnlineNextSector(entry, flight.onlineControllers)) continue;
+
+            return &entry;
+        }
+    }
+
+    for (const auto& entry : rules.fallback) {
+        if (!entry.active || flight.clearedAltitude < entry.minAltitudeFt) continue;
+        if (!entry.destinationAirports.empty() && !ReferenceAirportMatch(entry.destinationAirports, flight.destination)) continue;
+        if (!ReferenceFlightMatch(entry, flight)) continue;
+        if (ReferenceRouteMatch(entry, flight.routePoints)) return &entry;
+    }
+    return nullptr;
+}
+
+void ReferenceTagItems(const LoaReferenceRules& rules, const LoaReferenceFlight& flight, std::string& xfl, std::string& cop)
+{
+    auto firstMatch = [&](const std::vector<LOAEntry>& list) -> const LOAEntry* {
+        for (const auto& entry : list)
+            if (ReferenceTagMatch(entry, flight, false)) return &entry;
+        return nullptr;
+    };
+    const LOAEntry* dep = firstMatch(rules.departure);
+    const LOAEntry* dest = firstMatch(rules.destination);
+    const LOAEntry* lorDep = firstMatch(rules.lorDepartures);
+    const LOAEntry* lorArr = firstMatch(rules.lorArrivals);
+    int cleared = flight.clearedAltitude;
+    int finalAltitude = flight.finalAltitude;
+
+    // XFL: departures count down to the first match's XFL, arrivals from above it
+    const LOAEntry* first = dep ? dep : dest ? dest : lorDep ? lorDep : lorArr;
+    bool departure = dep || (!dest && lorDep);
+    if (first && departure && cleared < first->xfl * 100 && finalAltitude > first->xfl * 100) xfl = std::to_string(first->xfl);
+    else if (first && !departure && cleared > first->xfl * 100) xfl = std::to_string(first->xfl);
+    else if ((first && cleared == first->xfl * 100) || cleared == finalAltitude) xfl.clear();
+    else xfl = std::to_string(finalAltitude / 100);
+
+    // COP: the first list whose match applies at this level, then the fallbacks
+    if (dep && cleared <= dep->xfl * 100) cop = dep->copText;
+    else if (dest && cleared >= dest->xfl * 100) cop = dest->copText;
+    else if (lorDep && cleared <= lorDep->xfl * 100) cop = lorDep->copText;
+    else if (lorArr && cleared >= lorArr->xfl * 100) cop = lorArr->copText;
+    else {
+        cop = "COPX";
+        for (const auto& entry : rules.fallback) {
+            if (cleared >= entry.minAltitudeFt && ReferenceTagMatch(entry, flight, true)) {
+                cop = entry.copText;
+                break;
+            }
+        }
+    }
+}
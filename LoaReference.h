@@ -0,0 +1,43 @@
+﻿#pragma once
+
+#include "LoaRules.h"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// =============================
+// Reference Engine
+// =============================
+// The plain linear scan over the rule lists and the extracted route that
+// MatchLoaEntry started out as, and the tag items as the tag callbacks computed
+// them before they were tabulated. It reads only its arguments, so any number
+// of threads may run it over the same rules: shadow mode checks the plugin's
+// caches against it (LoaShadow.h) and loa_daemon answers with it (tools/LoaDaemon.h).
+
+// Rule lists owned by the caller, e.g. a snapshot of the globals
+struct LoaReferenceRules {
+    std::vector<LOAEntry> destination, departure, lorArrivals, lorDepartures, fallback;
+};
+
+// Everything the reference engine reads about a flight
+struct LoaReferenceFlight {
+    std::string origin;
+    std::string destination;
+    std::string controller;
+    std::vector<std::string> routePoints;  // GetExtractedRoute
+    std::unordered_set<std::string> onlineControllers;
+    int clearedAltitude = 0;
+    std::string aircraftType;
+    std::string wake;
+    std::string sid;
+    std::string star;
+    int finalAltitude = 0;
+    std::string squawk;
+};
+
+// First matching rule in list order, fallbacks by cleared altitude
+const LOAEntry* ReferenceMatchLoaEntry(const LoaReferenceRules& rules, const LoaReferenceFlight& flight);
+
+// The "LOA XFL" and "COP" items at the flight's cleared altitude, before the
+// COP tag's geometric fallback (LoaSectorGeometry::RouteExitCop)
+void ReferenceTagItems(const LoaReferenceRules& rules, const LoaReferenceFlight& flight, std::string& xfl, std::string& cop);
@@ -0,0 +1,266 @@
+﻿// =========================
+// File: LoaRouteScan.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaRouteScan.h"
+#include "LOAPlugin.h"
+#include <algorithm>
+#include <cctype>
+#include <queue>
+
+LoaWaypointAutomaton loaWaypoints;
+
+namespace {
+
+int Symbol(char ch)
+{
+    if (ch >= 'A' && ch <= 'Z') return ch - 'A';
+    if (ch >= 'a' && ch <= 'z') return ch - 'a';
+    if (ch >= '0' && ch <= '9') return 26 + (ch - '0');
+    return -1;
+}
+
+std::string Upper(const std::string& s)
+{
+    std::string out = s;
+    for (auto& ch : out) if (ch >= 'a' && ch <= 'z') ch = (char)(ch - 'a' + 'A');
+    return out;
+}
+
+// Tokens that stand for more points than they name: airways (UL602, T180) and
+// procedures (RESMI1A). Speed/level groups (N0450F360, M082F370) and
+// coordinates (52N004E, 5230N00430E) are single points or none.
+bool ExpandsToPoints(const char* token, int length)
+{
+    if (token[0] >= '0' && token[0] <= '9') return false;
+    char first = (char)toupper((unsigned char)token[0]);
+    if ((first == 'N' || first == 'K' || first == 'M') && length >= 8 && token[1] >= '0' && token[1] <= '9')
+        return false;
+    return true;
+}
+
+} // namespace
+
+void LoaWaypointAutomaton::Clear()
+{
+    nodes.assign(1, Node());
+    std::fill(nodes[0].next, nodes[0].next + kAlphabet, 0);
+    names.clear();
+    ids.clear();
+    hasUnscannableNames = false;
+}
+
+void LoaWaypointAutomaton::Build(const std::vector<std::string>& waypointNames)
+{
+    Clear();
+    std::fill(nodes[0].next, nodes[0].next + kAlphabet, -1);
+
+    for (const auto& raw : waypointNames) {
+        std::string name = Upper(raw);
+        if (name.empty() || ids.count(name)) continue;
+        int id = (int)names.size();
+        names.push_back(name);
+        ids[name] = id;
+
+        if (std::any_of(name.begin(), name.end(), [](char ch) { return Symbol(ch) < 0; })) {
+            hasUnscannableNames = true;
+            continue;
+        }
+
+        int state = 0;
+        for (char ch : name) {
+            int c = Symbol(ch);
+            if (nodes[state].next[c] < 0) {
+                Node node;
+                std::fill(node.next, node.next + kAlphabet, -1);
+                node.depth = nodes[state].depth + 1;
+                nodes.push_back(node);
+                nodes[state].next[c] = (int)nodes.size() - 1;
+            }
+            state = nodes[state].next[c];
+        }
+        nodes[state].word = id;
+    }
+
+    // Failure links folded into the transition table (breadth first), so Scan
+    // takes exactly one table step per character
+    std::vector<int> fail(nodes.size(), 0);
+    std::queue<int> pending;
+    for (int c = 0; c < kAlphabet; ++c) {
+        int child = nodes[0].next[c];
+        if (child < 0) {
+            nodes[0].next[c] = 0;
+        }
+        else {
+            fail[child] = 0;
+            pending.push(child);
+        }
+    }
+    while (!pending.empty()) {
+        int state = pending.front();
+        pending.pop();
+        for (int c = 0; c < kAlphabet; ++c) {
+            int child = nodes[state].next[c];
+            if (child < 0) {
+                nodes[state].next[c] = nodes[fail[state]].next[c];
+            }
+            else {
+                fail[child] = nodes[fail[state]].next[c];
+                pending.push(child);
+            }
+        }
+    }
+}
+
+int LoaWaypointAutomaton::Find(const std::string& name) const
+{
+    auto it = ids.find(Upper(name));
+    return it == ids.end() ? -1 : it->second;
+}
+
+bool LoaWaypointAutomaton::Scan(const char* routeText, std::vector<int>& out) const
+{
+    if (!routeText || !*routeText) return false;
+
+    bool complete = !hasUnscannableNames;
+    int state = 0;
+    int length = 0;
+    bool hasDigit = false;
+    const char* token = routeText;
+
+    for (const char* p = routeText;; ++p) {
+        int c = Symbol(*p);
+        if (c >= 0) {
+            if (length++ == 0) token = p;
+            hasDigit |= c >= 26;
+            state = nodes[state].next[c];
+            continue;
+        }
+
+        // Token boundary: the automaton state spells the whole token only if
+        // no failure transition was taken on the way
+        if (length > 0) {
+            const Node& node = nodes[state];
+            if (node.depth == length && node.word >= 0)
+                out.push_back(node.word);
+            else if (hasDigit && ExpandsToPoints(token, length))
+                complete = false;
+        }
+        if (*p == 0) break;
+        state = 0;
+        length = 0;
+        hasDigit = false;
+    }
+    return complete;
+}
+
+void IndexLoaWaypoints()
+{
+    std::vector<std::string> all;
+    for (auto* list : { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas })
+        for (const auto& entry : *list) all.insert(all.end(), entry.waypoints.begin(), entry.waypoints.end());
+
+    loaWaypoints.Build(all);
+
+    for (auto* list : { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas }) {
+        for (auto& entry : *list) {
+            entry.waypointIds.clear();
+            entry.waypointSignature.Clear();
+            for (const auto& wp : entry.waypoints) {
+                entry.waypointIds.push_back(loaWaypoints.Find(wp));
+                entry.waypointSignature.Add(entry.waypointIds.back());
+            }
+        }
+    }
+}
+
+void LoaRouteWaypoints::Reset(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    found.clear();
+    foundNames.clear();
+    resolved = false;
+
+    const auto& fpd = fp.GetFlightPlanData();
+    complete = loaWaypoints.Scan(fpd.GetRoute(), found);
+
+    // The extracted route also carries the airports and any assigned SID/STAR
+    int origin = loaWaypoints.Find(fpd.GetOrigin());
+    if (origin >= 0) found.insert(found.begin(), origin);
+    int destination = loaWaypoints.Find(fpd.GetDestination());
+    if (destination >= 0) found.push_back(destination);
+    if (*fpd.GetSidName() || *fpd.GetStarName()) complete = false;
+
+    signature.Clear();
+    for (int id : found) signature.Add(id);
+    plugin->stats.routeScans++;
+}
+
+void LoaRouteWaypoints::Resolve(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    found.clear();
+    for (const auto& point : plugin->GetCachedRoutePoints(fp)) {
+        int id = loaWaypoints.Find(point);
+        if (id >= 0) found.push_back(id);
+    }
+    signature.Clear();
+    for (int id : found) signature.Add(id);
+    complete = resolved = true;
+    plugin->stats.routeExtractions++;
+}
+
+bool LoaRouteWaypoints::Contains(const LOAEntry& entry) const
+{
+    if (!entry.waypointSignature.CoveredBy(signature)) {
+        plugin->stats.signatureRejects++;
+        return false;
+    }
+
+    bool contained = true;
+    if (entry.waypointsOrdered) {
+        auto pos = found.begin();
+        for (int id : entry.waypointIds) {
+            pos = std::find(pos, found.end(), id);
+            if (pos == found.end()) {
+                contained = false;
+                break;
+            }
+            ++pos;
+        }
+    }
+    else {
+        contained = std::all_of(entry.waypointIds.begin(), entry.waypointIds.end(),
+            [&](int id) { return std::find(found.begin(), found.end(), id) != found.end(); });
+    }
+    if (!contained) plugin->stats.signatureFalsePositives++;
+    return contained;
+}
+
+bool LoaRouteWaypoints::Matches(const LOAEntry& entry, const EuroScopePlugIn::CFlightPlan& fp)
+{
+    if (entry.waypoints.empty()) return true;
+
+    // Entry added after the last IndexLoaWaypoints: compare names directly
+    if (entry.waypointIds.size() != entry.waypoints.size()) {
+        const auto& routePoints = plugin->GetCachedRoutePoints(fp);
+        return entry.waypointsOrdered ? RouteContainsWaypointsInOrder(routePoints, entry.waypoints)
+            : RouteContainsAllWaypoints(routePoints, entry.waypoints);
+    }
+
+    // Waypoints seen in the text are on the route, and in the same order
+    if (Contains(entry)) return true;
+    if (complete) return false;
+
+    Resolve(fp);
+    return Contains(entry);
+}
+
+const std::vector<std::string>& LoaRouteWaypoints::Names(const EuroScopePlugIn::CFlightPlan& fp)
+{
+    if (!complete) Resolve(fp);
+    if (resolved) return plugin->GetCachedRoutePoints(fp);
+
+    foundNames.clear();
+    for (int id : found) foundNames.push_back(loaWaypoints.Name(id));
+    return foundNames;
+}
@@ -0,0 +1,79 @@
+﻿#pragma once
+
+#include "EuroScopePlugIn.h"
+#include "LoaRules.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// =============================
+// LOA waypoint automaton
+// =============================
+// Aho-Corasick automaton over every waypoint name the loaded LOAs mention, so the
+// raw flight plan route ("RESMI UL602 SUPUR/N0450F360 DCT NIK") is searched for
+// all of them in one linear pass. Only letters and digits are part of the
+// alphabet; everything else is a token boundary and only whole tokens count.
+class LoaWaypointAutomaton {
+public:
+    LoaWaypointAutomaton() { Clear(); }
+
+    void Build(const std::vector<std::string>& waypointNames);
+    void Clear();
+
+    int Find(const std::string& name) const;  // id of an LOA waypoint, -1 for any other name
+    const std::string& Name(int id) const { return names[id]; }
+    int Count() const { return (int)names.size(); }
+
+    // Appends the ids of LOA waypoints found in the route text, in route order.
+    // Returns false if the text may hide LOA waypoints: airways and procedures
+    // expand into points the text does not spell out.
+    bool Scan(const char* routeText, std::vector<int>& ids) const;
+
+private:
+    static const int kAlphabet = 36;  // A-Z, 0-9
+    struct Node {
+        int next[kAlphabet];
+        int word = -1;   // waypoint id spelled by the path to this node
+        int depth = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;  // upper-cased name -> id
+    bool hasUnscannableNames = false;          // names with characters outside the alphabet
+};
+
+extern LoaWaypointAutomaton loaWaypoints;
+
+// Rebuilds loaWaypoints from the global LOA lists and fills LOAEntry::waypointIds
+// and waypointSignature
+void IndexLoaWaypoints();
+
+// =============================
+// Route waypoints of one flight
+// =============================
+// Answers "does this route pass the entry's waypoints" from the route text
+// whenever the text is decisive, and falls back to GetExtractedRoute only when
+// a rule needs an answer the text cannot give.
+class LoaRouteWaypoints {
+public:
+    void Reset(const EuroScopePlugIn::CFlightPlan& fp);
+
+    // All of entry.waypoints on the route (in listed order for waypointsOrdered)
+    bool Matches(const LOAEntry& entry, const EuroScopePlugIn::CFlightPlan& fp);
+
+    // Route point names for the compiled matcher: just the LOA waypoints when
+    // the text is decisive, the extracted route otherwise
+    const std::vector<std::string>& Names(const EuroScopePlugIn::CFlightPlan& fp);
+
+private:
+    void Resolve(const EuroScopePlugIn::CFlightPlan& fp);
+    bool Contains(const LOAEntry& entry) const;
+
+    std::vector<int> found;  // waypoint ids in route order
+    LoaWaypointSignature signature;  // of found
+    std::vector<std::string> foundNames;
+    bool complete = false;   // found lists every LOA waypoint on the route
+    bool resolved = false;   // found comes from the extracted route
+};
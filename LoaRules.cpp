@@ -0,0 +1,294 @@
+﻿// =========================
+// File: LoaRules.cpp
+// =========================
+
+#include "LoaRules.h"
+#include "LoaCompiled.h"
+#include "LoaLog.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <stdexcept>
+#include <json.hpp>
+
+using json = nlohmann::json;
+
+std::vector<LOAEntry> destinationLoas;
+std::vector<LOAEntry> departureLoas;
+std::vector<LOAEntry> lorArrivals;
+std::vector<LOAEntry> lorDepartures;
+std::vector<LOAEntry> fallbackLoas;
+
+namespace {
+
+// One file's worth of the global LOA lists
+struct LoaConfigLists {
+    std::vector<LOAEntry> destination, departure, lorArrivals, lorDepartures, fallback;
+    std::vector<LoaGeoPoint> boundary;  // optional, see LoaGeometry.h
+    std::vector<LoaNamedPoint> cops;
+};
+
+bool ParseLOAConfigFile(const std::string& filePath, LoaConfigLists& out, std::string& bytes, std::string& error)
+{
+    std::ifstream inFile(filePath, std::ios::binary);
+    if (!inFile.is_open()) {
+        error = "cannot open " + filePath;
+        return false;
+    }
+    bytes.assign((std::istreambuf_iterator<char>(inFile)), std::istreambuf_iterator<char>());
+
+    json config;
+    try {
+        config = json::parse(bytes);
+    }
+    catch (const std::exception& e) {
+        error = std::string("parse error in ") + filePath + ": " + e.what();
+        return false;
+    }
+
+    auto processAirportList = [](const std::vector<std::string>& list,
+        std::unordered_set<std::string>& exact,
+        std::vector<std::string>& prefixes)
+        {
+            for (const std::string& a : list) {
+                if (a.length() == 4) exact.insert(a);
+                else prefixes.push_back(a);
+            }
+        };
+
+    auto parseLOAList = [&](const json& array, bool isFallback = false) {
+        std::vector<LOAEntry> result;
+        for (const auto& item : array) {
+            LOAEntry loa;
+            if (item.contains("origins")) {
+                loa.originAirports = item["origins"].get<std::vector<std::string>>();
+                processAirportList(loa.originAirports, loa.originAirportSet, loa.originAirportPrefixes);
+            }
+            if (item.contains("destinations")) {
+                loa.destinationAirports = item["destinations"].get<std::vector<std::string>>();
+                processAirportList(loa.destinationAirports, loa.destinationAirportSet, loa.destinationAirportPrefixes);
+            }
+            if (item.contains("waypoints")) loa.waypoints = item["waypoints"].get<std::vector<std::string>>();
+            if (item.contains("nextSectors")) loa.nextSectors = item["nextSectors"].get<std::vector<std::string>>();
+            if (item.contains("copText")) loa.copText = item["copText"].get<std::string>();
+            if (item.contains("requireNextSectorOnline")) loa.requireNextSectorOnline = item["requireNextSectorOnline"].get<bool>();
+            if (item.contains("xfl")) loa.xfl = item["xfl"].get<int>();
+            if (item.contains("minAltitudeFt")) loa.minAltitudeFt = item["minAltitudeFt"].get<int>();
+            if (item.contains("waypointsOrdered")) loa.waypointsOrdered = item["waypointsOrdered"].get<bool>();
+            if (item.contains("activeWhen")) loa.activeWhen = item["activeWhen"].get<std::string>();
+            if (item.contains("aircraftTypes")) loa.aircraftTypes = item["aircraftTypes"].get<std::vector<std::string>>();
+            if (item.contains("wakeCategories")) loa.wakeCategories = item["wakeCategories"].get<std::vector<std::string>>();
+            if (item.contains("sids")) loa.sids = item["sids"].get<std::vector<std::string>>();
+            if (item.contains("stars")) loa.stars = item["stars"].get<std::vector<std::string>>();
+            if (item.contains("rflRangeFt")) {
+                auto range = item["rflRangeFt"].get<std::vector<int>>();
+                if (range.size() == 2 && range[0] >= 0 && range[0] <= range[1]) {
+                    loa.rflMinFt = range[0];
+                    loa.rflMaxFt = range[1];
+                }
+                else LOA_LOG_WARN("%s: ignoring rflRangeFt (expected [min, max] in feet)", filePath.c_str());
+            }
+            if (item.contains("squawkRange")) {
+                auto range = item["squawkRange"].get<std::vector<std::string>>();
+                int low = range.size() == 2 ? ParseLoaSquawk(range[0]) : -1;
+                int high = range.size() == 2 ? ParseLoaSquawk(range[1]) : -1;
+                if (low >= 0 && high >= low) {
+                    loa.squawkMin = low;
+                    loa.squawkMax = high;
+                }
+                else LOA_LOG_WARN("%s: ignoring squawkRange (expected [\"1000\", \"1077\"])", filePath.c_str());
+            }
+            if (item.contains("activeUtc")) {
+                for (const auto& text : item["activeUtc"].get<std::vector<std::string>>()) {
+                    LoaActivationWindow window;
+                    if (ParseLoaActivationWindow(text, window)) loa.activeUtc.push_back(window);
+                    else LOA_LOG_WARN("%s: ignoring activeUtc \"%s\" (expected HHMM-HHMM)", filePath.c_str(), text.c_str());
+                }
+            }
+            result.push_back(loa);
+        }
+        return result;
+        };
+
+    if (config.contains("destinationLoas")) out.destination = parseLOAList(config["destinationLoas"]);
+    if (config.contains("departureLoas")) out.departure = parseLOAList(config["departureLoas"]);
+    if (config.contains("lorArrivals")) out.lorArrivals = parseLOAList(config["lorArrivals"]);
+    if (config.contains("lorDepartures")) out.lorDepartures = parseLOAList(config["lorDepartures"]);
+    if (config.contains("fallbackLoas")) out.fallback = parseLOAList(config["fallbackLoas"], true);
+
+    // Sector geometry for COPs of flights no rule covers; a malformed one is skipped
+    try {
+        if (config.contains("boundary")) {
+            for (const auto& p : config["boundary"].get<std::vector<std::vector<double>>>()) {
+                if (p.size() != 2) throw std::runtime_error("boundary points are [lat, lon]");
+                LoaGeoPoint point;
+                point.lat = p[0];
+                point.lon = p[1];
+                out.boundary.push_back(point);
+            }
+        }
+        if (config.contains("cops")) {
+            for (const auto& cop : config["cops"].items()) {
+                auto p = cop.value().get<std::vector<double>>();
+                if (p.size() != 2) throw std::runtime_error("COP positions are [lat, lon]");
+                LoaNamedPoint named;
+                named.name = cop.key();
+                named.position.lat = p[0];
+                named.position.lon = p[1];
+                out.cops.push_back(named);
+            }
+        }
+    }
+    catch (const std::exception& e) {
+        LOA_LOG_WARN("%s: ignoring sector geometry (%s)", filePath.c_str(), e.what());
+        out.boundary.clear();
+        out.cops.clear();
+    }
+    return true;
+}
+
+// Everything a rule is matched on; two rules with the same conditions in the
+// same list can only ever return the first
+std::string RuleConditionKey(const LOAEntry& e)
+{
+    std::string key;
+    for (const auto* list : { &e.originAirports, &e.destinationAirports, &e.waypoints, &e.nextSectors,
+        &e.aircraftTypes, &e.wakeCategories, &e.sids, &e.stars }) {
+        for (const auto& s : *list) key += s + ",";
+        key += "|";
+    }
+    key += std::to_string(e.requireNextSectorOnline) + std::to_string(e.waypointsOrdered) + "|" + std::to_string(e.minAltitudeFt);
+    for (const auto& w : e.activeUtc) key += "|" + std::to_string(w.fromMinute) + "-" + std::to_string(w.toMinute);
+    key += "|" + e.activeWhen;
+    key += "|" + std::to_string(e.rflMinFt) + "-" + std::to_string(e.rflMaxFt) + "|" + std::to_string(e.squawkMin) + "-" + std::to_string(e.squawkMax);
+    return key;
+}
+
+void MergeLOAList(std::vector<LOAEntry>& merged, std::vector<LOAEntry>& from,
+    const std::unordered_set<std::string>& owned, bool dedupe, LoaMergeReport& report)
+{
+    std::unordered_set<std::string> seen;
+    if (dedupe) for (const auto& e : merged) seen.insert(RuleConditionKey(e));
+
+    for (auto& e : from) {
+        report.rules++;
+        // Handoff into a sector of our own bandbox: not a coordination any more
+        if (owned.size() > 1 && !e.nextSectors.empty() && std::all_of(e.nextSectors.begin(), e.nextSectors.end(),
+            [&](const std::string& s) { return owned.count(s) > 0; })) {
+            report.internal++;
+            continue;
+        }
+        if (dedupe && !seen.insert(RuleConditionKey(e)).second) {
+            report.duplicates++;
+            continue;
+        }
+        merged.push_back(std::move(e));
+    }
+}
+
+} // namespace
+
+bool PrepareLOAConfigFiles(const std::vector<std::string>& filePaths, const std::vector<std::string>& ownedSectors,
+    LoaPreparedConfig& merged, std::string& error, LoaMergeReport* report)
+{
+    LoaMergeReport local;
+    LoaMergeReport& r = report ? *report : local;
+    r = LoaMergeReport();
+
+    std::unordered_set<std::string> owned(ownedSectors.begin(), ownedSectors.end());
+    merged = LoaPreparedConfig();
+    // A single file keeps its rule indices: compiled rulesets refer to rules by index
+    bool dedupe = filePaths.size() > 1;
+
+    for (size_t i = 0; i < filePaths.size(); ++i) {
+        LoaConfigLists lists;
+        std::string bytes;
+        if (!ParseLOAConfigFile(filePaths[i], lists, bytes, error)) {
+            // A bandboxed sector without a file of its own just adds no rules
+            if (i > 0 && bytes.empty()) {
+                r.missing.push_back(filePaths[i]);
+                continue;
+            }
+            return false;
+        }
+        r.files++;
+        merged.hashed += bytes;
+
+        MergeLOAList(merged.destination, lists.destination, owned, dedupe, r);
+        MergeLOAList(merged.departure, lists.departure, owned, dedupe, r);
+        MergeLOAList(merged.lorArrivals, lists.lorArrivals, owned, dedupe, r);
+        MergeLOAList(merged.lorDepartures, lists.lorDepartures, owned, dedupe, r);
+        MergeLOAList(merged.fallback, lists.fallback, owned, dedupe, r);
+        if (!lists.boundary.empty()) merged.boundaries.push_back(std::move(lists.boundary));
+        merged.cops.insert(merged.cops.end(), lists.cops.begin(), lists.cops.end());
+    }
+
+    // A bandbox hashes differently from any of its files, so no single-sector
+    // compiled ruleset is mistaken for it
+    if (owned.size() > 1)
+        for (const auto& s : ownedSectors) merged.hashed += "\n" + s;
+    return true;
+}
+
+// FNV-1a over the raw file bytes
+uint64_t HashLoaConfig(const std::string& bytes)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (unsigned char c : bytes) {
+        h ^= c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+// =============================
+// Comparisons
+// =============================
+
+// Case-insensitive compare
+bool EqualsIgnoreCase(const std::string& a, const std::string& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(),
+        [](char a, char b) { return tolower(a) == tolower(b); });
+}
+
+// Every required waypoint appears somewhere in the extracted route
+bool RouteContainsAllWaypoints(const std::vector<std::string>& routePoints, const std::vector<std::string>& waypoints) {
+    return std::all_of(waypoints.begin(), waypoints.end(),
+        [&](const std::string& wp) {
+            return std::any_of(routePoints.begin(), routePoints.end(),
+                [&](const std::string& r) { return EqualsIgnoreCase(r, wp); });
+        });
+}
+
+// Every required waypoint appears, each after the previous one
+bool RouteContainsWaypointsInOrder(const std::vector<std::string>& routePoints, const std::vector<std::string>& waypoints) {
+    auto pos = routePoints.begin();
+    for (const auto& wp : waypoints) {
+        pos = std::find_if(pos, routePoints.end(), [&](const std::string& r) { return EqualsIgnoreCase(r, wp); });
+        if (pos == routePoints.end()) return false;
+        ++pos;
+    }
+    return true;
+}
+
+int ParseLoaSquawk(const char* text)
+{
+    int value = 0;
+    for (int i = 0; i < 4; ++i) {
+        if (text[i] < '0' || text[i] > '7') return -1;
+        value = value * 8 + (text[i] - '0');
+    }
+    return text[4] == 0 ? value : -1;
+}
+
+int ParseLoaSquawk(const std::string& text)
+{
+    return ParseLoaSquawk(text.c_str());
+}
+
+const std::string* FirstOnlineNextSector(const LOAEntry& entry, const std::unordered_set<std::string>& onlineControllers)
+{
+    auto it = std::find_if(entry.nextSectors.begin(), entry.nextSectors.end(),
+        [&](const std::string& s) { return onlineControllers.count(s) > 0; });
+    return it != entry.nextSectors.end() ? &*it : nullptr;
+}
@@ -0,0 +1,133 @@
+﻿#pragma once
+
+#include "LoaActivation.h"
+#include "LoaGeometry.h"
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// =============================
+// LOA rules
+// =============================
+// The rule lists and everything that reads or compares them without EuroScope:
+// the loa_configs_json parser, bandbox merging and the string helpers the
+// matchers share. The plugin installs what PrepareLOAConfigFiles returns;
+// loa_daemon (tools/LoaDaemon.h) links this part only.
+
+// =============================
+// Waypoint signatures
+// =============================
+// 128-bit Bloom signature of a set of waypoint ids, two bits per id. An entry can
+// only be on a route whose signature has all of its bits, so a single AND-NOT
+// turns away most entries before any ids are compared.
+struct LoaWaypointSignature {
+    uint64_t bits[2] = { 0, 0 };
+
+    void Clear() { bits[0] = bits[1] = 0; }
+    void Add(int id)
+    {
+        uint64_t h = (uint64_t)(uint32_t)id * 0x9E3779B97F4A7C15ull;
+        Set((unsigned)(h >> 57));
+        Set((unsigned)(h >> 50) & 127);
+    }
+    bool CoveredBy(const LoaWaypointSignature& route) const
+    {
+        return ((bits[0] & ~route.bits[0]) | (bits[1] & ~route.bits[1])) == 0;
+    }
+
+private:
+    void Set(unsigned bit) { bits[bit >> 6] |= 1ull << (bit & 63); }
+};
+
+// =============================
+// LOAEntry Struct
+// =============================
+struct LOAEntry {
+    std::vector<std::string> sectors;
+    std::vector<std::string> waypoints;
+    std::vector<std::string> originAirports;
+    std::vector<std::string> destinationAirports;
+    std::vector<std::string> nextSectors;
+    int xfl = 0;
+    std::string copText = "COPX";
+    bool requireNextSectorOnline = false;
+    int minAltitudeFt = 0;  // For fallbackLoas: minimum altitude (e.g. 24500 for FL245)
+    bool waypointsOrdered = false;  // "via A then B": waypoints must appear in the listed order
+    std::vector<LoaActivationWindow> activeUtc;  // only applies inside these UTC windows (see LoaActivation.h)
+    std::string activeWhen;         // only applies while this named condition is on
+    bool active = true;             // maintained by loaActivation; matchers skip inactive rules
+
+    // Flight conditions (see LoaPredicate.h); empty / -1 = any
+    std::vector<std::string> aircraftTypes;   // ICAO types, "A32*" matches a prefix
+    std::vector<std::string> wakeCategories;  // "L", "M", "H", "J"
+    std::vector<std::string> sids;
+    std::vector<std::string> stars;
+    int rflMinFt = -1;
+    int rflMaxFt = -1;
+    int squawkMin = -1;  // octal code as a number, e.g. 01000
+    int squawkMax = -1;
+
+    // This rule's instructions in loaPredicates (LoaPredicateVM::Compile)
+    uint32_t programStart = 0;
+    uint32_t programGeneration = 0;
+    uint16_t programLength = 0;
+   
+
+    // ✅ NEW: Optimized airport matching
+    std::unordered_set<std::string> originAirportSet;
+    std::vector<std::string> originAirportPrefixes;
+    std::unordered_set<std::string> destinationAirportSet;
+    std::vector<std::string> destinationAirportPrefixes;
+
+    std::vector<int> waypointIds;  // waypoints as loaWaypoints ids (IndexLoaWaypoints)
+    LoaWaypointSignature waypointSignature;  // of waypointIds
+};
+
+
+// =============================
+// Global LOA Containers
+// =============================
+extern std::vector<LOAEntry> destinationLoas;
+extern std::vector<LOAEntry> departureLoas;
+extern std::vector<LOAEntry> lorArrivals;
+extern std::vector<LOAEntry> lorDepartures;
+extern std::vector<LOAEntry> fallbackLoas;
+
+// =============================
+// Loading
+// =============================
+
+// What merging a bandbox's sector files did
+struct LoaMergeReport {
+    size_t files = 0;
+    size_t rules = 0;        // rules read, before merging
+    size_t duplicates = 0;   // same conditions as an earlier rule in the same list
+    size_t internal = 0;     // every next sector is one of the owned sectors
+    std::vector<std::string> missing;  // sector files that do not exist
+};
+
+// Reads, parses and merges the sector files (see LoadLOAConfigFiles) and touches
+// no global state, so it may run on a worker thread
+struct LoaPreparedConfig {
+    std::vector<LOAEntry> destination, departure, lorArrivals, lorDepartures, fallback;
+    std::vector<std::vector<LoaGeoPoint>> boundaries;  // one per sector file that has one
+    std::vector<LoaNamedPoint> cops;
+    std::string hashed;  // what loadedConfigHash is taken over
+};
+bool PrepareLOAConfigFiles(const std::vector<std::string>& filePaths, const std::vector<std::string>& ownedSectors,
+    LoaPreparedConfig& out, std::string& error, LoaMergeReport* report = nullptr);
+
+// =============================
+// Comparisons
+// =============================
+bool EqualsIgnoreCase(const std::string& a, const std::string& b);
+
+// "1077" -> 01077; -1 unless four octal digits
+int ParseLoaSquawk(const char* text);
+int ParseLoaSquawk(const std::string& text);
+bool RouteContainsAllWaypoints(const std::vector<std::string>& routePoints, const std::vector<std::string>& waypoints);
+bool RouteContainsWaypointsInOrder(const std::vector<std::string>& routePoints, const std::vector<std::string>& waypoints);
+
+// First of the entry's next sectors that is online (what the next-sector tag shows)
+const std::string* FirstOnlineNextSector(const LOAEntry& entry, const std::unordered_set<std::string>& onlineControllers);
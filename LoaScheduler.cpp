@@ -0,0 +1,77 @@
+﻿// =========================
+// File: LoaScheduler.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaScheduler.h"
+#include <algorithm>
+
+bool LoaEvaluationScheduler::BeginFrame(bool force)
+{
+    auto now = std::chrono::steady_clock::now();
+    bool newFrame = force || now - lastCallback > std::chrono::milliseconds(kFrameGapMs);
+    lastCallback = now;
+    if (!newFrame) return false;
+
+    stats.frames++;
+    frameSpentUs = 0;
+    frameOverrun = false;
+    return true;
+}
+
+void LoaEvaluationScheduler::Charge(double elapsedUs, bool inlineRun)
+{
+    if (inlineRun) stats.inlineEvaluations++;
+    else stats.queuedEvaluations++;
+    ChargeWork(elapsedUs);
+}
+
+void LoaEvaluationScheduler::ChargeWork(double elapsedUs)
+{
+    frameSpentUs += elapsedUs;
+    stats.worstFrameUs = std::max(stats.worstFrameUs, frameSpentUs);
+
+    if (budgetUs > 0 && frameSpentUs > budgetUs && !frameOverrun) {
+        frameOverrun = true;
+        stats.overruns++;
+    }
+}
+
+void LoaEvaluationScheduler::Request(const std::string& callsign, LoaUrgency urgency)
+{
+    auto it = pending.find(callsign);
+    if (it != pending.end() && it->second >= urgency) return;
+
+    if (it == pending.end()) it = pending.emplace(callsign, urgency).first;
+    else if (it->second == LOA_URGENCY_WARMUP) warmupDepth--;
+    it->second = urgency;
+    if (urgency == LOA_URGENCY_WARMUP) warmupDepth++;
+    queues[urgency].push_back(callsign);
+    stats.maxQueueDepth = std::max(stats.maxQueueDepth, pending.size());
+}
+
+bool LoaEvaluationScheduler::PopNext(std::string& callsign, LoaUrgency minUrgency)
+{
+    for (int urgency = LOA_URGENCY_COUNT - 1; urgency >= minUrgency; --urgency) {
+        auto& queue = queues[urgency];
+        while (!queue.empty()) {
+            callsign = std::move(queue.front());
+            queue.pop_front();
+
+            auto it = pending.find(callsign);
+            if (it == pending.end() || it->second != urgency) continue;  // removed or re-queued higher
+            pending.erase(it);
+            if (urgency == LOA_URGENCY_WARMUP) warmupDepth--;
+            return true;
+        }
+    }
+    return false;
+}
+
+void LoaEvaluationScheduler::Remove(const std::string& callsign)
+{
+    auto it = pending.find(callsign);
+    if (it == pending.end()) return;
+    if (it->second == LOA_URGENCY_WARMUP) warmupDepth--;
+    pending.erase(it);
+}
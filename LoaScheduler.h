@@ -0,0 +1,74 @@
+﻿#pragma once
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+// =============================
+// Evaluation Scheduler
+// =============================
+// Caps the matching work done per radar refresh. A flight whose match has
+// expired is evaluated inline while the frame still has budget; beyond that it
+// is queued by urgency and its tags keep the last good result until a later
+// frame (or the 1 s timer, when nothing is drawn) gets to it.
+//
+// Warm-up requests (flights about to need a tag) sit below everything else and
+// are only drained from the timer, so they never cost a frame or hold up an
+// inline evaluation.
+
+enum LoaUrgency {
+    LOA_URGENCY_WARMUP = 0,    // not drawn yet: entering a relevant state or nearing our sector
+    LOA_URGENCY_ROUTINE = 1,   // sector came online/offline
+    LOA_URGENCY_VISIBLE = 2,   // tag drawn with an expired match
+    LOA_URGENCY_ALTITUDE = 3,  // cleared or final altitude just changed
+    LOA_URGENCY_ASSUMED = 4,   // newly assumed
+    LOA_URGENCY_COUNT = 5
+};
+
+struct LoaSchedulerStats {
+    unsigned long long frames = 0;
+    unsigned long long overruns = 0;        // frames whose evaluations exceeded the budget
+    unsigned long long inlineEvaluations = 0;
+    unsigned long long queuedEvaluations = 0;
+    size_t maxQueueDepth = 0;
+    double worstFrameUs = 0;
+};
+
+class LoaEvaluationScheduler {
+public:
+    int budgetUs = 2000;  // per frame, 0 = unlimited (".loa budget")
+
+    // Called from every tag callback; returns true when it starts a new frame
+    // (the first callback after a quiet gap). The timer starts one explicitly.
+    bool BeginFrame(bool force = false);
+
+    bool HasBudget() const { return budgetUs <= 0 || frameSpentUs < budgetUs; }
+    bool CanRunInline() const { return HasBudget() && QueueDepth() == warmupDepth; }
+    void Charge(double elapsedUs, bool inlineRun);
+    // Work other than an evaluation that still comes out of the frame's budget
+    void ChargeWork(double elapsedUs);
+
+    // Queues a flight, or raises the urgency of one already queued
+    void Request(const std::string& callsign, LoaUrgency urgency);
+    // Most urgent queued flight at or above minUrgency
+    bool PopNext(std::string& callsign, LoaUrgency minUrgency = LOA_URGENCY_ROUTINE);
+    void Remove(const std::string& callsign);
+    size_t QueueDepth() const { return pending.size(); }
+    size_t WarmupDepth() const { return warmupDepth; }
+    bool IsQueued(const std::string& callsign) const { return pending.count(callsign) > 0; }
+
+    LoaSchedulerStats stats;
+
+private:
+    static const int kFrameGapMs = 10;
+
+    std::chrono::steady_clock::time_point lastCallback;
+    double frameSpentUs = 0;
+    bool frameOverrun = false;
+
+    // One FIFO per urgency; entries whose urgency changed since are skipped on pop
+    std::deque<std::string> queues[LOA_URGENCY_COUNT];
+    std::unordered_map<std::string, int> pending;  // callsign -> current urgency
+    size_t warmupDepth = 0;                        // of those, at LOA_URGENCY_WARMUP
+};
@@ -0,0 +1,194 @@
+﻿// =========================
+// File: LoaShadow.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaShadow.h"
+#include "LOAPlugin.h"
+#include "LoaLog.h"
+#include <algorithm>
+#include <chrono>
+
+LoaShadowMatcher loaShadow;
+
+namespace {
+
+double MicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace
+
+void LoaShadowMatcher::Start(double newPercent)
+{
+    percent = std::min(newPercent, 100.0);
+    sampleCredit = 0;
+    if (running) return;
+
+    SetRules();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = false;
+        stats = LoaShadowStats();
+    }
+    worker = std::thread(&LoaShadowMatcher::WorkLoop, this);
+    running = true;
+}
+
+void LoaShadowMatcher::Stop()
+{
+    if (!running) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    running = false;
+    queue.clear();
+    rules.reset();
+}
+
+void LoaShadowMatcher::SetRules()
+{
+    auto snapshot = std::make_shared<LoaReferenceRules>();
+    snapshot->destination = destinationLoas;
+    snapshot->departure = departureLoas;
+    snapshot->lorArrivals = lorArrivals;
+    snapshot->lorDepartures = lorDepartures;
+    snapshot->fallback = fallbackLoas;
+    rules = snapshot;
+}
+
+bool LoaShadowMatcher::ShouldSample()
+{
+    sampleCredit += percent / 100.0;
+    if (sampleCredit < 1.0) return false;
+    sampleCredit -= 1.0;
+    return true;
+}
+
+void LoaShadowMatcher::Submit(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+    const LOAEntry* result, double optimizedUs, LoaRouteWaypoints* route)
+{
+    auto sampleStart = std::chrono::steady_clock::now();
+    LoaShadowSample sample;
+    sample.callsign = fp.GetCallsign();
+    sample.origin = fp.GetFlightPlanData().GetOrigin();
+    sample.destination = fp.GetFlightPlanData().GetDestination();
+    sample.controller = fp.GetTrackingControllerId();
+    sample.onlineControllers = onlineControllers;
+    sample.clearedAltitude = fp.GetClearedAltitude();
+    sample.aircraftType = fp.GetFlightPlanData().GetAircraftFPType();
+    sample.wake = std::string(1, fp.GetFlightPlanData().GetAircraftWtc());
+    sample.sid = fp.GetFlightPlanData().GetSidName();
+    sample.star = fp.GetFlightPlanData().GetStarName();
+    sample.finalAltitude = fp.GetFinalAltitude();
+    sample.squawk = fp.GetControllerAssignedData().GetSquawk();
+    sample.optimizedUs = optimizedUs;
+    sample.rules = rules;
+
+    auto start = std::chrono::steady_clock::now();
+    EuroScopePlugIn::CFlightPlanExtractedRoute extracted = fp.GetExtractedRoute();
+    for (int i = 0; i < extracted.GetPointsNumber(); ++i)
+        sample.routePoints.emplace_back(extracted.GetPointName(i));
+    sample.extractionUs = MicrosecondsSince(start);
+
+    // What the tags show at this level: the cached tables, built now if they are out of date
+    LoaRouteWaypoints localRoute;
+    if (!route) {
+        localRoute.Reset(fp);
+        route = &localRoute;
+    }
+    CachedTagData data = { sample.callsign, sample.clearedAltitude, sample.finalAltitude, sample.origin, sample.destination };
+    const LoaFlightProfile& profile = plugin->GetAltitudeProfile(fp, data, onlineControllers, *route);
+    sample.tagXfl = profile.xfl.Lookup(sample.clearedAltitude);
+    sample.tagCop = profile.cop.Lookup(sample.clearedAltitude);
+
+    if (result) {
+        sample.matched = true;
+        sample.xfl = result->xfl;
+        sample.cop = result->copText;
+        if (const std::string* next = FirstOnlineNextSector(*result, onlineControllers)) sample.nextSector = *next;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.submitted++;
+        stats.sampleUs += MicrosecondsSince(sampleStart);
+        if (queue.size() >= kMaxQueued) {
+            stats.dropped++;
+            return;
+        }
+        queue.push_back(std::move(sample));
+    }
+    wake.notify_one();
+}
+
+LoaShadowStats LoaShadowMatcher::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void LoaShadowMatcher::WorkLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [this] { return stopping || !queue.empty(); });
+        if (stopping) return;
+
+        LoaShadowSample sample = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        Check(sample);
+        lock.lock();
+    }
+}
+
+void LoaShadowMatcher::Check(const LoaShadowSample& sample)
+{
+    auto start = std::chrono::steady_clock::now();
+    const LOAEntry* reference = ReferenceMatchLoaEntry(*sample.rules, sample);
+    std::string nextSector;
+    if (reference) {
+        if (const std::string* next = FirstOnlineNextSector(*reference, sample.onlineControllers)) nextSector = *next;
+    }
+    std::string tagXfl, tagCop;
+    ReferenceTagItems(*sample.rules, sample, tagXfl, tagCop);
+    double referenceUs = MicrosecondsSince(start) + sample.extractionUs;
+
+    bool agree = sample.matched == (reference != nullptr) &&
+        (!reference || (sample.xfl == reference->xfl && sample.cop == reference->copText && sample.nextSector == nextSector)) &&
+        sample.tagXfl == tagXfl && sample.tagCop == tagCop;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stats.samples++;
+        stats.optimizedUs += sample.optimizedUs;
+        stats.referenceUs += referenceUs;
+        if (!agree) stats.disagreements++;
+    }
+
+    LOA_LOG_DEBUG("SHADOW %s optimized %.1f us, reference %.1f us", sample.callsign.c_str(), sample.optimizedUs, referenceUs);
+    if (agree) return;
+
+    LOA_LOG_WARN("SHADOW MISMATCH %s %s->%s tracked by %s CFL %d: xfl %d/%d cop %s/%s next %s/%s (optimized/reference)",
+        sample.callsign.c_str(), sample.origin.c_str(), sample.destination.c_str(), sample.controller.c_str(), sample.clearedAltitude,
+        sample.matched ? sample.xfl : 0, reference ? reference->xfl : 0,
+        sample.matched ? sample.cop.c_str() : "-", reference ? reference->copText.c_str() : "-",
+        sample.nextSector.empty() ? "-" : sample.nextSector.c_str(), nextSector.empty() ? "-" : nextSector.c_str());
+    LOA_LOG_WARN("SHADOW MISMATCH %s tag tables at CFL %d: xfl '%s'/'%s' cop %s/%s (optimized/reference)",
+        sample.callsign.c_str(), sample.clearedAltitude, sample.tagXfl.c_str(), tagXfl.c_str(), sample.tagCop.c_str(), tagCop.c_str());
+
+    // Log slots are short: route and online set go out in chunks
+    auto writeList = [&](const char* label, const std::string& all) {
+        for (size_t pos = 0; pos < all.size() || pos == 0; pos += 140)
+            LOA_LOG_WARN("SHADOW MISMATCH %s %s: %s", sample.callsign.c_str(), label, all.substr(pos, 140).c_str());
+    };
+    std::string route, online;
+    for (const auto& p : sample.routePoints) route += (route.empty() ? "" : " ") + p;
+    for (const auto& s : sample.onlineControllers) online += (online.empty() ? "" : " ") + s;
+    writeList("route", route);
+    writeList("online", online);
+}
@@ -0,0 +1,92 @@
+﻿#pragma once
+
+#include "EuroScopePlugIn.h"
+#include "LoaReference.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class LoaRouteWaypoints;
+
+// =============================
+// Shadow Matching
+// =============================
+// ".loa shadow <percent>": a sample of the evaluations MatchLoaEntry makes is
+// re-run on a worker thread through the reference engine (LoaReference.h).
+// Any difference in XFL, COP or next sector is logged with the flight's inputs,
+// and so is any difference in what the XFL and COP tag tables show at the
+// sampled cleared level. Both engines are timed per flight, so live traffic
+// shows the speedup as well; copying a sample is timed as UI thread cost.
+
+// Everything the reference engine reads, copied on the UI thread
+struct LoaShadowSample : LoaReferenceFlight {
+    std::string callsign;
+
+    // What the optimized matcher decided
+    bool matched = false;
+    int xfl = 0;
+    std::string cop;
+    std::string nextSector;
+    std::string tagXfl;  // the tag tables at clearedAltitude, before the geometric COP
+    std::string tagCop;
+    double optimizedUs = 0;
+    double extractionUs = 0;  // charged to the reference engine, which needs the extracted route
+
+    std::shared_ptr<const LoaReferenceRules> rules;  // as they were when the sample was taken
+};
+
+struct LoaShadowStats {
+    unsigned long long submitted = 0;
+    unsigned long long samples = 0;
+    unsigned long long disagreements = 0;
+    unsigned long long dropped = 0;  // queue full
+    double optimizedUs = 0;          // totals over the samples
+    double referenceUs = 0;
+    double sampleUs = 0;             // taking the samples, on the UI thread
+};
+
+class LoaShadowMatcher {
+public:
+    ~LoaShadowMatcher() { Stop(); }
+
+    void Start(double percent);
+    void Stop();
+    bool IsRunning() const { return running; }
+    double GetPercent() const { return percent; }
+
+    // Snapshot of the global lists; call after every load or activation change while running
+    void SetRules();
+
+    // Spreads samples evenly: exactly one evaluation in 100 / percent
+    bool ShouldSample();
+    // route: the matcher's scan if it has one, reused for the tag tables
+    void Submit(const EuroScopePlugIn::CFlightPlan& fp, const std::unordered_set<std::string>& onlineControllers,
+        const LOAEntry* result, double optimizedUs, LoaRouteWaypoints* route);
+
+    LoaShadowStats GetStats();
+
+private:
+    static const size_t kMaxQueued = 256;
+
+    void WorkLoop();
+    void Check(const LoaShadowSample& sample);
+
+    bool running = false;
+    double percent = 0;
+    double sampleCredit = 0;
+    std::shared_ptr<const LoaReferenceRules> rules;  // the worker never reads the globals a reload replaces
+
+    std::thread worker;
+    std::mutex mutex;  // guards queue, stopping and stats
+    std::condition_variable wake;
+    std::deque<LoaShadowSample> queue;
+    bool stopping = false;
+    LoaShadowStats stats;
+};
+
+extern LoaShadowMatcher loaShadow;
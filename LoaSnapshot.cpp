@@ -0,0 +1,224 @@
+﻿// =========================
+// File: LoaSnapshot.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaSnapshot.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool LoaSnapshotStore::Open(const std::string& filePath)
+{
+    Close();
+    mappedBytes = sizeof(LoaSnapshotHeader) + 2 * LOA_SNAPSHOT_CAPACITY * sizeof(LoaSnapshotRecord);
+
+#ifdef _WIN32
+    HANDLE fileHandle = CreateFileA(filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+        OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+    HANDLE handle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, 0, (DWORD)mappedBytes, nullptr);
+    if (!handle) {
+        CloseHandle(fileHandle);
+        return false;
+    }
+    void* view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, mappedBytes);
+    if (!view) {
+        CloseHandle(handle);
+        CloseHandle(fileHandle);
+        return false;
+    }
+    file = fileHandle;
+    mapping = handle;
+#else
+    int fd = open(filePath.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0) return false;
+    if (ftruncate(fd, (off_t)mappedBytes) != 0) {
+        close(fd);
+        return false;
+    }
+    void* view = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) return false;
+#endif
+
+    header = static_cast<LoaSnapshotHeader*>(view);
+    path = filePath;
+
+    // Nothing to restore from a new file, or one written with another layout
+    bool valid = memcmp(header->magic, "LOASNAP1", 8) == 0 && header->version == 1 &&
+        header->headerSize == sizeof(LoaSnapshotHeader) && header->recordSize == sizeof(LoaSnapshotRecord) &&
+        header->capacity == LOA_SNAPSHOT_CAPACITY;
+    if (!valid) {
+        memset(view, 0, mappedBytes);
+        header = new (view) LoaSnapshotHeader();
+        header->version = 1;
+        header->headerSize = sizeof(LoaSnapshotHeader);
+        header->recordSize = sizeof(LoaSnapshotRecord);
+        header->capacity = LOA_SNAPSHOT_CAPACITY;
+        header->activeTable.store(LOA_SNAPSHOT_NO_TABLE, std::memory_order_relaxed);
+        memcpy(header->magic, "LOASNAP1", 8);
+        Flush(header, sizeof(LoaSnapshotHeader));
+    }
+    uint32_t active = header->activeTable.load(std::memory_order_acquire);
+    restoreTable = active < 2 ? active : LOA_SNAPSHOT_NO_TABLE;
+
+    stopping = false;
+    busy = false;
+    stats = LoaSnapshotStats();
+    worker = std::thread(&LoaSnapshotStore::WorkLoop, this);
+    return true;
+}
+
+void LoaSnapshotStore::Close()
+{
+    if (!header) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    worker.join();
+
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle((HANDLE)mapping);
+    CloseHandle((HANDLE)file);
+#else
+    munmap(header, mappedBytes);
+#endif
+    file = nullptr;
+    mapping = nullptr;
+    header = nullptr;
+    restoreTable = LOA_SNAPSHOT_NO_TABLE;
+}
+
+LoaSnapshotRecord* LoaSnapshotStore::Table(uint32_t table) const
+{
+    LoaSnapshotRecord* first = reinterpret_cast<LoaSnapshotRecord*>(reinterpret_cast<char*>(header) + sizeof(LoaSnapshotHeader));
+    return first + (size_t)table * LOA_SNAPSHOT_CAPACITY;
+}
+
+const LoaSnapshotRecord* LoaSnapshotStore::Find(const std::string& callsign) const
+{
+    if (!header || !IsRestoring() || callsign.size() >= sizeof(LoaSnapshotRecord::callsign)) return nullptr;
+
+    const LoaSnapshotRecord* table = Table(restoreTable);
+    uint32_t slot = LoaSnapshotSlot(callsign.c_str());
+    for (uint32_t probe = 0; probe < LOA_SNAPSHOT_CAPACITY; ++probe) {
+        const LoaSnapshotRecord& record = table[(slot + probe) & (LOA_SNAPSHOT_CAPACITY - 1)];
+        if (!(record.flags & LOA_SNAPSHOT_USED)) return nullptr;
+        if (strncmp(record.callsign, callsign.c_str(), sizeof(record.callsign)) == 0) return &record;
+    }
+    return nullptr;
+}
+
+uint64_t LoaSnapshotStore::RestoreConfigHash() const
+{
+    return IsRestoring() ? header->tables[restoreTable].configHash : 0;
+}
+
+uint64_t LoaSnapshotStore::RestoreSavedUtc() const
+{
+    return IsRestoring() ? header->tables[restoreTable].savedUtc : 0;
+}
+
+bool LoaSnapshotStore::Checkpoint(std::vector<LoaSnapshotRecord> records, uint64_t configHash, uint64_t savedUtc)
+{
+    if (!header) return false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (busy) {
+            stats.skipped++;
+            return false;
+        }
+        // Only the worker flips activeTable, and it is idle
+        uint32_t active = header->activeTable.load(std::memory_order_acquire);
+        jobTable = active == 0 ? 1 : 0;
+        // About to overwrite the table restores read from: the window is over
+        if (jobTable == restoreTable) restoreTable = LOA_SNAPSHOT_NO_TABLE;
+        job = std::move(records);
+        jobConfigHash = configHash;
+        jobSavedUtc = savedUtc;
+        busy = true;
+    }
+    wake.notify_one();
+    return true;
+}
+
+LoaSnapshotStats LoaSnapshotStore::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void LoaSnapshotStore::Flush(const void* address, size_t bytes)
+{
+#ifdef _WIN32
+    FlushViewOfFile(address, bytes);
+#else
+    // msync wants a page-aligned start
+    uintptr_t page = (uintptr_t)sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)address & ~(page - 1);
+    msync((void*)start, bytes + ((uintptr_t)address - start), MS_SYNC);
+#endif
+}
+
+void LoaSnapshotStore::WriteTable(uint32_t table, const std::vector<LoaSnapshotRecord>& records, uint64_t configHash, uint64_t savedUtc)
+{
+    LoaSnapshotRecord* slots = Table(table);
+    memset(slots, 0, LOA_SNAPSHOT_CAPACITY * sizeof(LoaSnapshotRecord));
+
+    // At most half full, so probes stay short; the rest waits for the next checkpoint
+    uint32_t count = 0;
+    for (const auto& record : records) {
+        if (count >= LOA_SNAPSHOT_CAPACITY / 2) break;
+        uint32_t slot = LoaSnapshotSlot(record.callsign);
+        while (slots[slot].flags & LOA_SNAPSHOT_USED) slot = (slot + 1) & (LOA_SNAPSHOT_CAPACITY - 1);
+        slots[slot] = record;
+        slots[slot].flags |= LOA_SNAPSHOT_USED;
+        count++;
+    }
+
+    header->tables[table].configHash = configHash;
+    header->tables[table].savedUtc = savedUtc;
+    header->tables[table].count = count;
+    Flush(slots, LOA_SNAPSHOT_CAPACITY * sizeof(LoaSnapshotRecord));
+
+    // The table is on disk before the header points at it
+    header->activeTable.store(table, std::memory_order_release);
+    Flush(header, sizeof(LoaSnapshotHeader));
+}
+
+void LoaSnapshotStore::WorkLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        wake.wait(lock, [&] { return stopping || busy; });
+        if (!busy) return;  // stopping with nothing left to write
+
+        std::vector<LoaSnapshotRecord> records = std::move(job);
+        uint32_t table = jobTable;
+        uint64_t configHash = jobConfigHash, savedUtc = jobSavedUtc;
+        lock.unlock();
+
+        auto start = std::chrono::steady_clock::now();
+        WriteTable(table, records, configHash, savedUtc);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        lock.lock();
+        busy = false;
+        stats.checkpoints++;
+        stats.lastRecords = (uint32_t)std::min<size_t>(records.size(), LOA_SNAPSHOT_CAPACITY / 2);
+        stats.lastWriteMs = ms;
+    }
+}
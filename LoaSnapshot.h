@@ -0,0 +1,135 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// =============================
+// Warm-cache Snapshot
+// =============================
+// Optional (".loa snapshot on") file next to the DLL, LOAPlugin.snapshot, that
+// carries per-flight results across a crash or restart. While it exists the
+// plugin maps it at startup and checkpoints into it from the timer.
+//
+//   LoaSnapshotHeader            128 bytes, magic "LOASNAP1", version 1
+//   LoaSnapshotRecord[capacity]  table 0, 64 bytes each
+//   LoaSnapshotRecord[capacity]  table 1
+//
+// Records are open-addressed by callsign hash (linear probing, flags == 0 is
+// an empty slot), so a flight is found in place without reading the rest of
+// the file. A checkpoint rewrites the table that is not active on a worker
+// thread, flushes it, then flips activeTable: a crash mid-checkpoint leaves
+// the previous table intact. The table active at startup is the one restored
+// from; it stays readable until the second checkpoint would overwrite it.
+
+const uint32_t LOA_SNAPSHOT_CAPACITY = 4096;  // per table, a power of two
+
+enum LoaSnapshotFlags : uint32_t {
+    LOA_SNAPSHOT_USED = 1,
+    LOA_SNAPSHOT_MATCH = 2,         // ruleId/contextHash hold a match result
+    LOA_SNAPSHOT_COORDINATION = 4   // the exit fields hold coordination states
+};
+
+struct LoaSnapshotRecord {
+    uint64_t routeFingerprint;  // origin, destination and filed route
+    uint64_t contextHash;       // everything else the match read, 0 = was already stale
+    char callsign[12];
+    int32_t ruleId;             // (list << 16) | index, -1 = no rule matched
+    int32_t exitAltitude;       // CoordinationInfo
+    int32_t exitAltitudeState;
+    int32_t exitPointState;
+    uint32_t flags;
+    char exitPoint[16];
+};
+
+struct LoaSnapshotTable {
+    uint64_t configHash;        // loadedConfigHash the rule ids refer to
+    uint64_t savedUtc;          // time() of the checkpoint
+    uint32_t count;
+    uint32_t reserved;
+};
+
+struct LoaSnapshotHeader {
+    char magic[8];              // "LOASNAP1"
+    uint32_t version;           // 1
+    uint32_t headerSize;        // sizeof(LoaSnapshotHeader)
+    uint32_t recordSize;        // sizeof(LoaSnapshotRecord)
+    uint32_t capacity;
+    std::atomic<uint32_t> activeTable;  // 0, 1, or LOA_SNAPSHOT_NO_TABLE before the first checkpoint
+    uint32_t reserved;
+    LoaSnapshotTable tables[2];
+    char padding[128 - 32 - 2 * sizeof(LoaSnapshotTable)];
+};
+
+const uint32_t LOA_SNAPSHOT_NO_TABLE = 0xFFFFFFFF;
+
+static_assert(sizeof(LoaSnapshotRecord) == 64, "LoaSnapshotRecord layout");
+static_assert(sizeof(LoaSnapshotHeader) == 128, "LoaSnapshotHeader layout");
+
+struct LoaSnapshotStats {
+    unsigned long long checkpoints = 0;
+    unsigned long long skipped = 0;     // previous checkpoint still being written
+    uint32_t lastRecords = 0;
+    double lastWriteMs = 0;             // worker time of the last checkpoint
+};
+
+class LoaSnapshotStore {
+public:
+    ~LoaSnapshotStore() { Close(); }
+
+    // Maps the file, creating it if needed; a file of another layout is reset
+    bool Open(const std::string& path);
+    void Close();
+    bool IsOpen() const { return header != nullptr; }
+    const std::string& GetPath() const { return path; }
+
+    // Restore side, UI thread: the record saved for a callsign in the table
+    // that was active at Open, nullptr once that table has been given up
+    bool IsRestoring() const { return restoreTable != LOA_SNAPSHOT_NO_TABLE; }
+    const LoaSnapshotRecord* Find(const std::string& callsign) const;
+    uint64_t RestoreConfigHash() const;
+    uint64_t RestoreSavedUtc() const;
+
+    // Hands the records to the worker; false if the last checkpoint is still
+    // being written (records dropped, try again next time)
+    bool Checkpoint(std::vector<LoaSnapshotRecord> records, uint64_t configHash, uint64_t savedUtc);
+
+    LoaSnapshotStats GetStats();
+
+private:
+    void WorkLoop();
+    void WriteTable(uint32_t table, const std::vector<LoaSnapshotRecord>& records, uint64_t configHash, uint64_t savedUtc);
+    void Flush(const void* address, size_t bytes);
+    LoaSnapshotRecord* Table(uint32_t table) const;
+
+    std::string path;
+    void* file = nullptr;               // HANDLEs on Windows, unused on Linux
+    void* mapping = nullptr;
+    LoaSnapshotHeader* header = nullptr;
+    size_t mappedBytes = 0;
+    uint32_t restoreTable = LOA_SNAPSHOT_NO_TABLE;
+
+    std::thread worker;
+    std::mutex mutex;                   // guards the fields below
+    std::condition_variable wake;
+    bool stopping = false;
+    bool busy = false;                  // a job is queued or being written
+    std::vector<LoaSnapshotRecord> job;
+    uint64_t jobConfigHash = 0;
+    uint64_t jobSavedUtc = 0;
+    uint32_t jobTable = 0;
+    LoaSnapshotStats stats;
+};
+
+// Open-addressing slot of a callsign (FNV-1a)
+inline uint32_t LoaSnapshotSlot(const char* callsign)
+{
+    uint32_t h = 2166136261u;
+    for (const char* c = callsign; *c; ++c) h = (h ^ (unsigned char)*c) * 16777619u;
+    return h & (LOA_SNAPSHOT_CAPACITY - 1);
+}
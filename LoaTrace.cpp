@@ -0,0 +1,301 @@
+﻿// =========================
+// File: LoaTrace.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+LoaTraceWriter loaTrace;
+
+void CopyTraceField(char* dst, size_t size, const char* src)
+{
+    size_t n = src ? strlen(src) : 0;
+    if (n > size) n = size;
+    memcpy(dst, src, n);
+    memset(dst + n, 0, size - n);
+}
+
+std::string ReadTraceField(const char* src, size_t size)
+{
+    size_t n = 0;
+    while (n < size && src[n] != 0) ++n;
+    return std::string(src, n);
+}
+
+// =============================
+// Writer
+// =============================
+
+LoaTraceWriter::~LoaTraceWriter()
+{
+    Stop();
+}
+
+uint64_t LoaTraceWriter::NowUs() const
+{
+    long long ticks = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    return (uint64_t)(ticks - startTicks);
+}
+
+bool LoaTraceWriter::Start(const std::string& tracePath)
+{
+    if (IsRecording()) return false;
+    path = tracePath;
+    used = 0;
+    recordCount = 0;
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+        CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    fileHandle = file;
+#else
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+#endif
+
+    if (!MapTo(kGrowBytes)) {
+        Stop();
+        return false;
+    }
+
+    startTicks = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    LoaTraceFileHeader header;
+    memcpy(header.magic, "LOATRACE", 8);
+    header.version = kLoaTraceVersion;
+    header.headerSize = sizeof(LoaTraceFileHeader);
+    header.startUnixMs = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    memcpy(Reserve(sizeof(header)), &header, sizeof(header));
+    return true;
+}
+
+void LoaTraceWriter::Unmap()
+{
+    if (!base) return;
+#ifdef _WIN32
+    UnmapViewOfFile(base);
+    CloseHandle((HANDLE)mappingHandle);
+    mappingHandle = nullptr;
+#else
+    munmap(base, capacity);
+#endif
+    base = nullptr;
+}
+
+bool LoaTraceWriter::MapTo(size_t newCapacity)
+{
+    Unmap();
+#ifdef _WIN32
+    HANDLE mapping = CreateFileMappingA((HANDLE)fileHandle, NULL, PAGE_READWRITE,
+        (DWORD)((unsigned long long)newCapacity >> 32), (DWORD)(newCapacity & 0xFFFFFFFFull), NULL);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, newCapacity);
+    if (!view) {
+        CloseHandle(mapping);
+        return false;
+    }
+    mappingHandle = mapping;
+#else
+    if (ftruncate(fd, (off_t)newCapacity) != 0) return false;
+    void* view = mmap(nullptr, newCapacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) return false;
+#endif
+    base = (char*)view;
+    capacity = newCapacity;
+    return true;
+}
+
+void LoaTraceWriter::Stop()
+{
+#ifdef _WIN32
+    if (!fileHandle) return;
+    Unmap();
+    LARGE_INTEGER size;
+    size.QuadPart = (LONGLONG)used;
+    SetFilePointerEx((HANDLE)fileHandle, size, NULL, FILE_BEGIN);
+    SetEndOfFile((HANDLE)fileHandle);
+    CloseHandle((HANDLE)fileHandle);
+    fileHandle = nullptr;
+#else
+    if (fd < 0) return;
+    Unmap();
+    if (ftruncate(fd, (off_t)used) != 0) { /* leave the zero tail; readers stop at it */ }
+    close(fd);
+    fd = -1;
+#endif
+    capacity = 0;
+}
+
+char* LoaTraceWriter::Reserve(size_t bytes)
+{
+    if (used + bytes > capacity) {
+        if (!MapTo(capacity + std::max(kGrowBytes, bytes))) {
+            Stop();
+            return nullptr;
+        }
+    }
+    char* p = base + used;
+    used += bytes;
+    return p;
+}
+
+void LoaTraceWriter::WriteFlight(LoaTraceRecordType type, const LoaTraceFlight& flight, const char* routeText,
+    const std::vector<std::string>* routePoints, const int32_t* extra, int extraCount)
+{
+    static const size_t kMaxRouteText = 4096;
+    if (!IsRecording()) return;
+
+    size_t textLength = std::min(strlen(routeText), kMaxRouteText);
+    size_t pointCount = routePoints ? std::min<size_t>(routePoints->size(), 255) : 0;
+    size_t routeBytes = 0;
+    for (size_t i = 0; i < pointCount; ++i)
+        routeBytes += 1 + std::min<size_t>((*routePoints)[i].size(), 255);
+
+    size_t payload = sizeof(LoaTraceFlight) + textLength + routeBytes + extraCount * sizeof(int32_t);
+    if (payload > 0xFFFF) return;
+
+    char* p = Reserve(sizeof(LoaTraceRecordHeader) + payload);
+    if (!p) return;
+
+    LoaTraceRecordHeader header = { (uint8_t)type, 0, (uint16_t)payload, NowUs() };
+    memcpy(p, &header, sizeof(header));
+    p += sizeof(header);
+
+    LoaTraceFlight fixed = flight;
+    fixed.routeTextLength = (uint16_t)textLength;
+    fixed.routePointCount = (uint8_t)pointCount;
+    memcpy(p, &fixed, sizeof(fixed));
+    p += sizeof(fixed);
+    memcpy(p, routeText, textLength);
+    p += textLength;
+
+    for (size_t i = 0; i < pointCount; ++i) {
+        uint8_t len = (uint8_t)std::min<size_t>((*routePoints)[i].size(), 255);
+        *p++ = (char)len;
+        memcpy(p, (*routePoints)[i].data(), len);
+        p += len;
+    }
+    if (extraCount > 0) memcpy(p, extra, extraCount * sizeof(int32_t));
+    recordCount++;
+}
+
+void LoaTraceWriter::WriteController(LoaTraceRecordType type, const LoaTraceController& controller)
+{
+    if (!IsRecording()) return;
+
+    char* p = Reserve(sizeof(LoaTraceRecordHeader) + sizeof(LoaTraceController));
+    if (!p) return;
+
+    LoaTraceRecordHeader header = { (uint8_t)type, 0, (uint16_t)sizeof(LoaTraceController), NowUs() };
+    memcpy(p, &header, sizeof(header));
+    memcpy(p + sizeof(header), &controller, sizeof(controller));
+    recordCount++;
+}
+
+// =============================
+// Reader
+// =============================
+
+bool LoaTraceReader::Open(const std::string& tracePath)
+{
+    std::ifstream in(tracePath, std::ios::binary);
+    if (!in.is_open()) return false;
+    data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+
+    LoaTraceFileHeader header;
+    if (data.size() < sizeof(header)) return false;
+    memcpy(&header, data.data(), sizeof(header));
+    if (memcmp(header.magic, "LOATRACE", 8) != 0 || header.version != kLoaTraceVersion) return false;
+
+    startUnixMs = header.startUnixMs;
+    offset = header.headerSize;
+    return true;
+}
+
+bool LoaTraceReader::Next(LoaTraceRecord& record)
+{
+    LoaTraceRecordHeader header;
+    if (offset + sizeof(header) > data.size()) return false;
+    memcpy(&header, data.data() + offset, sizeof(header));
+    if (header.type == LOA_TRACE_END || offset + sizeof(header) + header.size > data.size()) return false;
+
+    const char* p = data.data() + offset + sizeof(header);
+    const char* end = p + header.size;
+    offset += sizeof(header) + header.size;
+
+    record = LoaTraceRecord();
+    record.type = (LoaTraceRecordType)header.type;
+    record.timestampUs = header.timestampUs;
+
+    if (record.type == LOA_TRACE_CONTROLLER_UPDATE || record.type == LOA_TRACE_CONTROLLER_DISCONNECT) {
+        if (header.size < sizeof(LoaTraceController)) return false;
+        LoaTraceController c;
+        memcpy(&c, p, sizeof(c));
+        record.controllerCallsign = ReadTraceField(c.callsign, sizeof(c.callsign));
+        record.positionId = ReadTraceField(c.positionId, sizeof(c.positionId));
+        record.frequency = c.frequency;
+        return true;
+    }
+
+    if (header.size < sizeof(LoaTraceFlight)) return false;
+    LoaTraceFlight f;
+    memcpy(&f, p, sizeof(f));
+    p += sizeof(f);
+
+    record.callsign = ReadTraceField(f.callsign, sizeof(f.callsign));
+    record.origin = ReadTraceField(f.origin, sizeof(f.origin));
+    record.destination = ReadTraceField(f.destination, sizeof(f.destination));
+    record.trackingController = ReadTraceField(f.trackingController, sizeof(f.trackingController));
+    record.exitPoint = ReadTraceField(f.exitPoint, sizeof(f.exitPoint));
+    record.planType = std::string(1, f.planType ? f.planType : 'I');
+    record.state = f.state;
+    record.exitAltitudeState = f.exitAltitudeState;
+    record.exitPointState = f.exitPointState;
+    record.clearedAltitude = f.clearedAltitude;
+    record.finalAltitude = f.finalAltitude;
+    record.exitAltitude = f.exitAltitude;
+    record.aircraftType = ReadTraceField(f.aircraftType, sizeof(f.aircraftType));
+    record.wakeCategory = f.wakeCategory ? f.wakeCategory : 'M';
+    record.sid = ReadTraceField(f.sid, sizeof(f.sid));
+    record.star = ReadTraceField(f.star, sizeof(f.star));
+    record.squawk = ReadTraceField(f.squawk, sizeof(f.squawk));
+    record.latitude = f.latitude;
+    record.longitude = f.longitude;
+
+    if (p + f.routeTextLength > end) return false;
+    record.route.assign(p, f.routeTextLength);
+    p += f.routeTextLength;
+
+    for (int i = 0; i < f.routePointCount && p < end; ++i) {
+        uint8_t len = (uint8_t)*p++;
+        if (p + len > end) return false;
+        record.routePoints.emplace_back(p, len);
+        p += len;
+    }
+
+    int32_t extra[2] = { 0, 0 };
+    size_t extraBytes = std::min<size_t>((size_t)(end - p), sizeof(extra));
+    memcpy(extra, p, extraBytes);
+    if (record.type == LOA_TRACE_TAG_ITEM) {
+        record.itemCode = extra[0];
+    }
+    else if (record.type == LOA_TRACE_COORDINATION_CHANGE) {
+        record.coordinationType = extra[0];
+        record.newState = extra[1];
+    }
+    return true;
+}
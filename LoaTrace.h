@@ -0,0 +1,197 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// =============================
+// Callback Trace Format (.loatrace)
+// =============================
+// All integers little-endian, structs packed to 1 byte, strings zero-padded
+// (not necessarily zero-terminated).
+//
+//   LoaTraceFileHeader        24 bytes, magic "LOATRACE", version 2
+//   { LoaTraceRecordHeader, payload[header.size] }*
+//
+// A record header with type 0 (or the end of the file) ends the trace; a trace
+// cut short by a crash ends in zero-filled space and loads up to the last
+// complete record. Timestamps are microseconds since recording started.
+//
+// Payloads:
+//   TAG_ITEM             LoaTraceFlight, int32 itemCode
+//   STATE_CHANGE         LoaTraceFlight
+//   COORDINATION_CHANGE  LoaTraceFlight, int32 coordinationType, int32 newState
+//   CONTROLLER_UPDATE    LoaTraceController
+//   CONTROLLER_DISCONNECT LoaTraceController
+//
+// LoaTraceFlight is the fixed part below, then routeTextLength bytes of the
+// filed route text, then routePointCount route point names, each a uint8
+// length and that many bytes. The points are the extracted route the plugin
+// already held for the flight (none if it had not needed one): recording never
+// calls GetExtractedRoute itself, so it does not change what it records.
+//
+// Version 2 added the route text and the fields the flight conditions and the
+// geometric COP read (type, wake category, SID/STAR, squawk, position).
+
+enum LoaTraceRecordType : uint8_t {
+    LOA_TRACE_END = 0,
+    LOA_TRACE_TAG_ITEM = 1,
+    LOA_TRACE_STATE_CHANGE = 2,
+    LOA_TRACE_COORDINATION_CHANGE = 3,
+    LOA_TRACE_CONTROLLER_UPDATE = 4,
+    LOA_TRACE_CONTROLLER_DISCONNECT = 5
+};
+
+const uint32_t kLoaTraceVersion = 2;
+
+#pragma pack(push, 1)
+struct LoaTraceFileHeader {
+    char magic[8];          // "LOATRACE"
+    uint32_t version;       // kLoaTraceVersion
+    uint32_t headerSize;    // sizeof(LoaTraceFileHeader)
+    uint64_t startUnixMs;   // wall clock at start of recording
+};
+
+struct LoaTraceRecordHeader {
+    uint8_t type;           // LoaTraceRecordType
+    uint8_t reserved;
+    uint16_t size;          // payload bytes following this header
+    uint64_t timestampUs;
+};
+
+struct LoaTraceFlight {
+    char callsign[12];
+    char origin[4];
+    char destination[4];
+    char trackingController[4];
+    char exitPoint[12];
+    char planType;
+    int8_t state;
+    int8_t exitAltitudeState;
+    int8_t exitPointState;
+    int32_t clearedAltitude;
+    int32_t finalAltitude;
+    int32_t exitAltitude;
+    char aircraftType[8];
+    char sid[8];
+    char star[8];
+    char squawk[4];
+    char wakeCategory;
+    double latitude;        // correlated target, else the flight plan track
+    double longitude;
+    uint16_t routeTextLength;
+    uint8_t routePointCount;
+};
+
+struct LoaTraceController {
+    char callsign[16];
+    char positionId[8];
+    double frequency;
+};
+#pragma pack(pop)
+
+// One decoded record, as handed to an offline harness
+struct LoaTraceRecord {
+    LoaTraceRecordType type = LOA_TRACE_END;
+    uint64_t timestampUs = 0;
+
+    // Flight records
+    std::string callsign;
+    std::string origin;
+    std::string destination;
+    std::string trackingController;
+    std::string planType;
+    int state = 0;
+    int clearedAltitude = 0;
+    int finalAltitude = 0;
+    int exitAltitude = 0;
+    int exitAltitudeState = 0;
+    std::string exitPoint;
+    int exitPointState = 0;
+    std::string route;
+    std::string aircraftType;
+    char wakeCategory = 'M';
+    std::string sid;
+    std::string star;
+    std::string squawk;
+    double latitude = 0.0;
+    double longitude = 0.0;
+    std::vector<std::string> routePoints;  // empty: the plugin had not extracted the route
+
+    int itemCode = 0;           // TAG_ITEM
+    int coordinationType = 0;   // COORDINATION_CHANGE
+    int newState = 0;           // COORDINATION_CHANGE
+
+    // Controller records
+    std::string controllerCallsign;
+    std::string positionId;
+    double frequency = 0.0;
+};
+
+// =============================
+// LoaTraceWriter
+// =============================
+// Append-only writer over a memory-mapped file: a record is a bounds check and
+// a few memcpys into the mapping. The mapping grows in large steps so remaps
+// stay rare; Stop() trims the file to the bytes actually written.
+class LoaTraceWriter {
+public:
+    ~LoaTraceWriter();
+
+    bool Start(const std::string& path);
+    void Stop();
+    bool IsRecording() const { return base != nullptr; }
+    const std::string& GetPath() const { return path; }
+    uint64_t GetRecordCount() const { return recordCount; }
+    uint64_t GetBytesWritten() const { return used; }
+
+    void WriteFlight(LoaTraceRecordType type, const LoaTraceFlight& flight, const char* routeText,
+        const std::vector<std::string>* routePoints, const int32_t* extra, int extraCount);
+    void WriteController(LoaTraceRecordType type, const LoaTraceController& controller);
+
+private:
+    static const size_t kGrowBytes = 32 * 1024 * 1024;
+
+    char* Reserve(size_t bytes);
+    bool MapTo(size_t newCapacity);
+    void Unmap();
+    uint64_t NowUs() const;
+
+    std::string path;
+    char* base = nullptr;
+    size_t capacity = 0;
+    size_t used = 0;
+    uint64_t recordCount = 0;
+    long long startTicks = 0;
+
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+// =============================
+// LoaTraceReader
+// =============================
+// Loads a whole trace and yields its records in recorded order, so a replay
+// driven by it is deterministic.
+class LoaTraceReader {
+public:
+    bool Open(const std::string& path);
+    bool Next(LoaTraceRecord& record);
+    uint64_t GetStartUnixMs() const { return startUnixMs; }
+
+private:
+    std::vector<char> data;
+    size_t offset = 0;
+    uint64_t startUnixMs = 0;
+};
+
+// Fixed-width field helpers shared by the writer and reader
+void CopyTraceField(char* dst, size_t size, const char* src);
+std::string ReadTraceField(const char* src, size_t size);
+
+extern LoaTraceWriter loaTrace;
@@ -0,0 +1,128 @@
+﻿// =========================
+// File: LoaVisibility.cpp
+// =========================
+
+#include "stdafx.h"
+#include "LoaVisibility.h"
+#include <algorithm>
+#include <cmath>
+
+const ULONGLONG LoaVisibility::kAreaTimeoutMs;
+
+LoaVisibility::~LoaVisibility()
+{
+    for (LoaRadarScreen* screen : screens) screen->Orphan();
+}
+
+void LoaVisibility::Attach(LoaRadarScreen* screen)
+{
+    screens.push_back(screen);
+}
+
+void LoaVisibility::Detach(LoaRadarScreen* screen)
+{
+    screens.erase(std::remove(screens.begin(), screens.end(), screen), screens.end());
+    areas.erase(std::remove_if(areas.begin(), areas.end(), [&](const Area& a) { return a.screen == screen; }), areas.end());
+    inTagPhase = false;
+}
+
+void LoaVisibility::UpdateArea(const LoaRadarScreen* screen, const LoaGeoPoint& leftDown, const LoaGeoPoint& rightUp,
+    ULONGLONG now)
+{
+    auto it = std::find_if(areas.begin(), areas.end(), [&](const Area& a) { return a.screen == screen; });
+    if (it == areas.end()) {
+        areas.push_back(Area());
+        it = areas.end() - 1;
+        it->screen = screen;
+    }
+    it->south = std::min(leftDown.lat, rightUp.lat);
+    it->north = std::max(leftDown.lat, rightUp.lat);
+    it->west = leftDown.lon;
+    it->east = rightUp.lon;
+    it->seenAt = now;
+}
+
+bool LoaVisibility::IsActive(ULONGLONG now) const
+{
+    return enabled && AreaCount(now) > 0;
+}
+
+size_t LoaVisibility::AreaCount(ULONGLONG now) const
+{
+    return (size_t)std::count_if(areas.begin(), areas.end(), [&](const Area& a) { return now - a.seenAt <= kAreaTimeoutMs; });
+}
+
+LoaViewClass LoaVisibility::Classify(const LoaGeoPoint& position, ULONGLONG now) const
+{
+    if (!IsActive(now)) return LOA_VIEW_MARGIN;
+
+    double marginLat = std::max(marginNm, 0.0) / 60.0;
+    for (const Area& a : areas) {
+        if (now - a.seenAt > kAreaTimeoutMs) continue;
+        if (position.lat < a.south - marginLat || position.lat > a.north + marginLat) continue;
+
+        // A nautical mile of longitude shrinks towards the poles
+        double cosLat = std::max(std::cos(position.lat * 3.14159265358979323846 / 180.0), 0.05);
+        double marginLon = std::min(std::max(marginNm, 0.0) / (60.0 * cosLat), 180.0);
+        double west = a.west - marginLon, east = a.east + marginLon;
+        double lon = position.lon;
+        if (a.west <= a.east) {
+            if (lon >= west && lon <= east) return LOA_VIEW_MARGIN;
+        }
+        else if (lon >= west || lon <= east) {
+            return LOA_VIEW_MARGIN;  // display spans the antimeridian
+        }
+    }
+    return LOA_VIEW_CULLED;
+}
+
+LoaViewClass LoaVisibility::Classify(const EuroScopePlugIn::CFlightPlan& fp, bool tagRequest, ULONGLONG now) const
+{
+    if (tagRequest && inTagPhase) return LOA_VIEW_TAG;
+    if (!IsActive(now)) return LOA_VIEW_MARGIN;
+
+    // Correlated target if there is one, else the flight plan track
+    EuroScopePlugIn::CRadarTarget target = fp.GetCorrelatedRadarTarget();
+    EuroScopePlugIn::CPosition p = target.IsValid() ? target.GetPosition().GetPosition() : fp.GetFPTrackPosition();
+    LoaGeoPoint position;
+    position.lat = p.m_Latitude;
+    position.lon = p.m_Longitude;
+    return Classify(position, now);
+}
+
+LoaRadarScreen::LoaRadarScreen(LoaVisibility* visibility)
+    : visibility(visibility)
+{
+    if (visibility) visibility->Attach(this);
+}
+
+LoaRadarScreen::~LoaRadarScreen()
+{
+    if (visibility) visibility->Detach(this);
+}
+
+void LoaRadarScreen::OnRefresh(HDC, int Phase)
+{
+    if (!visibility) return;
+
+    // Scope tags are requested between these two phases, lists after them
+    if (Phase == EuroScopePlugIn::REFRESH_PHASE_BEFORE_TAGS) {
+        EuroScopePlugIn::CPosition leftDown, rightUp;
+        GetDisplayArea(&leftDown, &rightUp);
+        LoaGeoPoint a, b;
+        a.lat = leftDown.m_Latitude;
+        a.lon = leftDown.m_Longitude;
+        b.lat = rightUp.m_Latitude;
+        b.lon = rightUp.m_Longitude;
+        visibility->UpdateArea(this, a, b, GetTickCount64());
+        visibility->SetTagPhase(true);
+    }
+    else if (Phase == EuroScopePlugIn::REFRESH_PHASE_AFTER_TAGS) {
+        visibility->SetTagPhase(false);
+    }
+}
+
+void LoaRadarScreen::OnAsrContentToBeClosed()
+{
+    delete this;
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include "EuroScopePlugIn.h"
+#include "LoaGeometry.h"
+#include <string>
+#include <vector>
+
+// =============================
+// Visibility Culling
+// =============================
+// EuroScope asks for the tags of every flight it draws, on the scope and in
+// its lists, and the background paths (warm-ups, sector and activation
+// events) re-evaluate any flight plan the plugin has seen. A LoaRadarScreen is
+// created for every geo-referenced display; on each refresh it reports the
+// area it shows and brackets the phase in which the scope tags are drawn.
+//
+// A flight is in view when its tag is drawn on the scope or its position lies
+// inside a reported area widened by marginNm. Flights out of view are culled:
+// their queued re-evaluations and warm-ups are dropped, and a list asking for
+// one is answered from its last result until that is culledRefreshMs old.
+// While no display has reported for a few seconds (no ASR open, or culling
+// switched off) every flight is in view, as before.
+
+enum LoaViewClass {
+    LOA_VIEW_TAG = 0,     // tag drawn on the scope
+    LOA_VIEW_MARGIN = 1,  // inside a display area or its margin
+    LOA_VIEW_CULLED = 2,
+    LOA_VIEW_COUNT = 3
+};
+
+class LoaRadarScreen;
+
+class LoaVisibility {
+public:
+    ~LoaVisibility();
+
+    bool enabled = true;             // ".loa cull on|off"
+    double marginNm = 30;            // ".loa cull <nm>"
+    ULONGLONG culledRefreshMs = 30000;
+
+    // Called by the screens
+    void Attach(LoaRadarScreen* screen);
+    void Detach(LoaRadarScreen* screen);
+    void UpdateArea(const LoaRadarScreen* screen, const LoaGeoPoint& leftDown, const LoaGeoPoint& rightUp, ULONGLONG now);
+    void SetTagPhase(bool drawingTags) { inTagPhase = drawingTags; }
+
+    // Enabled and at least one display reported recently
+    bool IsActive(ULONGLONG now) const;
+    bool InTagPhase() const { return inTagPhase; }
+    LoaViewClass Classify(const LoaGeoPoint& position, ULONGLONG now) const;
+    // Scope tags are in view whatever their position; anything else by position
+    LoaViewClass Classify(const EuroScopePlugIn::CFlightPlan& fp, bool tagRequest, ULONGLONG now) const;
+
+    size_t ScreenCount() const { return screens.size(); }
+    size_t AreaCount(ULONGLONG now) const;
+
+private:
+    static const ULONGLONG kAreaTimeoutMs = 5000;  // a display in a background tab stops refreshing
+
+    struct Area {
+        const LoaRadarScreen* screen;
+        double south, west, north, east;  // degrees, as reported (west > east across the antimeridian)
+        ULONGLONG seenAt;
+    };
+    std::vector<LoaRadarScreen*> screens;
+    std::vector<Area> areas;
+    bool inTagPhase = false;
+};
+
+// Companion display: draws nothing, only reports to its LoaVisibility. Owned
+// by EuroScope from OnRadarScreenCreated until OnAsrContentToBeClosed.
+class LoaRadarScreen : public EuroScopePlugIn::CRadarScreen {
+public:
+    explicit LoaRadarScreen(LoaVisibility* visibility);
+    virtual ~LoaRadarScreen();
+
+    virtual void OnRefresh(HDC hDC, int Phase);
+    virtual void OnAsrContentToBeClosed();
+
+    void Orphan() { visibility = nullptr; }  // the tracker went away first
+
+private:
+    LoaVisibility* visibility;
+};
@@ -0,0 +1,1234 @@
+﻿// =========================
+// File: bench/MatcherBench.cpp
+// =========================
+// Per-kernel benchmarks for the LOA matcher, run against the stub SDK.
+
+#include "stdafx.h"
+#include "LOAPlugin.h"
+#include "LoaActivation.h"
+#include "LoaAirways.h"
+#include "LoaCompiled.h"
+#include "LoaDaemon.h"
+#include "LoaExport.h"
+#include "LoaPredicate.h"
+#include "LoaVisibility.h"
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <json.hpp>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <sys/mman.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace {
+
+// The bench stands in for EuroScope, which creates the one plugin instance
+// in EuroScopePlugInInit
+LOAPlugin* const benchPlugin = plugin = new LOAPlugin;
+
+std::string Name(const char* prefix, int i)
+{
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%s%04d", prefix, i);
+    return buf;
+}
+
+// Five-letter fix name, like real ones free of digits ("QAAAB")
+std::string FixName(int i)
+{
+    std::string name = "Q";
+    for (int d = 0; d < 4; ++d, i /= 26) name += (char)('A' + i % 26);
+    return name;
+}
+
+// Route of `length` points, none of which are LOA waypoints except the last
+std::vector<std::string> MakeRoute(int length)
+{
+    std::vector<std::string> route;
+    for (int i = 0; i < length - 1; ++i) route.push_back(Name("RTE", i));
+    route.push_back("LOAWP");
+    return route;
+}
+
+EuroScopePlugIn::StubFlightPlanData& BenchFlight()
+{
+    static EuroScopePlugIn::StubFlightPlanData fp;
+    static bool initialised = false;
+    if (!initialised) {
+        fp.callsign = "BENCH01";
+        fp.origin = "EHAM";
+        fp.destination = "LFPG";
+        fp.clearedAltitude = 25000;
+        fp.finalAltitude = 35000;
+        for (const auto& name : MakeRoute(30)) {
+            fp.routePoints.push_back({ name, {} });
+            fp.route += (fp.route.empty() ? "" : " DCT ") + name;
+        }
+        EuroScopePlugIn::GetStubWorld().flightPlans.push_back(&fp);
+        initialised = true;
+    }
+    return fp;
+}
+
+// `count` entries that fail on waypoints, then the one the bench flight matches
+void FillRuleList(std::vector<LOAEntry>& list, int count)
+{
+    list.clear();
+    for (int i = 0; i < count - 1; ++i) {
+        LOAEntry e;
+        e.destinationAirports = { "LF" };
+        e.destinationAirportPrefixes = { "LF" };
+        e.waypoints = { Name("WP", i) };
+        e.xfl = 240;
+        list.push_back(e);
+    }
+    LOAEntry hit;
+    hit.destinationAirports = { "LFPG" };
+    hit.destinationAirportSet = { "LFPG" };
+    hit.waypoints = { "LOAWP" };
+    hit.xfl = 240;
+    list.push_back(hit);
+}
+
+// Benches that time the matcher itself keep the cross-flight memo out of the way
+struct MemoOff {
+    size_t saved = plugin->matchMemo.GetCapacity();
+    MemoOff() { plugin->matchMemo.Clear(); plugin->matchMemo.SetCapacity(0); }
+    ~MemoOff() { plugin->matchMemo.SetCapacity(saved); }
+};
+
+// 300 flights drawn from the vocabulary of data/BENCH.json
+struct Corpus {
+    std::vector<EuroScopePlugIn::StubFlightPlanData> flights;
+    std::unordered_set<std::string> online;
+};
+
+bool LoadBenchConfig()
+{
+    std::string error;
+    return LoadLOAConfigFile(std::string(LOA_BENCH_DATA_DIR) + "/BENCH.json", error);
+}
+
+Corpus& BenchCorpus()
+{
+    static Corpus corpus;
+    if (!corpus.flights.empty() || !LoadBenchConfig()) return corpus;
+
+    std::vector<std::string> waypoints, airports;
+    for (const auto* list : { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas }) {
+        for (const auto& e : *list) {
+            waypoints.insert(waypoints.end(), e.waypoints.begin(), e.waypoints.end());
+            for (const auto& a : e.originAirports) if (a.size() == 4) airports.push_back(a);
+            for (const auto& a : e.destinationAirports) if (a.size() == 4) airports.push_back(a);
+        }
+    }
+    const char* sectors[] = { "EDYY_J", "EDYY_H", "EBBU_W", "EHAA_E", "LFEE_K", "EGTT_L" };
+    corpus.online = { "EDYY_J", "EBBU_W", "LFEE_K" };
+
+    std::mt19937 rng(2996);
+    auto pick = [&](const std::vector<std::string>& v) { return v[rng() % v.size()]; };
+
+    corpus.flights.resize(300);
+    for (size_t i = 0; i < corpus.flights.size(); ++i) {
+        auto& f = corpus.flights[i];
+        f.callsign = Name("CRP", (int)i);
+        f.origin = pick(airports);
+        f.destination = pick(airports);
+        f.trackingController = sectors[rng() % 6];
+        f.clearedAltitude = 10000 + (int)(rng() % 30) * 1000;
+        f.finalAltitude = 36000;
+        // Filed route: points joined by DCT, or (on two flights in three) by
+        // airways whose intermediate points only the extracted route shows
+        bool airways = rng() % 3 != 0;
+        int length = 10 + (int)(rng() % 10);
+        for (int p = 0; p < length; ++p) {
+            std::string point = (rng() % 4 == 0) ? pick(waypoints) : FixName((int)(rng() % 5000));
+            f.routePoints.push_back({ point, {} });
+            f.route += point;
+            if (p + 1 == length) break;
+            if (airways && rng() % 2 == 0) {
+                f.route += " " + Name("UN", (int)(rng() % 900)) + " ";
+                for (int hidden = (int)(rng() % 3); hidden >= 0; --hidden)
+                    f.routePoints.push_back({ (rng() % 4 == 0) ? pick(waypoints) : FixName((int)(rng() % 5000)), {} });
+            }
+            else {
+                f.route += (p == 0) ? "/N0450F350 DCT " : " DCT ";
+            }
+        }
+    }
+    for (auto& f : corpus.flights) EuroScopePlugIn::GetStubWorld().flightPlans.push_back(&f);
+    return corpus;
+}
+
+// Interpreted and compiled matchers must agree on every corpus flight, and the
+// route text scan must agree with matching on the extracted route alone
+std::string CompareEngines(Corpus& corpus, const LoaCompiledRuleset* compiled)
+{
+    for (auto& f : corpus.flights) {
+        EuroScopePlugIn::CFlightPlan fp(&f);
+        auto match = [&](const LoaCompiledRuleset* ruleset, std::vector<std::string>& deps) {
+            activeCompiledRuleset = ruleset;
+            plugin->matchTimestamps.erase(f.callsign);
+            const LOAEntry* result = MatchLoaEntry(fp, corpus.online);
+            deps = plugin->flightSectorDependencies[f.callsign];
+            return result;
+        };
+
+        std::vector<std::string> interpretedDeps, generatedDeps, extractedDeps;
+        const LOAEntry* interpreted = match(nullptr, interpretedDeps);
+        const LOAEntry* generated = match(compiled, generatedDeps);
+        if (generated != interpreted || generatedDeps != interpretedDeps)
+            return "compiled ruleset disagrees for " + f.callsign;
+
+        std::string routeText;
+        routeText.swap(f.route);
+        const LOAEntry* extracted = match(nullptr, extractedDeps);
+        routeText.swap(f.route);
+        if (extracted != interpreted || extractedDeps != interpretedDeps)
+            return "route text scan disagrees with the extracted route for " + f.callsign;
+    }
+    activeCompiledRuleset = nullptr;
+    return "";
+}
+
+void RunCorpus(benchmark::State& state, bool compiled, bool routeText = true)
+{
+    Corpus& corpus = BenchCorpus();
+    if (corpus.flights.empty() || !LoadBenchConfig()) {
+        state.SkipWithError("cannot load data/BENCH.json");
+        return;
+    }
+    const LoaCompiledRuleset* ruleset = FindCompiledRuleset("BENCH", loadedConfigHash);
+    if (!ruleset) {
+        state.SkipWithError("no compiled ruleset for BENCH");
+        return;
+    }
+    MemoOff memoOff;
+    std::string mismatch = CompareEngines(corpus, ruleset);
+    if (!mismatch.empty()) {
+        state.SkipWithError(mismatch.c_str());
+        return;
+    }
+
+    // Without route text every flight goes through the extracted route, as before
+    // the text scan existed. The route cache is dropped too: on the real SDK the
+    // extraction, not the cache lookup, is the cost being avoided.
+    std::vector<std::string> routeTexts;
+    if (!routeText) for (auto& f : corpus.flights) routeTexts.push_back(std::move(f.route));
+
+    activeCompiledRuleset = compiled ? ruleset : nullptr;
+    unsigned long long extractionsBefore = plugin->stats.routeExtractions;
+    for (auto _ : state) {
+        for (auto& f : corpus.flights) {
+            plugin->matchTimestamps.erase(f.callsign);
+            plugin->routeCache.erase(f.callsign);
+            benchmark::DoNotOptimize(MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus.online));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * corpus.flights.size());
+    state.counters["extracted"] = benchmark::Counter((double)(plugin->stats.routeExtractions - extractionsBefore) /
+        ((double)state.iterations() * corpus.flights.size()));
+    activeCompiledRuleset = nullptr;
+
+    if (!routeText) for (size_t i = 0; i < corpus.flights.size(); ++i) corpus.flights[i].route = std::move(routeTexts[i]);
+}
+
+// Scaffold of the benches that drive the plugin: the corpus and BENCH.json
+// loaded, the memo off and the frame budget unlimited for the run, and every
+// flight the bench touched cleaned up afterwards. With several threads only
+// the first sets up and tears down; the others wait for it at the start of
+// the timed loop.
+class PluginBench : public benchmark::Fixture {
+public:
+    void SetUp(benchmark::State& state) override
+    {
+        if (state.thread_index() != 0) return;
+        corpus = &BenchCorpus();
+        if (corpus->flights.empty() || !LoadBenchConfig()) {
+            state.SkipWithError("cannot load data/BENCH.json");
+            return;
+        }
+        memoOff.reset(new MemoOff);
+        savedBudget = plugin->scheduler.budgetUs;
+        plugin->scheduler.budgetUs = 0;
+    }
+
+    void TearDown(benchmark::State& state) override
+    {
+        if (state.thread_index() != 0 || !memoOff) return;
+        std::string callsign;
+        while (plugin->scheduler.PopNext(callsign)) {}
+        for (auto* list : { &corpus->flights, &flights }) {
+            for (auto& f : *list) {
+                plugin->CleanupCache(f.callsign);
+                plugin->matchTimestamps.erase(f.callsign);
+            }
+        }
+        flights.clear();
+        plugin->scheduler.budgetUs = savedBudget;
+        memoOff.reset();
+    }
+
+protected:
+    // The flight's XFL tag, as EuroScope asks for it while drawing
+    std::string DrawTag(EuroScopePlugIn::StubFlightPlanData& f)
+    {
+        plugin->OnGetTagItem(EuroScopePlugIn::CFlightPlan(&f), EuroScopePlugIn::CRadarTarget(&f),
+            ItemCodes::CUSTOM_TAG_ID, 0, item, &color, &rgb, &fontSize);
+        return item;
+    }
+
+    Corpus* corpus = nullptr;
+    std::vector<EuroScopePlugIn::StubFlightPlanData> flights;  // made up by the bench itself
+
+private:
+    std::unique_ptr<MemoOff> memoOff;
+    int savedBudget = 0;
+    char item[16];
+    int color;
+    COLORREF rgb;
+    double fontSize;
+};
+
+// With the memo on, every flight must get what matching it would: the same
+// entry and sector dependencies, and the same altitude table at every level
+std::string CompareMemo(std::vector<EuroScopePlugIn::StubFlightPlanData>& flights, const std::unordered_set<std::string>& online)
+{
+    struct Reference {
+        const LOAEntry* entry;
+        std::vector<std::string> deps;
+        LoaAltitudeTable<const LOAEntry*> table;
+    };
+    auto match = [&](EuroScopePlugIn::StubFlightPlanData& f) {
+        plugin->matchTimestamps.erase(f.callsign);
+        plugin->altitudeProfiles.erase(f.callsign);
+        Reference r = { MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), online), {}, {} };
+        r.deps = plugin->flightSectorDependencies[f.callsign];
+        r.table = plugin->altitudeProfiles[f.callsign].match;
+        return r;
+    };
+
+    size_t saved = plugin->matchMemo.GetCapacity();
+    plugin->matchMemo.Clear();
+    plugin->matchMemo.SetCapacity(0);
+    std::vector<Reference> expected;
+    for (auto& f : flights) expected.push_back(match(f));
+
+    // Twice: the first pass fills the memo, the second only hits
+    std::string mismatch;
+    plugin->matchMemo.SetCapacity(4096);
+    for (int pass = 0; pass < 2 && mismatch.empty(); ++pass) {
+        for (size_t i = 0; i < flights.size() && mismatch.empty(); ++i) {
+            Reference r = match(flights[i]);
+            bool same = r.entry == expected[i].entry && r.deps == expected[i].deps;
+            for (int altitude = 0; same && altitude <= 50000; altitude += 500)
+                same = r.table.Lookup(altitude) == expected[i].table.Lookup(altitude);
+            if (!same) mismatch = "memo disagrees with matching for " + flights[i].callsign;
+        }
+    }
+    plugin->matchMemo.Clear();
+    plugin->matchMemo.SetCapacity(saved);
+    return mismatch;
+}
+
+} // namespace
+
+static void BM_EqualsIgnoreCase_Equal(benchmark::State& state)
+{
+    std::string a = "RESMI", b = "resmi";
+    for (auto _ : state) benchmark::DoNotOptimize(EqualsIgnoreCase(a, b));
+}
+BENCHMARK(BM_EqualsIgnoreCase_Equal);
+
+static void BM_EqualsIgnoreCase_Mismatch(benchmark::State& state)
+{
+    std::string a = "RESMI", b = "RESNO";
+    for (auto _ : state) benchmark::DoNotOptimize(EqualsIgnoreCase(a, b));
+}
+BENCHMARK(BM_EqualsIgnoreCase_Mismatch);
+
+static void BM_EqualsIgnoreCase_LengthDiffers(benchmark::State& state)
+{
+    std::string a = "RESMI", b = "RES";
+    for (auto _ : state) benchmark::DoNotOptimize(EqualsIgnoreCase(a, b));
+}
+BENCHMARK(BM_EqualsIgnoreCase_LengthDiffers);
+
+// Worst case: not in the exact set, no prefix matches
+static void BM_MatchesAirport(benchmark::State& state)
+{
+    std::unordered_set<std::string> exact = { "EHAM", "EHRD", "EHEH" };
+    std::vector<std::string> prefixes;
+    for (int i = 0; i < state.range(0); ++i) prefixes.push_back(Name("K", i).substr(0, 3));
+    std::string airport = "LFPG";
+    for (auto _ : state) benchmark::DoNotOptimize(plugin->MatchesAirport(exact, prefixes, airport));
+}
+BENCHMARK(BM_MatchesAirport)->Arg(0)->Arg(1)->Arg(4)->Arg(16)->Arg(64);
+
+static void BM_HashVectorOfStrings(benchmark::State& state)
+{
+    std::vector<std::string> vec = MakeRoute((int)state.range(0));
+    for (auto _ : state) benchmark::DoNotOptimize(HashVectorOfStrings(vec));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HashVectorOfStrings)->RangeMultiplier(4)->Range(4, 256);
+
+static void BM_HashSetOfStrings(benchmark::State& state)
+{
+    std::vector<std::string> vec = MakeRoute((int)state.range(0));
+    std::unordered_set<std::string> set(vec.begin(), vec.end());
+    for (auto _ : state) benchmark::DoNotOptimize(HashSetOfStrings(set));
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_HashSetOfStrings)->RangeMultiplier(4)->Range(4, 256);
+
+// Two required waypoints: one at the end of the route, one absent
+static void BM_RouteContainsAllWaypoints(benchmark::State& state)
+{
+    std::vector<std::string> route = MakeRoute((int)state.range(0));
+    std::vector<std::string> waypoints = { "LOAWP", "NOTIN" };
+    for (auto _ : state) benchmark::DoNotOptimize(RouteContainsAllWaypoints(route, waypoints));
+}
+BENCHMARK(BM_RouteContainsAllWaypoints)->RangeMultiplier(2)->Range(8, 128);
+
+// Full cold match (5 s result cache dropped every iteration), hit is the last rule
+static void BM_MatchLoaEntry(benchmark::State& state)
+{
+    EuroScopePlugIn::CFlightPlan fp(&BenchFlight());
+    FillRuleList(destinationLoas, (int)state.range(0));
+    IndexLoaWaypoints();
+    loaPredicates.Compile();
+    std::unordered_set<std::string> online;
+    MemoOff memoOff;
+
+    for (auto _ : state) {
+        plugin->matchTimestamps.clear();
+        benchmark::DoNotOptimize(MatchLoaEntry(fp, online));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+    destinationLoas.clear();
+}
+BENCHMARK(BM_MatchLoaEntry)->RangeMultiplier(10)->Range(10, 10000);
+
+// 300 flights against the 440-rule data/BENCH.json, JSON interpreter vs generated code
+static void BM_MatchCorpus_Interpreted(benchmark::State& state) { RunCorpus(state, false); }
+BENCHMARK(BM_MatchCorpus_Interpreted);
+
+static void BM_MatchCorpus_Compiled(benchmark::State& state) { RunCorpus(state, true); }
+BENCHMARK(BM_MatchCorpus_Compiled);
+
+// Same corpus with the route text withheld, so every flight needs GetExtractedRoute
+static void BM_MatchCorpus_ExtractedRoute(benchmark::State& state) { RunCorpus(state, false, false); }
+BENCHMARK(BM_MatchCorpus_ExtractedRoute);
+
+// One refresh drawing every corpus tag right after all their matches expired,
+// unbudgeted (0) and with a 2 ms frame budget
+BENCHMARK_DEFINE_F(PluginBench, BM_ExpiredFrame)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    plugin->scheduler.budgetUs = (int)state.range(0);
+    std::string callsign;
+
+    // Every tag has been drawn before: there is a last result to fall back on
+    for (auto& f : corpus->flights) MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus->online);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        plugin->matchTimestamps.clear();
+        while (plugin->scheduler.PopNext(callsign)) {}
+        state.ResumeTiming();
+
+        plugin->scheduler.BeginFrame(true);
+        for (auto& f : corpus->flights)
+            benchmark::DoNotOptimize(plugin->GetScheduledMatch(EuroScopePlugIn::CFlightPlan(&f)));
+    }
+    state.counters["deferred"] = (double)plugin->scheduler.QueueDepth();
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_ExpiredFrame)->Arg(0)->Arg(2000);
+
+// Every corpus flight changing level once: re-matched from scratch (0) or read
+// from the altitude table its previous match left behind (1)
+BENCHMARK_DEFINE_F(PluginBench, BM_LevelChange)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    bool lookup = state.range(0) != 0;
+    for (auto& f : corpus->flights) {
+        plugin->matchTimestamps.erase(f.callsign);
+        MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus->online);
+    }
+
+    std::vector<int> savedAltitudes;
+    for (auto& f : corpus->flights) savedAltitudes.push_back(f.clearedAltitude);
+    int step = 0;
+
+    for (auto _ : state) {
+        step = (step + 1) % 30;
+        for (auto& f : corpus->flights) {
+            EuroScopePlugIn::CFlightPlan fp(&f);
+            f.clearedAltitude = 10000 + step * 1000;
+            if (!lookup) plugin->altitudeProfiles[f.callsign].match.Reset();
+            plugin->OnFlightPlanControllerAssignedDataUpdate(fp, EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE);
+            benchmark::DoNotOptimize(MatchLoaEntry(fp, corpus->online));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * corpus->flights.size());
+
+    for (size_t i = 0; i < corpus->flights.size(); ++i) corpus->flights[i].clearedAltitude = savedAltitudes[i];
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_LevelChange)->Arg(0)->Arg(1);
+
+// 300 flights filing only 30 distinct city pair/route texts, every match
+// expired: memo off (0) and on (4096 entries). Half of them were assigned a SID
+// that replaces the filed route with a direct, so the same text stands for two
+// extracted routes. Memo results are checked against plain matching first.
+BENCHMARK_DEFINE_F(PluginBench, BM_RepeatedPairings)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    flights.resize(corpus->flights.size());
+    for (size_t i = 0; i < flights.size(); ++i) {
+        flights[i] = corpus->flights[i % 30];
+        flights[i].callsign = ::Name("SHT", (int)i);
+        if (i >= flights.size() / 2 && flights[i].routePoints.size() > 2) {
+            flights[i].sid = "BENCH1A";
+            flights[i].routePoints.erase(flights[i].routePoints.begin() + 1, flights[i].routePoints.end() - 1);
+        }
+    }
+    std::string mismatch = CompareMemo(flights, corpus->online);
+    if (!mismatch.empty()) {
+        state.SkipWithError(mismatch.c_str());
+        return;
+    }
+
+    plugin->matchMemo.SetCapacity((size_t)state.range(0));
+    LoaMemoStats before = plugin->matchMemo.stats;
+    for (auto _ : state) {
+        for (auto& f : flights) {
+            plugin->matchTimestamps.erase(f.callsign);
+            plugin->routeCache.erase(f.callsign);
+            benchmark::DoNotOptimize(MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus->online));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * flights.size());
+    unsigned long long hits = plugin->matchMemo.stats.hits - before.hits;
+    unsigned long long lookups = hits + plugin->matchMemo.stats.misses - before.misses;
+    state.counters["hit_rate"] = lookups ? (double)hits / lookups : 0.0;
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_RepeatedPairings)->Arg(0)->Arg(4096);
+
+// Handover burst: every corpus flight becomes notified and draws its first XFL
+// tag, cold (0) or after the timer warmed it up (1, warm-up not timed)
+BENCHMARK_DEFINE_F(PluginBench, BM_FirstRender)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    bool warm = state.range(0) != 0;
+    std::vector<int> savedStates;
+    for (auto& f : corpus->flights) savedStates.push_back(f.state);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (auto& f : corpus->flights) {
+            plugin->CleanupCache(f.callsign);
+            plugin->matchTimestamps.erase(f.callsign);
+            f.state = FLIGHT_PLAN_STATE_NOTIFIED;
+            if (warm) plugin->OnFlightPlanStateChange(EuroScopePlugIn::CFlightPlan(&f));
+        }
+        plugin->scheduler.BeginFrame(true);
+        plugin->RunScheduledEvaluations(true);
+        state.ResumeTiming();
+
+        for (auto& f : corpus->flights) DrawTag(f);
+    }
+    state.SetItemsProcessed(state.iterations() * corpus->flights.size());
+    unsigned long long renders = plugin->stats.firstRenderHits + plugin->stats.firstRenderMisses;
+    state.counters["hit_rate"] = renders ? (double)plugin->stats.firstRenderHits / renders : 0.0;
+
+    for (size_t i = 0; i < corpus->flights.size(); ++i) corpus->flights[i].state = savedStates[i];
+    plugin->stats.firstRenderHits = plugin->stats.firstRenderMisses = 0;
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_FirstRender)->Arg(0)->Arg(1);
+
+// First frame after a restart, 300 flights: everything evaluated cold (0) or
+// the matches and coordination states restored from a snapshot (1). A restored
+// frame must draw the tags the session before it drew.
+BENCHMARK_DEFINE_F(PluginBench, BM_Restart)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    bool restore = state.range(0) != 0;
+    const char* path = "LOAPluginBench.snapshot";
+    auto restart = [&]() {
+        for (auto& f : corpus->flights) {
+            plugin->CleanupCache(f.callsign);
+            plugin->matchTimestamps.erase(f.callsign);
+        }
+        plugin->coordinationStates.clear();
+        plugin->snapshotProbed.clear();
+    };
+
+    // The session before the restart, checkpointed once
+    std::vector<EuroScopePlugIn::StubFlightPlanData*> savedWorld = EuroScopePlugIn::GetStubWorld().flightPlans;
+    for (auto& f : corpus->flights) EuroScopePlugIn::GetStubWorld().flightPlans.push_back(&f);
+    if (restore) {
+        std::remove(path);
+        std::vector<std::string> before;
+        for (auto& f : corpus->flights) before.push_back(DrawTag(f));
+        plugin->snapshot.Open(path);
+        plugin->CheckpointSnapshot();
+        while (plugin->snapshot.GetStats().checkpoints == 0) std::this_thread::yield();
+        plugin->snapshot.Close();
+        plugin->snapshot.Open(path);  // restoring from here on
+
+        restart();
+        for (size_t i = 0; i < corpus->flights.size(); ++i) {
+            if (DrawTag(corpus->flights[i]) != before[i]) {
+                state.SkipWithError(("restored tag differs for " + corpus->flights[i].callsign).c_str());
+                break;
+            }
+        }
+    }
+
+    unsigned long long freshBefore = plugin->stats.snapshotFresh;
+    for (auto _ : state) {
+        state.PauseTiming();
+        restart();
+        state.ResumeTiming();
+
+        for (auto& f : corpus->flights) DrawTag(f);
+    }
+    state.SetItemsProcessed(state.iterations() * corpus->flights.size());
+    state.counters["restored"] = (double)(plugin->stats.snapshotFresh - freshBefore) / state.iterations();
+
+    plugin->snapshot.Close();
+    std::remove(path);
+    EuroScopePlugIn::GetStubWorld().flightPlans = savedWorld;
+    plugin->stats.snapshotFresh = plugin->stats.snapshotStale = plugin->stats.snapshotCoordinations = 0;
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_Restart)->Arg(0)->Arg(1);
+
+// 300 flights crossing a 64-vertex sector boundary with 40 published COPs:
+// every exit recomputed (0) or reused because no route changed (1)
+BENCHMARK_DEFINE_F(PluginBench, BM_SectorExit)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    std::vector<std::vector<LoaGeoPoint>> boundary(1);
+    std::vector<LoaNamedPoint> cops;
+    for (int i = 0; i < 64; ++i) {
+        double a = i * 2 * 3.14159265358979 / 64, r = 1.5 + 0.3 * std::sin(5 * a);
+        LoaGeoPoint p;
+        p.lat = 52 + r * std::sin(a);
+        p.lon = 6 + r * 1.6 * std::cos(a);
+        boundary[0].push_back(p);
+        if (i % 2 == 0 && cops.size() < 40) cops.push_back({ ::Name("COP", i), p });
+    }
+    loaGeometry.Build(boundary, cops);
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> jitter(-0.4, 0.4);
+    flights.resize(300);
+    for (size_t i = 0; i < flights.size(); ++i) {
+        auto& f = flights[i];
+        f.callsign = ::Name("GEO", (int)i);
+        double heading = i * 0.37;
+        for (int p = 0; p < 20; ++p) {
+            EuroScopePlugIn::CPosition pos;
+            pos.m_Latitude = 52 + (p - 6) * 0.25 * std::sin(heading) + jitter(rng);
+            pos.m_Longitude = 6 + (p - 6) * 0.4 * std::cos(heading) + jitter(rng);
+            f.routePoints.push_back({ ::Name("PT", p), pos });
+            f.route += (f.route.empty() ? "" : " DCT ") + ::Name("PT", p);
+        }
+        f.position = f.routePoints[2].position;
+    }
+
+    bool reuse = state.range(0) != 0;
+    int found = 0;
+    for (auto _ : state) {
+        if (!reuse) plugin->exitEstimates.clear();
+        found = 0;
+        for (auto& f : flights) found += plugin->GetGeometricCop(EuroScopePlugIn::CFlightPlan(&f)) != nullptr;
+    }
+    state.SetItemsProcessed(state.iterations() * flights.size());
+    state.counters["with_cop"] = found;
+
+    // Reused exits must be the ones a fresh computation finds, and a flight
+    // moving on to a later route point must be recomputed
+    if (reuse) {
+        std::vector<std::string> reused;
+        for (auto& f : flights) {
+            const std::string* cop = plugin->GetGeometricCop(EuroScopePlugIn::CFlightPlan(&f));
+            reused.push_back(cop ? *cop : "-");
+        }
+        plugin->exitEstimates.clear();
+        for (size_t i = 0; i < flights.size(); ++i) {
+            const std::string* cop = plugin->GetGeometricCop(EuroScopePlugIn::CFlightPlan(&flights[i]));
+            if ((cop ? *cop : "-") != reused[i]) {
+                state.SkipWithError(("reused exit differs for " + flights[i].callsign).c_str());
+                break;
+            }
+        }
+        unsigned long long computed = plugin->stats.exitEstimates;
+        for (auto& f : flights) {
+            f.position = f.routePoints[12].position;
+            plugin->GetGeometricCop(EuroScopePlugIn::CFlightPlan(&f));
+        }
+        if (plugin->stats.exitEstimates - computed != flights.size()) state.SkipWithError("moved flights reused their exits");
+    }
+
+    loaGeometry.Clear();
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_SectorExit)->Arg(0)->Arg(1);
+
+// 30x30 grid of fixes joined by east-west airways UH<row> and north-south
+// airways UV<column>, written to a sector file (half the segments by name,
+// half by coordinates). 300 flights file two airway segments and a DCT leg
+// from a small set of entry rows, so segments repeat across flights the way
+// published routes do.
+struct AirwayCorpus {
+    std::vector<EuroScopePlugIn::StubFlightPlanData> flights;
+};
+
+std::string GridFix(int row, int column)
+{
+    std::string name = "W";
+    name += (char)('A' + row % 26);
+    name += (char)('A' + row / 26);
+    name += (char)('A' + column % 26);
+    name += (char)('A' + column / 26);
+    return name;
+}
+
+AirwayCorpus& BenchAirways(const char* path)
+{
+    static AirwayCorpus corpus;
+    const int size = 30;
+    auto coordinate = [](double value, const char* hemispheres) {
+        char buf[32];
+        double a = std::fabs(value);
+        int degrees = (int)a, minutes = (int)((a - degrees) * 60);
+        double seconds = ((a - degrees) * 60 - minutes) * 60;
+        snprintf(buf, sizeof(buf), "%c%03d.%02d.%06.3f", value < 0 ? hemispheres[1] : hemispheres[0], degrees, minutes, seconds);
+        return std::string(buf);
+    };
+    auto lat = [](int row) { return 45 + row * 0.25; };
+    auto lon = [](int column) { return 1 + column * 0.25; };
+
+    FILE* f = fopen(path, "w");
+    if (!f) {
+        corpus.flights.clear();
+        return corpus;
+    }
+    fprintf(f, "[VOR]\n[FIXES]\n");
+    for (int r = 0; r < size; ++r)
+        for (int c = 0; c < size; ++c)
+            fprintf(f, "%s %s %s\n", GridFix(r, c).c_str(), coordinate(lat(r), "NS").c_str(), coordinate(lon(c), "EW").c_str());
+    fprintf(f, "[HIGH AIRWAY]\n");
+    auto segment = [&](const std::string& airway, int r1, int c1, int r2, int c2, bool byName) {
+        if (byName) {
+            fprintf(f, "%s %s %s %s %s\n", airway.c_str(), GridFix(r1, c1).c_str(), GridFix(r1, c1).c_str(),
+                GridFix(r2, c2).c_str(), GridFix(r2, c2).c_str());
+        }
+        else {
+            fprintf(f, "%s %s %s %s %s\n", airway.c_str(), coordinate(lat(r1), "NS").c_str(), coordinate(lon(c1), "EW").c_str(),
+                coordinate(lat(r2), "NS").c_str(), coordinate(lon(c2), "EW").c_str());
+        }
+    };
+    for (int r = 0; r < size; ++r)
+        for (int c = 0; c + 1 < size; ++c) segment("UH" + std::to_string(r), r, c, r, c + 1, c % 2 == 0);
+    for (int c = 0; c < size; ++c)
+        for (int r = 0; r + 1 < size; ++r) segment("UV" + std::to_string(c), r, c, r + 1, c, r % 2 == 1);
+    fclose(f);
+    if (!corpus.flights.empty()) return corpus;
+
+    std::mt19937 rng(47);
+    corpus.flights.resize(300);
+    for (size_t i = 0; i < corpus.flights.size(); ++i) {
+        auto& fp = corpus.flights[i];
+        fp.callsign = Name("AWY", (int)i);
+        fp.origin = "EHAM";
+        fp.destination = "LFPG";
+        int r0 = (int)(rng() % 6) * 5, c0 = (int)(rng() % 3), c1 = 20 + (int)(rng() % 8), r1 = (r0 + 1 + (int)(rng() % (size - 1))) % size;
+        int r2 = (int)(rng() % size), c2 = (int)(rng() % size);
+        fp.route = "N0450F350 " + GridFix(r0, c0) + " UH" + std::to_string(r0) + " " + GridFix(r0, c1) + "/N0440F360 UV" +
+            std::to_string(c1) + " " + GridFix(r1, c1) + " DCT " + GridFix(r2, c2);
+
+        fp.routePoints.push_back({ fp.origin, {} });
+        for (int c = c0; c <= c1; ++c) fp.routePoints.push_back({ GridFix(r0, c), {} });
+        for (int r = r0; r != r1;) {
+            r += r1 > r0 ? 1 : -1;
+            fp.routePoints.push_back({ GridFix(r, c1), {} });
+        }
+        fp.routePoints.push_back({ GridFix(r2, c2), {} });
+        fp.routePoints.push_back({ fp.destination, {} });
+    }
+    return corpus;
+}
+
+// Route preparation for the 300 airway flights: every segment searched in
+// the graph (0) or taken from the segment cache (1). Before timing, each
+// native expansion is checked against the extracted route.
+BENCHMARK_DEFINE_F(PluginBench, BM_RouteExpansion)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    const char* path = "LOAPluginBench.sct";
+    AirwayCorpus& airways = BenchAirways(path);
+    std::string error;
+    if (airways.flights.empty() || !loaAirways.Load(path, error)) {
+        state.SkipWithError(("cannot load airways: " + error).c_str());
+        return;
+    }
+    std::remove(path);
+
+    std::vector<std::string> points;
+    for (auto& f : airways.flights) {
+        std::vector<std::string> extracted;
+        for (const auto& p : f.routePoints) extracted.push_back(p.name);
+        if (!loaAirways.ExpandRoute(f.route.c_str(), f.origin, f.destination, points) || points != extracted) {
+            state.SkipWithError(("native expansion differs from the extracted route for " + f.callsign).c_str());
+            loaAirways.Clear();
+            return;
+        }
+    }
+
+    bool warm = state.range(0) != 0;
+    size_t totalPoints = 0;
+    for (auto _ : state) {
+        if (!warm) loaAirways.ClearSegmentCache();
+        for (auto& f : airways.flights) {
+            loaAirways.ExpandRoute(f.route.c_str(), f.origin, f.destination, points);
+            totalPoints += points.size();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * airways.flights.size());
+    state.counters["points"] = (double)totalPoints / ((double)state.iterations() * airways.flights.size());
+    state.counters["segments"] = (double)loaAirways.GetSegmentStats().cached;
+    loaAirways.Clear();
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_RouteExpansion)->Arg(0)->Arg(1);
+
+// The corpus through loa_daemon over its Unix socket, `range(0)` flights per
+// batch, one client connection per benchmark thread. The daemon's answers are
+// checked first: rule and next sector against MatchLoaEntry, XFL and COP
+// against the tags as the result export reads them. flights_per_core_s divides
+// by the CPU time the daemon's connection threads spent on the batches.
+BENCHMARK_DEFINE_F(PluginBench, BM_DaemonThroughput)(benchmark::State& state)
+{
+    static const char* socketPath = "loa_bench_daemon.sock";
+    static LoaDaemonServer server;
+    static LoaDaemonRequest corpusRequest;
+    static std::string setupError;
+    static std::once_flag setup;
+    std::call_once(setup, [] {
+        Corpus& corpus = BenchCorpus();
+        std::string error;
+        auto ruleset = corpus.flights.empty() ? nullptr
+            : LoadLoaDaemonRuleset({ std::string(LOA_BENCH_DATA_DIR) + "/BENCH.json" }, LoaUtcNow(), error);
+        if (!ruleset || !LoadBenchConfig()) {
+            setupError = "cannot load data/BENCH.json";
+            return;
+        }
+
+        corpusRequest.onlineSectors.assign(corpus.online.begin(), corpus.online.end());
+        for (size_t i = 0; i < corpus.flights.size(); ++i) {
+            const auto& f = corpus.flights[i];
+            LoaDaemonFlight flight;
+            flight.id = (uint32_t)i;
+            flight.clearedAltitude = f.clearedAltitude;
+            flight.finalAltitude = f.finalAltitude;
+            flight.origin = f.origin;
+            flight.destination = f.destination;
+            flight.controller = f.trackingController;
+            flight.aircraftType = f.aircraftType;
+            flight.wake = std::string(1, f.wtc);
+            flight.sid = f.sid;
+            flight.star = f.star;
+            flight.squawk = f.squawk;
+            flight.hasPositions = true;
+            flight.position.lat = f.position.m_Latitude;
+            flight.position.lon = f.position.m_Longitude;
+            for (const auto& point : f.routePoints) {
+                flight.routePoints.push_back(point.name);
+                LoaGeoPoint p;
+                p.lat = point.position.m_Latitude;
+                p.lon = point.position.m_Longitude;
+                flight.routePositions.push_back(p);
+            }
+            corpusRequest.flights.push_back(flight);
+        }
+
+        LoaDaemonResponse response;
+        EvaluateLoaDaemonBatch(*ruleset, LoaSectorGeometry(*ruleset->geometry), corpusRequest, response);
+        for (size_t i = 0; i < corpus.flights.size() && setupError.empty(); ++i) {
+            auto& f = corpus.flights[i];
+            EuroScopePlugIn::CFlightPlan fp(&f);
+            plugin->matchTimestamps.erase(f.callsign);
+            const LOAEntry* entry = MatchLoaEntry(fp, corpus.online);
+            LoaMatchRef ref = LocateLoaEntry(entry);
+            const std::string* next = entry ? FirstOnlineNextSector(*entry, corpus.online) : nullptr;
+
+            CachedTagData tag = { f.callsign, f.clearedAltitude, f.finalAltitude, f.origin, f.destination };
+            LoaRouteWaypoints route;
+            route.Reset(fp);
+            const LoaFlightProfile& profile = plugin->GetAltitudeProfile(fp, tag, corpus.online, route);
+            int xfl = atoi(profile.xfl.Lookup(f.clearedAltitude).c_str());
+            std::string cop = profile.cop.Lookup(f.clearedAltitude);
+            const std::string* derived = cop == "COPX" ? plugin->GetGeometricCop(fp) : nullptr;
+            if (derived) cop = *derived;
+
+            const LoaDaemonResult& r = response.results[i];
+            if (r.ruleId != (ref.list == LOA_LIST_NONE ? -1 : (ref.list << 16) | ref.index) ||
+                r.nextSector != (next ? *next : "") || r.xfl != xfl || r.cop != cop)
+                setupError = "daemon disagrees with the plugin for " + f.callsign;
+        }
+        if (setupError.empty() && !server.Start(socketPath, ruleset, error)) setupError = error;
+    });
+    if (!setupError.empty()) {
+        state.SkipWithError(setupError.c_str());
+        return;
+    }
+
+    LoaDaemonRequest batch;
+    batch.onlineSectors = corpusRequest.onlineSectors;
+    size_t size = std::min<size_t>((size_t)state.range(0), corpusRequest.flights.size());
+    batch.flights.assign(corpusRequest.flights.begin(), corpusRequest.flights.begin() + size);
+
+    LoaDaemonClient client;
+    std::string error;
+    if (!client.Connect(socketPath, error)) {
+        state.SkipWithError(error.c_str());
+        return;
+    }
+    LoaDaemonStats before = server.GetStats();
+    LoaDaemonResponse response;
+    for (auto _ : state) {
+        if (!client.Evaluate(batch, response)) {
+            state.SkipWithError("daemon connection lost");
+            break;
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * batch.flights.size());
+
+    // Every thread has finished its batches here; one of them reports for all
+    if (state.thread_index() == 0) {
+        LoaDaemonStats after = server.GetStats();
+        double cpu = after.busyCpuSeconds - before.busyCpuSeconds;
+        state.counters["flights_per_core_s"] = cpu > 0 ? (after.flights - before.flights) / cpu : 0;
+    }
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_DaemonThroughput)->Arg(16)->Arg(300)->Threads(1)->Threads(4)->UseRealTime();
+
+// A sector coming online re-queues all 300 corpus flights, spread over a
+// 10 x 7.5 degree grid; the timer drains the queue and one refresh draws the
+// tags of the flights on screen. No display reporting (0): every flight is
+// re-evaluated. A companion display showing about a sixth of them with the
+// 30 nm margin (1): only those, the rest wait for a list to ask. The tags on
+// screen must read the same either way.
+BENCHMARK_DEFINE_F(PluginBench, BM_VisibilityCulling)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    std::vector<EuroScopePlugIn::CPosition> savedPositions;
+    for (size_t i = 0; i < corpus->flights.size(); ++i) {
+        savedPositions.push_back(corpus->flights[i].position);
+        corpus->flights[i].position.m_Latitude = 48 + (i % 20) * 0.5;
+        corpus->flights[i].position.m_Longitude = (i / 20) * 0.5;
+    }
+    EuroScopePlugIn::StubWorld& world = EuroScopePlugIn::GetStubWorld();
+    world.displayLeftDown.m_Latitude = 50;
+    world.displayLeftDown.m_Longitude = 2;
+    world.displayRightUp.m_Latitude = 52;
+    world.displayRightUp.m_Longitude = 4;
+    auto onScreen = [&](const EuroScopePlugIn::StubFlightPlanData& f) {
+        return f.position.m_Latitude >= 50 && f.position.m_Latitude <= 52 && f.position.m_Longitude >= 2 && f.position.m_Longitude <= 4;
+    };
+
+    auto requeue = [&]() {
+        for (auto& f : corpus->flights) {
+            plugin->matchTimestamps.erase(f.callsign);
+            plugin->renderedFlights.insert(f.callsign);
+            plugin->scheduler.Request(f.callsign, LOA_URGENCY_ROUTINE);
+        }
+    };
+    std::vector<std::string> tags;
+    auto frame = [&](LoaRadarScreen* screen) {
+        tags.clear();
+        if (screen) screen->OnRefresh(nullptr, EuroScopePlugIn::REFRESH_PHASE_BEFORE_TAGS);
+        plugin->scheduler.BeginFrame(true);
+        plugin->RunScheduledEvaluations(true);
+        for (auto& f : corpus->flights)
+            if (onScreen(f)) tags.push_back(DrawTag(f));
+        if (screen) screen->OnRefresh(nullptr, EuroScopePlugIn::REFRESH_PHASE_AFTER_TAGS);
+    };
+
+    LoaRadarScreen* screen = state.range(0) ? new LoaRadarScreen(&plugin->visibility) : nullptr;
+    if (screen) {
+        requeue();
+        frame(nullptr);
+        std::vector<std::string> unculled = tags;
+        requeue();
+        frame(screen);
+        if (tags != unculled) state.SkipWithError("culling changed a tag on screen");
+    }
+
+    LOAPluginStats before = plugin->stats;
+    for (auto _ : state) {
+        state.PauseTiming();
+        requeue();
+        state.ResumeTiming();
+
+        frame(screen);
+    }
+    double iterations = (double)state.iterations();
+    state.counters["in_view"] = (plugin->stats.evaluationsInView - before.evaluationsInView) / iterations;
+    state.counters["culled"] = (plugin->stats.evaluationsCulled - before.evaluationsCulled) / iterations;
+    state.counters["dropped"] = (plugin->stats.culledDropped - before.culledDropped) / iterations;
+
+    delete screen;
+    for (size_t i = 0; i < corpus->flights.size(); ++i) corpus->flights[i].position = savedPositions[i];
+    plugin->currentFrameView = LOA_VIEW_MARGIN;
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_VisibilityCulling)->Arg(0)->Arg(1);
+
+// Bandbox of two sector files cut from data/BENCH.json: A holds the first two
+// thirds of every list, B the last two thirds, so the middle third is in both.
+// Merged in that order the ruleset must match every corpus flight as the full
+// file does, with at least the overlap dropped as duplicates. Times the merge.
+BENCHMARK_DEFINE_F(PluginBench, BM_BandboxMerge)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    auto describe = [](const LOAEntry* e) {
+        if (!e) return std::string("-");
+        std::string d = std::to_string(e->xfl) + "/" + e->copText + "/" + std::to_string(e->minAltitudeFt);
+        for (const auto* list : { &e->originAirports, &e->destinationAirports, &e->waypoints, &e->nextSectors })
+            for (const auto& s : *list) d += "," + s;
+        return d;
+    };
+    auto matchAll = [&]() {
+        std::vector<std::string> results;
+        for (auto& f : corpus->flights) {
+            plugin->matchTimestamps.erase(f.callsign);
+            results.push_back(describe(MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus->online)));
+        }
+        return results;
+    };
+    std::vector<std::string> expected = matchAll();
+
+    std::ifstream in(std::string(LOA_BENCH_DATA_DIR) + "/BENCH.json");
+    nlohmann::json full = nlohmann::json::parse(in), a = full, b = full;
+    size_t overlap = 0;
+    for (const char* key : { "destinationLoas", "departureLoas", "lorArrivals", "lorDepartures", "fallbackLoas" }) {
+        if (!full.contains(key)) continue;
+        size_t n = full[key].size();
+        a[key] = nlohmann::json::array();
+        b[key] = nlohmann::json::array();
+        for (size_t i = 0; i < n; ++i) {
+            if (i < n * 2 / 3) a[key].push_back(full[key][i]);
+            if (i >= n / 3) b[key].push_back(full[key][i]);
+        }
+        overlap += n * 2 / 3 - n / 3;
+    }
+    const std::vector<std::string> paths = { "LOAPluginBenchA.json", "LOAPluginBenchB.json" };
+    std::ofstream(paths[0]) << a.dump();
+    std::ofstream(paths[1]) << b.dump();
+    const std::vector<std::string> sectors = { "BENCHA", "BENCHB" };
+
+    std::string error;
+    LoaMergeReport report;
+    if (!LoadLOAConfigFiles(paths, sectors, error, &report)) {
+        state.SkipWithError(error.c_str());
+    }
+    else if (report.duplicates < overlap) {
+        state.SkipWithError("overlapping rules were not dropped");
+    }
+    else if (matchAll() != expected) {
+        state.SkipWithError("merged bandbox matches differently from the full file");
+    }
+
+    for (auto _ : state) {
+        if (!LoadLOAConfigFiles(paths, sectors, error, &report)) break;
+    }
+    state.counters["rules"] = (double)report.rules;
+    state.counters["duplicates"] = (double)report.duplicates;
+    state.counters["merged"] = (double)(destinationLoas.size() + departureLoas.size() + lorArrivals.size() +
+        lorDepartures.size() + fallbackLoas.size());
+
+    for (const auto& path : paths) std::remove(path.c_str());
+    LoadBenchConfig();
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_BandboxMerge);
+
+// 300 rules with random UTC windows, a third of them also behind one of two
+// named conditions, followed over 20,000 clock steps of one minute to three
+// days with the conditions toggled on the way. After every step each rule's
+// active flag must be what LoaRuleActiveAt says for that minute. Times the
+// timer's Advance over a simulated day, minute by minute. Afterwards one flight
+// per altitude-bound fallback is matched below that fallback's minimum, the
+// fallbacks are switched off, and every flight's climb must then read what a
+// fresh match would.
+BENCHMARK_DEFINE_F(PluginBench, BM_ActivationWheel)(benchmark::State& state)
+{
+    if (state.error_occurred()) return;
+    std::mt19937 rng(38);
+    std::vector<LOAEntry> rules(300);
+    for (size_t i = 0; i < rules.size(); ++i) {
+        for (int w = 0, windows = 1 + (int)(rng() % 2); w < windows; ++w) {
+            LoaActivationWindow window;
+            window.fromMinute = (int)(rng() % 1440);
+            window.toMinute = rng() % 20 == 0 ? window.fromMinute : (int)(rng() % 1440);
+            rules[i].activeUtc.push_back(window);
+        }
+        if (i % 3 == 0) rules[i].activeWhen = i % 2 ? "BENCH_A" : "BENCH_B";
+    }
+    destinationLoas = rules;
+    departureLoas.clear();
+    lorArrivals.clear();
+    lorDepartures.clear();
+    fallbackLoas.clear();
+
+    uint64_t seconds = LoaUtcNow();
+    loaActivation.Rebuild(seconds);
+    std::vector<const LOAEntry*> changed;
+    for (int step = 0; step < 20000; ++step) {
+        uint32_t r = rng() % 100;
+        seconds += r < 80 ? 60 * (1 + rng() % 5) : r < 95 ? 60 * (1 + rng() % 1440) : 60 * (1 + rng() % 4320);
+        if (rng() % 50 == 0) loaActivation.SetCondition(rng() % 2 ? "BENCH_A" : "BENCH_B", rng() % 2 != 0, changed);
+        loaActivation.Advance(seconds, changed);
+
+        bool same = true;
+        for (const auto& entry : destinationLoas)
+            same = same && entry.active == LoaRuleActiveAt(entry, seconds / 60, loaActivation.GetConditions());
+        if (!same) {
+            state.SkipWithError(("active flags differ from the clock at step " + std::to_string(step)).c_str());
+            break;
+        }
+    }
+
+    unsigned long long transitions = loaActivation.transitions;
+    for (auto _ : state) {
+        for (int minute = 0; minute < 1440; ++minute) {
+            seconds += 60;
+            changed.clear();
+            loaActivation.Advance(seconds, changed);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * 1440);
+    state.counters["flips_per_day"] = (double)(loaActivation.transitions - transitions) / state.iterations();
+
+    loaActivation.SetCondition("BENCH_A", false, changed);
+    loaActivation.SetCondition("BENCH_B", false, changed);
+    LoadBenchConfig();
+
+    flights.clear();
+    for (const auto& entry : fallbackLoas) {
+        if (entry.minAltitudeFt <= 0 || entry.destinationAirports.empty()) continue;
+        EuroScopePlugIn::StubFlightPlanData f;
+        f.callsign = ::Name("CLB", (int)flights.size());
+        f.origin = "ZZZZ";
+        f.destination = (entry.destinationAirports[0] + "ZZ").substr(0, 4);
+        for (const auto& point : entry.waypoints) {
+            f.route += (f.route.empty() ? "" : " DCT ") + point;
+            f.routePoints.push_back({ point, {} });
+        }
+        f.clearedAltitude = 5000;
+        f.finalAltitude = 36000;
+        flights.push_back(f);
+    }
+    std::vector<EuroScopePlugIn::StubFlightPlanData*> savedWorld = EuroScopePlugIn::GetStubWorld().flightPlans;
+    for (auto& f : flights) {
+        EuroScopePlugIn::GetStubWorld().flightPlans.push_back(&f);
+        plugin->matchTimestamps.erase(f.callsign);
+        MatchLoaEntry(EuroScopePlugIn::CFlightPlan(&f), corpus->online);
+    }
+    changed.clear();
+    for (auto& entry : fallbackLoas) {
+        entry.active = false;
+        changed.push_back(&entry);
+    }
+    plugin->OnRulesActivationChanged(changed);
+
+    std::string mismatch;
+    for (auto& f : flights) {
+        EuroScopePlugIn::CFlightPlan fp(&f);
+        f.clearedAltitude = 35000;
+        plugin->OnFlightPlanControllerAssignedDataUpdate(fp, EuroScopePlugIn::CTR_DATA_TYPE_TEMPORARY_ALTITUDE);
+        const LOAEntry* read = MatchLoaEntry(fp, corpus->online);
+        plugin->matchTimestamps.erase(f.callsign);
+        plugin->altitudeProfiles.erase(f.callsign);
+        if (read != MatchLoaEntry(fp, corpus->online) && mismatch.empty())
+            mismatch = "climb after a deactivation disagrees with matching for " + f.callsign;
+        plugin->CleanupCache(f.callsign);
+    }
+    EuroScopePlugIn::GetStubWorld().flightPlans = savedWorld;
+    LoadBenchConfig();
+    if (!mismatch.empty()) state.SkipWithError(mismatch.c_str());
+}
+BENCHMARK_REGISTER_F(PluginBench, BM_ActivationWheel);
+
+// One record rewritten 3,000,000 times by a writer thread while the timed
+// reader copies it with LoaExportTryRead. Every payload repeats its counter in
+// each numeric and text field, so a torn copy cannot go unnoticed.
+static void BM_ResultExport(benchmark::State& state)
+{
+    const char* name = "LOAPluginBenchExport";
+    const int publishes = 3000000;
+    LoaResultPublisher publisher;
+    int fd = publisher.Start(name) ? shm_open((std::string("/") + name).c_str(), O_RDONLY, 0) : -1;
+    if (fd < 0) {
+        state.SkipWithError("cannot create the result table");
+        return;
+    }
+    size_t bytes = sizeof(LoaExportHeader) + LOA_EXPORT_CAPACITY * sizeof(LoaExportRecord);
+    void* view = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (view == MAP_FAILED) {
+        state.SkipWithError("cannot map the result table");
+        return;
+    }
+    const LoaExportRecord& record = *reinterpret_cast<const LoaExportRecord*>(static_cast<const char*>(view) + sizeof(LoaExportHeader));
+
+    auto payload = [](int n) {
+        LoaExportData d;
+        memset(&d, 0, sizeof(d));
+        strncpy_s(d.callsign, sizeof(d.callsign), "SEQLOCK", _TRUNCATE);
+        d.ruleId = d.xfl = d.exitAltitude = d.exitAltitudeState = d.exitPointState = n;
+        d.updatedMs = (uint64_t)n;
+        snprintf(d.cop, sizeof(d.cop), "%d", n);
+        snprintf(d.nextSector, sizeof(d.nextSector), "%d", n);
+        snprintf(d.exitPoint, sizeof(d.exitPoint), "%d", n);
+        return d;
+    };
+    publisher.Publish(payload(0));
+
+    unsigned long long reads = 0, busy = 0, torn = 0;
+    for (auto _ : state) {
+        std::atomic<bool> done(false);
+        std::thread writer([&] {
+            for (int n = 1; n <= publishes; ++n) publisher.Publish(payload(n));
+            done.store(true, std::memory_order_release);
+        });
+        LoaExportData copy;
+        while (!done.load(std::memory_order_acquire)) {
+            if (!LoaExportTryRead(record, copy)) {
+                busy++;
+                continue;
+            }
+            reads++;
+            LoaExportData expected = payload(copy.ruleId);
+            if (memcmp(&copy, &expected, sizeof(copy)) != 0) torn++;
+        }
+        writer.join();
+    }
+    state.counters["reads"] = (double)reads;
+    state.counters["busy"] = (double)busy;
+    state.counters["writes"] = (double)publisher.writes;
+    munmap(view, bytes);
+    publisher.Stop();
+    if (torn) state.SkipWithError((std::to_string(torn) + " torn reads").c_str());
+}
+BENCHMARK(BM_ResultExport)->Iterations(1)->UseRealTime();
+
+BENCHMARK_MAIN();
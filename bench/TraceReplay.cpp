@@ -0,0 +1,200 @@
+﻿// =========================
+// File: bench/TraceReplay.cpp
+// =========================
+// Offline replay of a .loatrace recording against the stub SDK:
+//
+//   loa_replay <trace.loatrace> <sector.json>
+//
+// Records are fed to the plugin callbacks in recorded order with the stub clock
+// pinned to each record's timestamp, so two runs over the same trace make the
+// same decisions. Prints per-callback timing.
+
+#include "stdafx.h"
+#include "LOAPlugin.h"
+#include "LoaTrace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace EuroScopePlugIn;
+
+namespace {
+
+struct Timings {
+    std::vector<double> samplesUs;
+
+    void Print(const char* name) const {
+        if (samplesUs.empty()) return;
+        std::vector<double> sorted = samplesUs;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0;
+        for (double v : sorted) total += v;
+        printf("%-22s %8zu calls  mean %8.2f us  p50 %8.2f us  p99 %8.2f us  max %8.2f us\n",
+            name, sorted.size(), total / sorted.size(), sorted[sorted.size() / 2],
+            sorted[(size_t)(sorted.size() * 0.99)], sorted.back());
+    }
+};
+
+std::map<std::string, std::unique_ptr<StubFlightPlanData>> flights;
+std::map<std::string, std::unique_ptr<StubControllerData>> controllers;
+
+StubFlightPlanData* ApplyFlight(const LoaTraceRecord& r)
+{
+    auto& slot = flights[r.callsign];
+    if (!slot) {
+        slot.reset(new StubFlightPlanData());
+        GetStubWorld().flightPlans.push_back(slot.get());
+    }
+    StubFlightPlanData& d = *slot;
+    d.callsign = r.callsign;
+    d.planType = r.planType;
+    d.origin = r.origin;
+    d.destination = r.destination;
+    d.trackingController = r.trackingController;
+    d.state = r.state;
+    d.clearedAltitude = r.clearedAltitude;
+    d.finalAltitude = r.finalAltitude;
+    d.exitAltitude = r.exitAltitude;
+    d.exitAltitudeState = r.exitAltitudeState;
+    d.exitPoint = r.exitPoint;
+    d.exitPointState = r.exitPointState;
+    d.aircraftType = r.aircraftType;
+    d.wtc = r.wakeCategory;
+    d.sid = r.sid;
+    d.star = r.star;
+    d.squawk = r.squawk;
+    d.position.m_Latitude = r.latitude;
+    d.position.m_Longitude = r.longitude;
+
+    // Records made before the plugin extracted the route carry no points; the
+    // extraction only changes with the route text
+    if (!r.routePoints.empty() || d.route != r.route) {
+        d.routePoints.clear();
+        for (const auto& name : r.routePoints) d.routePoints.push_back({ name, {} });
+    }
+    d.route = r.route;
+    return &d;
+}
+
+StubControllerData* ApplyController(const LoaTraceRecord& r)
+{
+    auto& slot = controllers[r.controllerCallsign];
+    if (!slot) {
+        slot.reset(new StubControllerData());
+        GetStubWorld().controllers.push_back(slot.get());
+    }
+    slot->callsign = r.controllerCallsign;
+    slot->positionId = r.positionId;
+    slot->frequency = r.frequency;
+    return slot.get();
+}
+
+void RemoveController(const std::string& callsign)
+{
+    auto it = controllers.find(callsign);
+    if (it == controllers.end()) return;
+    auto& list = GetStubWorld().controllers;
+    list.erase(std::remove(list.begin(), list.end(), it->second.get()), list.end());
+    controllers.erase(it);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <trace.loatrace> <sector.json>\n", argv[0]);
+        return 2;
+    }
+
+    // The replay stands in for EuroScope's EuroScopePlugInInit
+    LOAPlugin instance;
+    plugin = &instance;
+
+    std::string error;
+    if (!LoadLOAConfigFile(argv[2], error)) {
+        fprintf(stderr, "config: %s\n", error.c_str());
+        return 1;
+    }
+
+    LoaTraceReader reader;
+    if (!reader.Open(argv[1])) {
+        fprintf(stderr, "cannot read trace %s\n", argv[1]);
+        return 1;
+    }
+
+    // Any non-zero base works; it only has to be the same on every run
+    const ULONGLONG clockBase = 1000000;
+    Timings tagTimes, stateTimes, coordTimes, controllerTimes;
+    std::map<std::string, std::string> lastOutput;
+    size_t outputChanges = 0;
+
+    LoaTraceRecord r;
+    while (reader.Next(r)) {
+        StubFakeTickCount() = clockBase + r.timestampUs / 1000;
+
+        auto start = std::chrono::steady_clock::now();
+        Timings* bucket = nullptr;
+
+        switch (r.type) {
+        case LOA_TRACE_TAG_ITEM: {
+            StubFlightPlanData* d = ApplyFlight(r);
+            char item[16] = { 0 };
+            int color = 0;
+            COLORREF rgb = 0;
+            double fontSize = 0;
+            start = std::chrono::steady_clock::now();
+            plugin->OnGetTagItem(CFlightPlan(d), CRadarTarget(d), r.itemCode, 0, item, &color, &rgb, &fontSize);
+            bucket = &tagTimes;
+
+            std::string& last = lastOutput[r.callsign + "/" + std::to_string(r.itemCode)];
+            if (last != item) {
+                last = item;
+                outputChanges++;
+            }
+            break;
+        }
+        case LOA_TRACE_STATE_CHANGE:
+            start = std::chrono::steady_clock::now();
+            plugin->OnFlightPlanStateChange(CFlightPlan(ApplyFlight(r)));
+            bucket = &stateTimes;
+            break;
+        case LOA_TRACE_COORDINATION_CHANGE:
+            start = std::chrono::steady_clock::now();
+            plugin->OnFlightPlanCoordinationStateChange(CFlightPlan(ApplyFlight(r)), r.coordinationType, r.newState);
+            bucket = &coordTimes;
+            break;
+        case LOA_TRACE_CONTROLLER_UPDATE:
+            start = std::chrono::steady_clock::now();
+            plugin->OnControllerPositionUpdate(CController(ApplyController(r)));
+            bucket = &controllerTimes;
+            break;
+        case LOA_TRACE_CONTROLLER_DISCONNECT: {
+            StubControllerData* c = ApplyController(r);
+            start = std::chrono::steady_clock::now();
+            plugin->OnControllerDisconnect(CController(c));
+            bucket = &controllerTimes;
+            RemoveController(r.controllerCallsign);
+            break;
+        }
+        default:
+            break;
+        }
+
+        if (bucket) {
+            bucket->samplesUs.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count());
+        }
+    }
+
+    printf("flights: %zu  tag outputs changed: %zu\n", flights.size(), outputChanges);
+    tagTimes.Print("OnGetTagItem");
+    stateTimes.Print("OnFlightPlanStateChange");
+    coordTimes.Print("OnCoordinationChange");
+    controllerTimes.Print("Controller callbacks");
+    return 0;
+}
@@ -0,0 +1,110 @@
+// =============================
+// File: EuroScopePlugIn.cpp (stub)
+// =============================
+
+#include "EuroScopePlugIn.h"
+#include <algorithm>
+#include <cmath>
+
+// The real linker provides this for every PE image; LOAPlugin.cpp takes its address
+extern "C" {
+IMAGE_DOS_HEADER __ImageBase = { 0 };
+}
+
+ULONGLONG& StubFakeTickCount()
+{
+    static ULONGLONG ticks = 0;
+    return ticks;
+}
+
+namespace EuroScopePlugIn {
+
+StubWorld& GetStubWorld()
+{
+    static StubWorld world;
+    return world;
+}
+
+static const double kPi = 3.14159265358979323846;
+static double ToRad(double deg) { return deg * kPi / 180.0; }
+
+// Great-circle distance in nautical miles
+double CPosition::DistanceTo(const CPosition& other) const
+{
+    double dLat = ToRad(other.m_Latitude - m_Latitude);
+    double dLon = ToRad(other.m_Longitude - m_Longitude);
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+        std::cos(ToRad(m_Latitude)) * std::cos(ToRad(other.m_Latitude)) * std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 3440.065 * 2 * std::atan2(std::sqrt(a), std::sqrt(1 - a));
+}
+
+double CPosition::DirectionTo(const CPosition& other) const
+{
+    double dLon = ToRad(other.m_Longitude - m_Longitude);
+    double y = std::sin(dLon) * std::cos(ToRad(other.m_Latitude));
+    double x = std::cos(ToRad(m_Latitude)) * std::sin(ToRad(other.m_Latitude)) -
+        std::sin(ToRad(m_Latitude)) * std::cos(ToRad(other.m_Latitude)) * std::cos(dLon);
+    double brg = std::atan2(y, x) * 180.0 / kPi;
+    return brg < 0 ? brg + 360.0 : brg;
+}
+
+CPosition CRadarScreen::GetDisplayArea(CPosition* pLeftDown, CPosition* pRightUp) const
+{
+    const StubWorld& w = GetStubWorld();
+    if (pLeftDown) *pLeftDown = w.displayLeftDown;
+    if (pRightUp) *pRightUp = w.displayRightUp;
+    return w.displayLeftDown;
+}
+
+template <typename T>
+static T* NextOf(const std::vector<T*>& list, const T* current)
+{
+    auto it = std::find(list.begin(), list.end(), current);
+    if (it == list.end() || ++it == list.end()) return nullptr;
+    return *it;
+}
+
+CController CPlugIn::ControllerSelectFirst()
+{
+    const auto& list = GetStubWorld().controllers;
+    return CController(list.empty() ? nullptr : list.front());
+}
+
+CController CPlugIn::ControllerSelectNext(CController current)
+{
+    return CController(NextOf(GetStubWorld().controllers, current.Data()));
+}
+
+CController CPlugIn::ControllerSelect(const char* callsign)
+{
+    for (auto* c : GetStubWorld().controllers)
+        if (c->callsign == callsign) return CController(c);
+    return CController();
+}
+
+CController CPlugIn::ControllerSelectByPositionId(const char* positionId)
+{
+    for (auto* c : GetStubWorld().controllers)
+        if (c->positionId == positionId) return CController(c);
+    return CController();
+}
+
+CFlightPlan CPlugIn::FlightPlanSelectFirst()
+{
+    const auto& list = GetStubWorld().flightPlans;
+    return CFlightPlan(list.empty() ? nullptr : list.front());
+}
+
+CFlightPlan CPlugIn::FlightPlanSelectNext(CFlightPlan current)
+{
+    return CFlightPlan(NextOf(GetStubWorld().flightPlans, current.Data()));
+}
+
+CFlightPlan CPlugIn::FlightPlanSelect(const char* callsign)
+{
+    for (auto* fp : GetStubWorld().flightPlans)
+        if (fp->callsign == callsign) return CFlightPlan(fp);
+    return CFlightPlan();
+}
+
+} // namespace EuroScopePlugIn
@@ -0,0 +1,267 @@
+// =============================
+// File: EuroScopePlugIn.h (stub)
+// =============================
+// Minimal, data-backed stand-in for the EuroScope SDK so the matcher sources
+// can be built and benchmarked on Linux. Only the calls the plugin makes are
+// provided; every object is a thin handle onto a plain struct that the bench
+// fills in directly.
+
+#pragma once
+
+#include "windows.h"
+#include <string>
+#include <vector>
+
+namespace EuroScopePlugIn {
+
+const int COMPATIBILITY_CODE = 16;
+
+const int FLIGHT_PLAN_STATE_NON_CONCERNED = 0;
+const int FLIGHT_PLAN_STATE_NOTIFIED = 1;
+const int FLIGHT_PLAN_STATE_COORDINATED = 2;
+const int FLIGHT_PLAN_STATE_TRANSFER_TO_ME_INITIATED = 3;
+const int FLIGHT_PLAN_STATE_TRANSFER_FROM_ME_INITIATED = 4;
+const int FLIGHT_PLAN_STATE_ASSUMED = 5;
+const int FLIGHT_PLAN_STATE_REDUNDANT = 7;
+
+const int COORDINATION_STATE_NONE = 0;
+const int COORDINATION_STATE_REQUESTED_BY_ME = 1;
+const int COORDINATION_STATE_REQUESTED_BY_OTHER = 2;
+const int COORDINATION_STATE_ACCEPTED = 3;
+const int COORDINATION_STATE_REFUSED = 4;
+const int COORDINATION_STATE_MANUAL_ACCEPTED = 5;
+
+const int TAG_COLOR_DEFAULT = 0;
+const int TAG_COLOR_RGB_DEFINED = 1;
+const int TAG_COLOR_ONGOING_REQUEST_FROM_ME = 7;
+const int TAG_COLOR_ONGOING_REQUEST_TO_ME = 8;
+const int TAG_COLOR_ONGOING_REQUEST_ACCEPTED = 9;
+const int TAG_COLOR_ONGOING_REQUEST_REFUSED = 10;
+
+const int TAG_ITEM_TYPE_COPN_COPX_NAME = 13;
+const int TAG_ITEM_TYPE_COPN_COPX_ALTITUDE = 14;
+
+const int TAG_ITEM_FUNCTION_NO = 0;
+
+// As in the SDK header (OnFlightPlanControllerAssignedDataUpdate tells final
+// from temporary altitude, so the two must differ)
+const int CTR_DATA_TYPE_SQUAWK = 1;
+const int CTR_DATA_TYPE_FINAL_ALTITUDE = 2;
+const int CTR_DATA_TYPE_TEMPORARY_ALTITUDE = 3;
+
+class CPosition {
+public:
+    double m_Latitude = 0.0;
+    double m_Longitude = 0.0;
+    double DistanceTo(const CPosition& other) const;
+    double DirectionTo(const CPosition& other) const;
+};
+
+// ---- plain data the handles point at ----
+struct StubRoutePoint {
+    std::string name;
+    CPosition position;
+};
+
+struct StubFlightPlanData {
+    std::string callsign;
+    std::string planType = "I";
+    std::string origin;
+    std::string destination;
+    std::string route;
+    std::string aircraftType;
+    char wtc = 'M';
+    std::string sid;
+    std::string star;
+    std::string trackingController;
+    std::string squawk;
+    std::string directTo;
+    int state = FLIGHT_PLAN_STATE_ASSUMED;
+    int clearedAltitude = 0;
+    int finalAltitude = 0;
+    int exitAltitude = 0;
+    int exitAltitudeState = COORDINATION_STATE_NONE;
+    std::string exitPoint;
+    int exitPointState = COORDINATION_STATE_NONE;
+    std::string handoffTarget;
+    CPosition position;
+    std::vector<StubRoutePoint> routePoints;
+};
+
+struct StubControllerData {
+    std::string callsign;
+    std::string positionId;
+    double frequency = 0.0;
+    bool isController = true;
+    CPosition position;
+};
+
+class CFlightPlanExtractedRoute {
+public:
+    explicit CFlightPlanExtractedRoute(const StubFlightPlanData* d = nullptr) : m_d(d) {}
+    int GetPointsNumber() const { return m_d ? (int)m_d->routePoints.size() : 0; }
+    const char* GetPointName(int i) const { return m_d->routePoints[i].name.c_str(); }
+    CPosition GetPointPosition(int i) const { return m_d->routePoints[i].position; }
+    int GetPointsCalculatedIndex() const { return 0; }
+    int GetPointsAssignedIndex() const { return -1; }
+private:
+    const StubFlightPlanData* m_d;
+};
+
+class CFlightPlanData {
+public:
+    explicit CFlightPlanData(const StubFlightPlanData* d = nullptr) : m_d(d) {}
+    bool IsReceived() const { return m_d != nullptr; }
+    const char* GetPlanType() const { return m_d->planType.c_str(); }
+    const char* GetOrigin() const { return m_d->origin.c_str(); }
+    const char* GetDestination() const { return m_d->destination.c_str(); }
+    const char* GetRoute() const { return m_d->route.c_str(); }
+    const char* GetAircraftFPType() const { return m_d->aircraftType.c_str(); }
+    char GetAircraftWtc() const { return m_d->wtc; }
+    const char* GetSidName() const { return m_d->sid.c_str(); }
+    const char* GetStarName() const { return m_d->star.c_str(); }
+    int GetFinalAltitude() const { return m_d->finalAltitude; }
+private:
+    const StubFlightPlanData* m_d;
+};
+
+class CFlightPlanControllerAssignedData {
+public:
+    explicit CFlightPlanControllerAssignedData(const StubFlightPlanData* d = nullptr) : m_d(d) {}
+    const char* GetSquawk() const { return m_d->squawk.c_str(); }
+    const char* GetDirectToPointName() const { return m_d->directTo.c_str(); }
+private:
+    const StubFlightPlanData* m_d;
+};
+
+class CRadarTarget;
+
+class CFlightPlan {
+public:
+    CFlightPlan(StubFlightPlanData* d = nullptr) : m_d(d) {}
+    bool IsValid() const { return m_d != nullptr; }
+    const char* GetCallsign() const { return m_d->callsign.c_str(); }
+    int GetState() const { return m_d->state; }
+    CFlightPlanData GetFlightPlanData() const { return CFlightPlanData(m_d); }
+    CFlightPlanControllerAssignedData GetControllerAssignedData() const { return CFlightPlanControllerAssignedData(m_d); }
+    CFlightPlanExtractedRoute GetExtractedRoute() const { return CFlightPlanExtractedRoute(m_d); }
+    int GetClearedAltitude() const { return m_d->clearedAltitude; }
+    int GetFinalAltitude() const { return m_d->finalAltitude; }
+    const char* GetTrackingControllerId() const { return m_d->trackingController.c_str(); }
+    int GetExitCoordinationAltitude() const { return m_d->exitAltitude; }
+    int GetExitCoordinationAltitudeState() const { return m_d->exitAltitudeState; }
+    const char* GetExitCoordinationPointName() const { return m_d->exitPoint.c_str(); }
+    int GetExitCoordinationNameState() const { return m_d->exitPointState; }
+    CPosition GetFPTrackPosition() const { return m_d->position; }
+    CRadarTarget GetCorrelatedRadarTarget() const;
+    bool InitiateHandoff(const char* targetController) { m_d->handoffTarget = targetController; return true; }
+    StubFlightPlanData* Data() const { return m_d; }
+private:
+    StubFlightPlanData* m_d;
+};
+
+class CRadarTargetPositionData {
+public:
+    explicit CRadarTargetPositionData(const StubFlightPlanData* d = nullptr) : m_d(d) {}
+    bool IsValid() const { return m_d != nullptr; }
+    CPosition GetPosition() const { return m_d->position; }
+    int GetPressureAltitude() const { return m_d->clearedAltitude; }
+    int GetFlightLevel() const { return m_d->clearedAltitude; }
+private:
+    const StubFlightPlanData* m_d;
+};
+
+class CRadarTarget {
+public:
+    CRadarTarget(StubFlightPlanData* d = nullptr) : m_d(d) {}
+    bool IsValid() const { return m_d != nullptr; }
+    const char* GetCallsign() const { return m_d->callsign.c_str(); }
+    CFlightPlan GetCorrelatedFlightPlan() const { return CFlightPlan(m_d); }
+    CRadarTargetPositionData GetPosition() const { return CRadarTargetPositionData(m_d); }
+private:
+    StubFlightPlanData* m_d;
+};
+
+inline CRadarTarget CFlightPlan::GetCorrelatedRadarTarget() const { return CRadarTarget(m_d); }
+
+class CController {
+public:
+    CController(const StubControllerData* d = nullptr) : m_d(d) {}
+    bool IsValid() const { return m_d != nullptr; }
+    bool IsController() const { return m_d->isController; }
+    const char* GetCallsign() const { return m_d->callsign.c_str(); }
+    const char* GetPositionId() const { return m_d->positionId.c_str(); }
+    double GetPrimaryFrequency() const { return m_d->frequency; }
+    CPosition GetPosition() const { return m_d->position; }
+    const StubControllerData* Data() const { return m_d; }
+private:
+    const StubControllerData* m_d;
+};
+
+class CPlugIn;
+
+class CRadarScreen {
+public:
+    CRadarScreen() {}
+    virtual ~CRadarScreen() {}
+    virtual void OnAsrContentToBeClosed() = 0;
+    virtual void OnRefresh(HDC hDC, int Phase) {}
+    CPosition GetDisplayArea(CPosition* pLeftDown = nullptr, CPosition* pRightUp = nullptr) const;
+    POINT ConvertCoordFromPositionToPixel(CPosition Pos) const { return POINT{ 0, 0 }; }
+    void RequestRefresh() {}
+    CPlugIn* GetPlugIn() const { return nullptr; }
+};
+
+const int REFRESH_PHASE_BACK_BITMAP = 0;
+const int REFRESH_PHASE_BEFORE_TAGS = 1;
+const int REFRESH_PHASE_AFTER_TAGS = 2;
+const int REFRESH_PHASE_AFTER_LISTS = 3;
+
+// The stub keeps its world in these vectors; benches populate them directly.
+struct StubWorld {
+    std::vector<StubFlightPlanData*> flightPlans;
+    std::vector<StubControllerData*> controllers;
+    StubControllerData myself;
+    StubFlightPlanData* selected = nullptr;
+    CPosition displayLeftDown;
+    CPosition displayRightUp;
+};
+StubWorld& GetStubWorld();
+
+class CPlugIn {
+public:
+    CPlugIn(int, const char*, const char*, const char*, const char*) {}
+    virtual ~CPlugIn() {}
+
+    void RegisterTagItemType(const char*, int) {}
+    void RegisterTagItemFunction(const char*, int) {}
+    void DisplayUserMessage(const char*, const char*, const char*, bool, bool, bool, bool, bool) {}
+    const char* GetDataFromSettings(const char*) { return nullptr; }
+    void SaveDataToSettings(const char*, const char*, const char*) {}
+
+    CController ControllerMyself() { return CController(&GetStubWorld().myself); }
+    CController ControllerSelectFirst();
+    CController ControllerSelectNext(CController current);
+    CController ControllerSelect(const char* callsign);
+    CController ControllerSelectByPositionId(const char* positionId);
+    CFlightPlan FlightPlanSelectFirst();
+    CFlightPlan FlightPlanSelectNext(CFlightPlan current);
+    CFlightPlan FlightPlanSelect(const char* callsign);
+    CFlightPlan FlightPlanSelectASEL() { return CFlightPlan(GetStubWorld().selected); }
+
+    virtual bool OnCompileCommand(const char* sCommandLine) { return false; }
+    virtual void OnTimer(int Counter) {}
+    virtual void OnControllerPositionUpdate(CController Controller) {}
+    virtual void OnControllerDisconnect(CController Controller) {}
+    virtual void OnRadarTargetPositionUpdate(CRadarTarget RadarTarget) {}
+    virtual void OnFlightPlanDisconnect(CFlightPlan FlightPlan) {}
+    virtual void OnFlightPlanFlightPlanDataUpdate(CFlightPlan FlightPlan) {}
+    virtual void OnFlightPlanControllerAssignedDataUpdate(CFlightPlan FlightPlan, int DataType) {}
+    virtual void OnGetTagItem(CFlightPlan FlightPlan, CRadarTarget RadarTarget, int ItemCode, int TagData,
+        char sItemString[16], int* pColorCode, COLORREF* pRGB, double* pFontSize) {}
+    virtual void OnFunctionCall(int FunctionId, const char* sItemString, POINT Pt, RECT Area) {}
+    virtual CRadarScreen* OnRadarScreenCreated(const char* sDisplayName, bool NeedRadarContent,
+        bool GeoReferenced, bool CanBeSaved, bool CanBeCreated) { return nullptr; }
+};
+
+} // namespace EuroScopePlugIn
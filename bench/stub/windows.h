@@ -0,0 +1,70 @@
+// =============================
+// File: windows.h (stub)
+// =============================
+// Just enough of the Win32 surface for the plugin sources to compile on Linux.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <strings.h>
+#include <chrono>
+
+typedef unsigned long DWORD;
+typedef unsigned long long ULONGLONG;
+typedef DWORD COLORREF;
+typedef void* HMODULE;
+typedef void* HINSTANCE;
+typedef void* HANDLE;
+typedef void* HDC;
+typedef void* LPVOID;
+typedef int BOOL;
+typedef long LONG;
+
+#define TRUE 1
+#define FALSE 0
+#define APIENTRY
+#define __declspec(x)
+#define MAX_PATH 260
+#define _TRUNCATE ((size_t)-1)
+
+#define DLL_PROCESS_DETACH 0
+#define DLL_PROCESS_ATTACH 1
+#define DLL_THREAD_ATTACH 2
+#define DLL_THREAD_DETACH 3
+
+#define RGB(r, g, b) ((COLORREF)(((uint8_t)(r) | ((uint16_t)((uint8_t)(g)) << 8)) | (((DWORD)(uint8_t)(b)) << 16)))
+
+struct POINT { LONG x, y; };
+struct RECT { LONG left, top, right, bottom; };
+struct IMAGE_DOS_HEADER { int e_magic; };
+
+// Replays drive the clock from trace timestamps; 0 means "use the real clock"
+ULONGLONG& StubFakeTickCount();
+
+inline ULONGLONG GetTickCount64()
+{
+    if (StubFakeTickCount() != 0) return StubFakeTickCount();
+    return (ULONGLONG)std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline DWORD GetModuleFileNameA(HINSTANCE, char* buf, DWORD size)
+{
+    snprintf(buf, size, "./LOAPlugin.dll");
+    return (DWORD)strlen(buf);
+}
+
+inline int _stricmp(const char* a, const char* b) { return strcasecmp(a, b); }
+inline int _strnicmp(const char* a, const char* b, size_t n) { return strncasecmp(a, b, n); }
+
+inline int strncpy_s(char* dst, size_t size, const char* src, size_t count)
+{
+    size_t n = strlen(src);
+    if (count != _TRUNCATE && count < n) n = count;
+    if (n >= size) n = size - 1;
+    memcpy(dst, src, n);
+    dst[n] = 0;
+    return 0;
+}
@@ -0,0 +1,312 @@
+﻿// =========================
+// File: tools/LoaCodegen.cpp
+// =========================
+// Generates a compiled ruleset (see LoaCompiled.h) from a loa_configs_json file:
+//
+//   loa_codegen <config.json> <output.cpp> [positionId]
+//
+// The position defaults to the config file name without extension. Add the
+// output to the plugin (generated\*.cpp is picked up by the project) and it is
+// used whenever that position loads a byte-identical config.
+
+#include "stdafx.h"
+#include "LOAPlugin.h"
+#include "LoaCompiled.h"
+#include "LoaPredicate.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::string Upper(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)toupper(c); });
+    return s;
+}
+
+std::string Literal(const std::string& s)
+{
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+std::string Hex(uint64_t v)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "0x%016llxull", (unsigned long long)v);
+    return buf;
+}
+
+std::string StringArray(const std::vector<std::string>& items)
+{
+    std::string out = "{ ";
+    for (size_t i = 0; i < items.size(); ++i) out += (i ? ", " : "") + Literal(items[i]);
+    return out + " }";
+}
+
+struct AirportSet {
+    std::vector<std::string> exact;
+    std::vector<std::string> prefixes;
+    bool operator<(const AirportSet& o) const {
+        return exact != o.exact ? exact < o.exact : prefixes < o.prefixes;
+    }
+};
+
+class Generator {
+public:
+    std::string Run(const std::string& positionId, const std::string& sourceName);
+
+private:
+    int WaypointId(const std::string& name);
+    int AirportSetId(const LOAEntry& entry, bool origin);
+    std::string WaypointCondition(const LOAEntry& entry);
+    void EmitRule(std::ostringstream& body, const LOAEntry& entry, int list, int index);
+
+    std::map<std::string, int> waypointIds;     // upper-cased name -> bit
+    std::map<AirportSet, int> airportSetIds;
+    std::ostringstream decls;
+    int ruleCount = 0;
+};
+
+int Generator::WaypointId(const std::string& name)
+{
+    auto it = waypointIds.find(Upper(name));
+    if (it != waypointIds.end()) return it->second;
+    int id = (int)waypointIds.size();
+    waypointIds[Upper(name)] = id;
+    return id;
+}
+
+int Generator::AirportSetId(const LOAEntry& entry, bool origin)
+{
+    AirportSet set;
+    const auto& exact = origin ? entry.originAirportSet : entry.destinationAirportSet;
+    set.exact.assign(exact.begin(), exact.end());
+    std::sort(set.exact.begin(), set.exact.end());
+    set.prefixes = origin ? entry.originAirportPrefixes : entry.destinationAirportPrefixes;
+
+    auto it = airportSetIds.find(set);
+    if (it != airportSetIds.end()) return it->second;
+    int id = (int)airportSetIds.size();
+    airportSetIds[set] = id;
+    return id;
+}
+
+std::string Generator::WaypointCondition(const LOAEntry& entry)
+{
+    std::map<int, uint64_t> words;
+    for (const auto& wp : entry.waypoints) {
+        int id = WaypointId(wp);
+        words[id >> 6] |= 1ull << (id & 63);
+    }
+    std::string cond;
+    for (const auto& w : words) {
+        if (!cond.empty()) cond += " && ";
+        cond += "(route.Mask()[" + std::to_string(w.first) + "] & " + Hex(w.second) + ") == " + Hex(w.second);
+    }
+    return cond;
+}
+
+void Generator::EmitRule(std::ostringstream& body, const LOAEntry& entry, int list, int index)
+{
+    static const char* listNames[] = { "destinationLoas", "departureLoas", "lorArrivals", "lorDepartures", "fallbackLoas" };
+    static const char* listIds[] = { "LOA_LIST_DESTINATION", "LOA_LIST_DEPARTURE", "LOA_LIST_LOR_ARRIVALS",
+        "LOA_LIST_LOR_DEPARTURES", "LOA_LIST_FALLBACK" };
+    bool fallback = list == LOA_LIST_FALLBACK;
+    ruleCount++;
+
+    // Cheapest and most selective tests first, the route only once the airports
+    // match; the online check stays last so dependsOn only records sectors that
+    // alone decide the rule (as MatchLoaEntry does)
+    std::vector<std::string> conds;
+    if (!entry.activeUtc.empty() || !entry.activeWhen.empty())
+        conds.push_back("LoaRuleActive(" + std::string(listIds[list]) + ", " + std::to_string(index) + ")");
+    if (fallback) conds.push_back("in.clearedAltitude >= " + std::to_string(entry.minAltitudeFt));
+    if (!fallback && !entry.originAirports.empty())
+        conds.push_back("Airports" + std::to_string(AirportSetId(entry, true)) + "(o)");
+    if (!entry.destinationAirports.empty())
+        conds.push_back("Airports" + std::to_string(AirportSetId(entry, false)) + "(d)");
+    std::string tag = std::to_string(list) + "_" + std::to_string(index);
+    std::string wpCond = WaypointCondition(entry);
+    if (!wpCond.empty()) conds.push_back(wpCond);
+    if (entry.waypointsOrdered && entry.waypoints.size() > 1) {
+        decls << "const char* const kOrdered" << tag << "[] = " << StringArray(entry.waypoints) << ";\n";
+        conds.push_back("LoaRouteHasInOrder(route.Names(), kOrdered" + tag + ", " + std::to_string(entry.waypoints.size()) + ")");
+    }
+
+    if (!fallback && !entry.nextSectors.empty()) {
+        std::vector<std::string> packed;
+        for (const auto& ns : entry.nextSectors) {
+            LoaKey k = PackLoaKey(ns, true);
+            if (k.packed) packed.push_back("ctrl.value == " + Hex(k.value));
+        }
+        decls << "const char* const kNextSectors" << tag << "[] = " << StringArray(entry.nextSectors) << ";\n";
+        std::string packedCond;
+        for (size_t i = 0; i < packed.size(); ++i) packedCond += (i ? " || " : "") + packed[i];
+        if (packedCond.empty()) packedCond = "false";
+        conds.push_back("(ctrl.packed ? (" + packedCond + ") : LoaSlowAnyEqualsIgnoreCase(*in.controller, kNextSectors" +
+            tag + ", " + std::to_string(entry.nextSectors.size()) + "))");
+    }
+
+    std::string cond;
+    for (size_t i = 0; i < conds.size(); ++i) cond += (i ? " &&\n        " : "") + conds[i];
+    if (cond.empty()) cond = "true";
+
+    body << "    // " << listNames[list] << "[" << index << "]\n";
+    body << "    if (" << cond << ") {\n";
+    if (!fallback && entry.requireNextSectorOnline && !entry.nextSectors.empty()) {
+        std::string online;
+        for (const auto& ns : entry.nextSectors) {
+            body << "        in.dependsOn->push_back(" << Literal(ns) << ");\n";
+            online += std::string(online.empty() ? "" : " || ") + "in.onlineControllers->count(" + Literal(ns) + ")";
+        }
+        body << "        if (" << online << ") return { " << listIds[list] << ", " << index << " };\n";
+    }
+    else {
+        body << "        return { " << listIds[list] << ", " << index << " };\n";
+    }
+    body << "    }\n";
+}
+
+std::string Generator::Run(const std::string& positionId, const std::string& sourceName)
+{
+    const std::vector<LOAEntry>* lists[] = { &destinationLoas, &departureLoas, &lorArrivals, &lorDepartures, &fallbackLoas };
+
+    std::ostringstream body;
+    for (int l = 0; l <= LOA_LIST_FALLBACK; ++l)
+        for (size_t i = 0; i < lists[l]->size(); ++i)
+            EmitRule(body, (*lists[l])[i], l, (int)i);
+
+    int words = std::max<int>(1, ((int)waypointIds.size() + 63) / 64);
+
+    std::ostringstream out;
+    out << "// Generated by tools/LoaCodegen.cpp from " << sourceName << " - do not edit.\n"
+        << "// Position " << positionId << ", " << ruleCount << " rules, " << waypointIds.size() << " waypoints, "
+        << airportSetIds.size() << " airport sets.\n\n"
+        << "#include \"stdafx.h\"\n#include \"LoaCompiled.h\"\n\nnamespace {\n\n";
+
+    // Waypoint perfect hash
+    std::vector<std::string> longNames;
+    out << "int WaypointId(const std::string& name)\n{\n"
+        << "    LoaKey k = PackLoaKey(name, true);\n"
+        << "    if (k.packed) {\n        switch (k.value) {\n";
+    for (const auto& w : waypointIds) {
+        LoaKey k = PackLoaKey(w.first, true);
+        if (!k.packed) {
+            longNames.push_back(w.first);
+            continue;
+        }
+        out << "        case " << Hex(k.value) << ": return " << w.second << ";  // " << w.first << "\n";
+    }
+    out << "        default: return -1;\n        }\n    }\n";
+    for (const auto& name : longNames)
+        out << "    if (_stricmp(name.c_str(), " << Literal(name) << ") == 0) return " << waypointIds[name] << ";\n";
+    out << "    return -1;\n}\n\n";
+
+    // Airport sets
+    for (const auto& a : airportSetIds) {
+        const AirportSet& set = a.first;
+        std::string id = std::to_string(a.second);
+        out << "bool Airports" << id << "(const std::string& a)\n{\n"
+            << "    LoaKey k = PackLoaKey(a, false);\n"
+            << "    if (!k.packed) {\n";
+        if (!set.exact.empty()) out << "        static const char* const exact[] = " << StringArray(set.exact) << ";\n";
+        if (!set.prefixes.empty()) out << "        static const char* const prefixes[] = " << StringArray(set.prefixes) << ";\n";
+        out << "        return LoaSlowAirportMatch(a, " << (set.exact.empty() ? "nullptr" : "exact") << ", " << set.exact.size()
+            << ", " << (set.prefixes.empty() ? "nullptr" : "prefixes") << ", " << set.prefixes.size() << ");\n    }\n";
+        if (!set.exact.empty()) {
+            out << "    switch (k.value) {\n";
+            for (const auto& e : set.exact) out << "    case " << Hex(PackLoaKey(e, false).value) << ":  // " << e << "\n";
+            out << "        return true;\n    default:\n        break;\n    }\n";
+        }
+        for (const auto& p : set.prefixes) {
+            LoaKey k = PackLoaKey(p, false);
+            if (!k.packed) continue;  // longer than any packable airport
+            out << "    if ((k.value & " << Hex(LoaPrefixMask(p.size())) << ") == " << Hex(k.value) << ") return true;  // "
+                << p << "*\n";
+        }
+        out << "    return false;\n}\n\n";
+    }
+
+    out << decls.str() << "\n"
+        << "// Route waypoints as a bit set, built on first use\n"
+        << "struct Route {\n"
+        << "    const LoaCompiledInput& in;\n"
+        << "    const std::vector<std::string>* names;\n"
+        << "    uint64_t wp[" << words << "];\n\n"
+        << "    const std::vector<std::string>& Names()\n    {\n"
+        << "        Mask();\n        return *names;\n    }\n\n"
+        << "    const uint64_t* Mask()\n    {\n"
+        << "        if (names) return wp;\n"
+        << "        names = &in.routePoints(in.routeContext);\n"
+        << "        for (const auto& r : *names) {\n"
+        << "            int id = WaypointId(r);\n"
+        << "            if (id >= 0) wp[id >> 6] |= 1ull << (id & 63);\n"
+        << "        }\n"
+        << "        return wp;\n    }\n};\n\n"
+        << "LoaMatchRef Match(const LoaCompiledInput& in)\n{\n"
+        << "    Route route = { in, nullptr, {} };\n"
+        << "    const std::string& o = *in.origin;\n"
+        << "    const std::string& d = *in.destination;\n"
+        << "    LoaKey ctrl = PackLoaKey(*in.controller, true);\n"
+        << "    (void)o; (void)d; (void)ctrl; (void)route;\n\n"
+        << body.str()
+        << "    return { LOA_LIST_NONE, -1 };\n}\n\n"
+        << "const LoaCompiledRuleset kRuleset = { " << Literal(positionId) << ", " << Hex(loadedConfigHash) << ", "
+        << ruleCount << ", &Match };\n"
+        << "LoaCompiledRegistrar kRegistrar(&kRuleset);\n\n"
+        << "} // namespace\n";
+    return out.str();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <config.json> <output.cpp> [positionId]\n", argv[0]);
+        return 2;
+    }
+
+    std::string configPath = argv[1];
+    std::string error;
+    if (!LoadLOAConfigFile(configPath, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    if (loaPredicates.UsesFlightConditions()) {
+        fprintf(stderr, "%s: rules with aircraft, SID/STAR, RFL or squawk conditions are not compiled\n", configPath.c_str());
+        return 1;
+    }
+
+    std::string positionId;
+    if (argc > 3) {
+        positionId = argv[3];
+    }
+    else {
+        size_t slash = configPath.find_last_of("\\/");
+        positionId = configPath.substr(slash == std::string::npos ? 0 : slash + 1);
+        positionId = positionId.substr(0, positionId.find_last_of('.'));
+    }
+
+    Generator generator;
+    std::string source = generator.Run(positionId, configPath.substr(configPath.find_last_of("\\/") + 1));
+
+    std::ofstream out(argv[2], std::ios::binary);
+    if (!out.is_open()) {
+        fprintf(stderr, "cannot write %s\n", argv[2]);
+        return 1;
+    }
+    out << source;
+    return 0;
+}
@@ -0,0 +1,643 @@
+﻿// =========================
+// File: tools/LoaDaemon.cpp
+// =========================
+
+#include "LoaDaemon.h"
+#include "LoaActivation.h"
+#include "LoaCompiled.h"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <ctime>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Fixed-size fields are copied as they are in memory (every target is little-endian)
+struct WireWriter {
+    std::string& out;
+
+    template <class T> void Put(T value) { out.append(reinterpret_cast<const char*>(&value), sizeof(T)); }
+    void Text(const std::string& s)
+    {
+        size_t n = std::min<size_t>(s.size(), 255);
+        Put<uint8_t>((uint8_t)n);
+        out.append(s.data(), n);
+    }
+    void List(const std::vector<std::string>& values)
+    {
+        size_t n = std::min<size_t>(values.size(), 65535);
+        Put<uint16_t>((uint16_t)n);
+        for (size_t i = 0; i < n; ++i) Text(values[i]);
+    }
+};
+
+struct WireReader {
+    const char* p;
+    const char* end;
+    bool ok = true;
+
+    template <class T> T Get()
+    {
+        T value = T();
+        if ((size_t)(end - p) < sizeof(T)) {
+            ok = false;
+            p = end;
+            return value;
+        }
+        memcpy(&value, p, sizeof(T));
+        p += sizeof(T);
+        return value;
+    }
+    void Text(std::string& s)
+    {
+        uint8_t n = Get<uint8_t>();
+        if (!ok || (size_t)(end - p) < n) {
+            ok = false;
+            return;
+        }
+        s.assign(p, n);
+        p += n;
+    }
+    void List(std::vector<std::string>& values)
+    {
+        uint16_t n = Get<uint16_t>();
+        values.resize(ok ? n : 0);
+        for (auto& v : values) Text(v);
+    }
+};
+
+void BeginFrame(std::string& out, const char* magic, size_t count)
+{
+    LoaDaemonFrame frame;
+    memcpy(frame.magic, magic, 4);
+    frame.version = LOA_DAEMON_VERSION;
+    frame.count = (uint32_t)count;
+    frame.bytes = 0;
+    out.assign(reinterpret_cast<const char*>(&frame), sizeof(frame));
+}
+
+void EndFrame(std::string& out)
+{
+    uint32_t bytes = (uint32_t)(out.size() - sizeof(LoaDaemonFrame));
+    memcpy(&out[offsetof(LoaDaemonFrame, bytes)], &bytes, sizeof(bytes));
+}
+
+// Smallest encoding of one flight: id, two levels, eight empty strings, empty route, flags
+const size_t kMinFlightBytes = 4 + 4 + 4 + 8 + 2 + 1;
+const size_t kMinResultBytes = 4 + 4 + 4 + 2;
+
+int32_t RuleId(const LoaReferenceRules& rules, const LOAEntry* entry)
+{
+    const std::vector<LOAEntry>* lists[] = { &rules.destination, &rules.departure, &rules.lorArrivals, &rules.lorDepartures, &rules.fallback };
+    for (int l = LOA_LIST_DESTINATION; entry && l <= LOA_LIST_FALLBACK; ++l) {
+        const auto& list = *lists[l];
+        if (!list.empty() && entry >= list.data() && entry < list.data() + list.size())
+            return (l << 16) | (int32_t)(entry - list.data());
+    }
+    return -1;
+}
+
+void Activate(LoaReferenceRules& rules, uint64_t nowUtcSeconds)
+{
+    static const std::unordered_set<std::string> noConditions;
+    for (auto* list : { &rules.destination, &rules.departure, &rules.lorArrivals, &rules.lorDepartures, &rules.fallback })
+        for (auto& entry : *list) entry.active = LoaRuleActiveAt(entry, nowUtcSeconds / 60, noConditions);
+}
+
+double ThreadCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME created, exited, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &created, &exited, &kernel, &user)) return 0;
+    auto ticks = [](const FILETIME& t) { return ((uint64_t)t.dwHighDateTime << 32) | t.dwLowDateTime; };
+    return (ticks(kernel) + ticks(user)) * 1e-7;
+#else
+    timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0) return 0;
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+#endif
+}
+
+#ifdef _WIN32
+std::string PipeName(const std::string& endpoint)
+{
+    return endpoint.compare(0, 2, "\\\\") == 0 ? endpoint : "\\\\.\\pipe\\" + endpoint;
+}
+
+HANDLE CreatePipeInstance(const std::string& name)
+{
+    return CreateNamedPipeA(name.c_str(), PIPE_ACCESS_DUPLEX, PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT,
+        PIPE_UNLIMITED_INSTANCES, 1 << 16, 1 << 16, 0, nullptr);
+}
+#endif
+
+bool ReadExact(intptr_t channel, void* data, size_t bytes)
+{
+    char* p = static_cast<char*>(data);
+    while (bytes > 0) {
+#ifdef _WIN32
+        DWORD got = 0;
+        if (!ReadFile((HANDLE)channel, p, (DWORD)std::min<size_t>(bytes, 1 << 20), &got, nullptr) || got == 0) return false;
+#else
+        ssize_t got = recv((int)channel, p, bytes, 0);
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) return false;
+#endif
+        p += got;
+        bytes -= (size_t)got;
+    }
+    return true;
+}
+
+bool WriteAll(intptr_t channel, const void* data, size_t bytes)
+{
+    const char* p = static_cast<const char*>(data);
+    while (bytes > 0) {
+#ifdef _WIN32
+        DWORD put = 0;
+        if (!WriteFile((HANDLE)channel, p, (DWORD)std::min<size_t>(bytes, 1 << 20), &put, nullptr) || put == 0) return false;
+#else
+        ssize_t put = send((int)channel, p, bytes, MSG_NOSIGNAL);
+        if (put < 0 && errno == EINTR) continue;
+        if (put <= 0) return false;
+#endif
+        p += put;
+        bytes -= (size_t)put;
+    }
+    return true;
+}
+
+void CloseChannel(intptr_t channel)
+{
+    if (channel == -1) return;
+#ifdef _WIN32
+    CloseHandle((HANDLE)channel);
+#else
+    close((int)channel);
+#endif
+}
+
+// Reads one frame of the expected kind into payload
+bool ReadFrame(intptr_t channel, const char* magic, LoaDaemonFrame& frame, std::string& payload)
+{
+    if (!ReadExact(channel, &frame, sizeof(frame))) return false;
+    if (memcmp(frame.magic, magic, 4) != 0 || frame.version != LOA_DAEMON_VERSION || frame.bytes > LOA_DAEMON_MAX_PAYLOAD)
+        return false;
+    payload.resize(frame.bytes);
+    return frame.bytes == 0 || ReadExact(channel, &payload[0], frame.bytes);
+}
+
+} // namespace
+
+// =============================
+// Protocol
+// =============================
+
+void EncodeLoaDaemonRequest(const LoaDaemonRequest& request, std::string& out)
+{
+    BeginFrame(out, "LOAQ", request.flights.size());
+    WireWriter w = { out };
+    w.List(request.onlineSectors);
+    for (const auto& f : request.flights) {
+        w.Put<uint32_t>(f.id);
+        w.Put<int32_t>(f.clearedAltitude);
+        w.Put<int32_t>(f.finalAltitude);
+        for (const std::string* text : { &f.origin, &f.destination, &f.controller, &f.aircraftType, &f.wake, &f.sid, &f.star, &f.squawk })
+            w.Text(*text);
+        w.List(f.routePoints);
+        bool positions = f.hasPositions && f.routePositions.size() == std::min<size_t>(f.routePoints.size(), 65535);
+        w.Put<uint8_t>(positions ? LOA_DAEMON_FLIGHT_POSITIONS : 0);
+        if (!positions) continue;
+        w.Put<double>(f.position.lat);
+        w.Put<double>(f.position.lon);
+        w.Put<int16_t>((int16_t)f.nextPoint);
+        w.Put<int16_t>((int16_t)f.directTo);
+        for (const LoaGeoPoint& p : f.routePositions) {
+            w.Put<double>(p.lat);
+            w.Put<double>(p.lon);
+        }
+    }
+    EndFrame(out);
+}
+
+bool DecodeLoaDaemonRequest(const char* data, size_t bytes, uint32_t count, LoaDaemonRequest& out)
+{
+    if (count > bytes / kMinFlightBytes) return false;
+
+    WireReader r = { data, data + bytes };
+    r.List(out.onlineSectors);
+    out.flights.resize(count);
+    for (auto& f : out.flights) {
+        f.id = r.Get<uint32_t>();
+        f.clearedAltitude = r.Get<int32_t>();
+        f.finalAltitude = r.Get<int32_t>();
+        for (std::string* text : { &f.origin, &f.destination, &f.controller, &f.aircraftType, &f.wake, &f.sid, &f.star, &f.squawk })
+            r.Text(*text);
+        r.List(f.routePoints);
+        f.hasPositions = (r.Get<uint8_t>() & LOA_DAEMON_FLIGHT_POSITIONS) != 0;
+        f.routePositions.clear();
+        if (f.hasPositions) {
+            f.position.lat = r.Get<double>();
+            f.position.lon = r.Get<double>();
+            f.nextPoint = r.Get<int16_t>();
+            f.directTo = r.Get<int16_t>();
+            if ((size_t)(r.end - r.p) < f.routePoints.size() * 16) return false;
+            f.routePositions.resize(f.routePoints.size());
+            for (LoaGeoPoint& p : f.routePositions) {
+                p.lat = r.Get<double>();
+                p.lon = r.Get<double>();
+            }
+        }
+        if (!r.ok) return false;
+    }
+    return r.ok && r.p == r.end;
+}
+
+void EncodeLoaDaemonResponse(const LoaDaemonResponse& response, std::string& out)
+{
+    BeginFrame(out, "LOAR", response.results.size());
+    WireWriter w = { out };
+    w.Put<uint64_t>(response.configHash);
+    for (const auto& result : response.results) {
+        w.Put<uint32_t>(result.id);
+        w.Put<int32_t>(result.ruleId);
+        w.Put<int32_t>(result.xfl);
+        w.Text(result.cop);
+        w.Text(result.nextSector);
+    }
+    EndFrame(out);
+}
+
+bool DecodeLoaDaemonResponse(const char* data, size_t bytes, uint32_t count, LoaDaemonResponse& out)
+{
+    if (count > bytes / kMinResultBytes) return false;
+
+    WireReader r = { data, data + bytes };
+    out.configHash = r.Get<uint64_t>();
+    out.results.resize(count);
+    for (auto& result : out.results) {
+        result.id = r.Get<uint32_t>();
+        result.ruleId = r.Get<int32_t>();
+        result.xfl = r.Get<int32_t>();
+        r.Text(result.cop);
+        r.Text(result.nextSector);
+        if (!r.ok) return false;
+    }
+    return r.ok && r.p == r.end;
+}
+
+// =============================
+// Rules and evaluation
+// =============================
+
+std::shared_ptr<const LoaDaemonRuleset> LoadLoaDaemonRuleset(const std::vector<std::string>& files,
+    uint64_t nowUtcSeconds, std::string& error)
+{
+    LoaPreparedConfig config;
+    if (!PrepareLOAConfigFiles(files, {}, config, error)) return nullptr;
+
+    auto rules = std::make_shared<LoaReferenceRules>();
+    rules->destination = std::move(config.destination);
+    rules->departure = std::move(config.departure);
+    rules->lorArrivals = std::move(config.lorArrivals);
+    rules->lorDepartures = std::move(config.lorDepartures);
+    rules->fallback = std::move(config.fallback);
+    Activate(*rules, nowUtcSeconds);
+
+    auto geometry = std::make_shared<LoaSectorGeometry>();
+    geometry->Build(config.boundaries, config.cops);
+
+    auto ruleset = std::make_shared<LoaDaemonRuleset>();
+    ruleset->configHash = HashLoaConfig(config.hashed);
+    ruleset->geometry = geometry;
+    for (auto* list : { &rules->destination, &rules->departure, &rules->lorArrivals, &rules->lorDepartures, &rules->fallback })
+        for (const auto& entry : *list) ruleset->windowed |= !entry.activeUtc.empty() || !entry.activeWhen.empty();
+    ruleset->rules = rules;
+    return ruleset;
+}
+
+std::shared_ptr<const LoaDaemonRuleset> ActivateLoaDaemonRuleset(const LoaDaemonRuleset& ruleset, uint64_t nowUtcSeconds)
+{
+    auto rules = std::make_shared<LoaReferenceRules>(*ruleset.rules);
+    Activate(*rules, nowUtcSeconds);
+    auto activated = std::make_shared<LoaDaemonRuleset>(ruleset);
+    activated->rules = rules;
+    return activated;
+}
+
+void EvaluateLoaDaemonBatch(const LoaDaemonRuleset& ruleset, const LoaSectorGeometry& geometry,
+    const LoaDaemonRequest& request, LoaDaemonResponse& out)
+{
+    const LoaReferenceRules& rules = *ruleset.rules;
+    out.configHash = ruleset.configHash;
+    out.results.resize(request.flights.size());
+
+    // One flight reused across the batch; the online set is the batch's
+    LoaReferenceFlight flight;
+    flight.onlineControllers.insert(request.onlineSectors.begin(), request.onlineSectors.end());
+    std::string xfl;
+
+    for (size_t i = 0; i < request.flights.size(); ++i) {
+        const LoaDaemonFlight& f = request.flights[i];
+        flight.origin = f.origin;
+        flight.destination = f.destination;
+        flight.controller = f.controller;
+        flight.routePoints = f.routePoints;
+        flight.clearedAltitude = f.clearedAltitude;
+        flight.aircraftType = f.aircraftType;
+        flight.wake = f.wake;
+        flight.sid = f.sid;
+        flight.star = f.star;
+        flight.finalAltitude = f.finalAltitude;
+        flight.squawk = f.squawk;
+
+        const LOAEntry* entry = ReferenceMatchLoaEntry(rules, flight);
+        LoaDaemonResult& result = out.results[i];
+        result.id = f.id;
+        result.ruleId = RuleId(rules, entry);
+        const std::string* next = entry ? FirstOnlineNextSector(*entry, flight.onlineControllers) : nullptr;
+        result.nextSector = next ? *next : std::string();
+
+        // What the tags show at the cleared altitude, as the result export publishes it
+        ReferenceTagItems(rules, flight, xfl, result.cop);
+        result.xfl = atoi(xfl.c_str());
+        LoaGeoPoint exit;
+        const LoaNamedPoint* derived = result.cop == "COPX" && f.hasPositions && geometry.IsLoaded()
+            ? geometry.RouteExitCop(f.routePositions, f.position, f.nextPoint, f.directTo, exit) : nullptr;
+        if (derived) result.cop = derived->name;
+    }
+}
+
+// =============================
+// Server
+// =============================
+
+bool LoaDaemonServer::Start(const std::string& address, std::shared_ptr<const LoaDaemonRuleset> rules, std::string& error)
+{
+    Stop();
+    endpoint = address;
+    ruleset = rules;
+    stats = LoaDaemonStats();
+
+#ifdef _WIN32
+    HANDLE pipe = CreatePipeInstance(PipeName(endpoint));
+    if (pipe == INVALID_HANDLE_VALUE) {
+        error = "cannot create pipe " + PipeName(endpoint);
+        return false;
+    }
+    listener = (intptr_t)pipe;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(addr.sun_path)) {
+        error = "socket path too long: " + endpoint;
+        return false;
+    }
+    memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        error = "cannot create socket";
+        return false;
+    }
+    unlink(endpoint.c_str());  // left behind by a daemon that did not stop cleanly
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        close(fd);
+        error = "cannot listen on " + endpoint + ": " + strerror(errno);
+        return false;
+    }
+    listener = fd;
+#endif
+
+    stopping = false;
+    acceptor = std::thread(&LoaDaemonServer::AcceptLoop, this);
+    return true;
+}
+
+void LoaDaemonServer::Stop()
+{
+    if (!acceptor.joinable()) return;
+    stopping = true;
+
+#ifdef _WIN32
+    // Wakes the ConnectNamedPipe the acceptor is blocked in
+    HANDLE wake = CreateFileA(PipeName(endpoint).c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (wake != INVALID_HANDLE_VALUE) CloseHandle(wake);
+    acceptor.join();
+    {
+        // A connection thread blocked in ReadFile is woken by cancelling its I/O
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            bool running = false;
+            for (auto& c : connections) {
+                if (c->done) continue;
+                running = true;
+                CancelSynchronousIo(c->thread.native_handle());
+            }
+            if (!running) break;
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            lock.lock();
+        }
+    }
+#else
+    shutdown((int)listener, SHUT_RDWR);
+    acceptor.join();
+    CloseChannel(listener);
+    unlink(endpoint.c_str());
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& c : connections) shutdown((int)c->channel, SHUT_RDWR);
+    }
+#endif
+    listener = -1;
+    ReapConnections(true);
+}
+
+void LoaDaemonServer::SetRuleset(std::shared_ptr<const LoaDaemonRuleset> rules)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    ruleset = rules;
+    stats.reloads++;
+}
+
+std::shared_ptr<const LoaDaemonRuleset> LoaDaemonServer::GetRuleset()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return ruleset;
+}
+
+LoaDaemonStats LoaDaemonServer::GetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+void LoaDaemonServer::AcceptLoop()
+{
+    while (!stopping) {
+#ifdef _WIN32
+        HANDLE pipe = listener != -1 ? (HANDLE)listener : CreatePipeInstance(PipeName(endpoint));
+        listener = -1;
+        if (pipe == INVALID_HANDLE_VALUE) break;
+        bool connected = ConnectNamedPipe(pipe, nullptr) || GetLastError() == ERROR_PIPE_CONNECTED;
+        if (stopping || !connected) {
+            CloseHandle(pipe);
+            continue;
+        }
+        intptr_t channel = (intptr_t)pipe;
+#else
+        int fd = accept((int)listener, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;  // shut down by Stop
+        }
+        intptr_t channel = fd;
+#endif
+
+        ReapConnections(false);
+        std::lock_guard<std::mutex> lock(mutex);
+        std::unique_ptr<Connection> connection(new Connection());
+        connection->channel = channel;
+        connection->thread = std::thread(&LoaDaemonServer::Serve, this, connection.get());
+        connections.push_back(std::move(connection));
+        stats.connections++;
+    }
+}
+
+void LoaDaemonServer::ReapConnections(bool all)
+{
+    std::vector<std::unique_ptr<Connection>> finished;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto split = std::partition(connections.begin(), connections.end(),
+            [&](const std::unique_ptr<Connection>& c) { return !all && !c->done; });
+        std::move(split, connections.end(), std::back_inserter(finished));
+        connections.erase(split, connections.end());
+    }
+    for (auto& c : finished) {
+        c->thread.join();
+        CloseChannel(c->channel);
+    }
+}
+
+void LoaDaemonServer::Serve(Connection* connection)
+{
+    // Kept across batches so their buffers are reused
+    LoaDaemonRequest request;
+    LoaDaemonResponse response;
+    std::string payload, out;
+    LoaSectorGeometry geometry;  // this thread's copy, refreshed when a reload replaces it
+    std::shared_ptr<const LoaSectorGeometry> geometrySource;
+
+    LoaDaemonFrame frame;
+    while (!stopping && ReadExact(connection->channel, &frame, sizeof(frame))) {
+        bool valid = memcmp(frame.magic, "LOAQ", 4) == 0 && frame.version == LOA_DAEMON_VERSION &&
+            frame.bytes <= LOA_DAEMON_MAX_PAYLOAD;
+        if (valid) {
+            payload.resize(frame.bytes);
+            if (frame.bytes > 0 && !ReadExact(connection->channel, &payload[0], frame.bytes)) break;
+        }
+
+        double cpuStart = ThreadCpuSeconds();
+        std::shared_ptr<const LoaDaemonRuleset> rules = GetRuleset();
+        valid = valid && DecodeLoaDaemonRequest(payload.data(), payload.size(), frame.count, request);
+        if (valid) {
+            if (rules->geometry != geometrySource) {
+                geometrySource = rules->geometry;
+                geometry = *geometrySource;
+            }
+            EvaluateLoaDaemonBatch(*rules, geometry, request, response);
+        }
+        else {
+            response.configHash = rules->configHash;
+            response.results.clear();
+        }
+        EncodeLoaDaemonResponse(response, out);
+        double cpu = ThreadCpuSeconds() - cpuStart;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stats.batches++;
+            stats.flights += response.results.size();
+            stats.busyCpuSeconds += cpu;
+            if (!valid) stats.errors++;
+        }
+        if (!WriteAll(connection->channel, out.data(), out.size()) || !valid) break;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    connection->done = true;
+}
+
+// =============================
+// Client
+// =============================
+
+bool LoaDaemonClient::Connect(const std::string& endpoint, std::string& error)
+{
+    Close();
+#ifdef _WIN32
+    std::string name = PipeName(endpoint);
+    for (int attempt = 0; attempt < 5; ++attempt) {
+        HANDLE pipe = CreateFileA(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (pipe != INVALID_HANDLE_VALUE) {
+            channel = (intptr_t)pipe;
+            return true;
+        }
+        if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(name.c_str(), 2000)) break;
+    }
+    error = "cannot open pipe " + name;
+    return false;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (endpoint.size() >= sizeof(addr.sun_path)) {
+        error = "socket path too long: " + endpoint;
+        return false;
+    }
+    memcpy(addr.sun_path, endpoint.c_str(), endpoint.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+        error = "cannot connect to " + endpoint + ": " + strerror(errno);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    channel = fd;
+    return true;
+#endif
+}
+
+void LoaDaemonClient::Close()
+{
+    CloseChannel(channel);
+    channel = -1;
+}
+
+bool LoaDaemonClient::Evaluate(const LoaDaemonRequest& request, LoaDaemonResponse& response)
+{
+    if (channel == -1) return false;
+    EncodeLoaDaemonRequest(request, buffer);
+    LoaDaemonFrame frame;
+    bool ok = WriteAll(channel, buffer.data(), buffer.size()) && ReadFrame(channel, "LOAR", frame, buffer) &&
+        DecodeLoaDaemonResponse(buffer.data(), buffer.size(), frame.count, response) &&
+        response.results.size() == request.flights.size();
+    if (!ok) Close();
+    return ok;
+}
@@ -0,0 +1,189 @@
+﻿#pragma once
+
+#include "LoaGeometry.h"
+#include "LoaReference.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// =============================
+// LOA Evaluation Daemon
+// =============================
+// loa_daemon answers LOA queries for tools that run without EuroScope (traffic
+// generators, replays, dashboards). It listens on a Unix domain socket on Linux
+// and on a named pipe (\\.\pipe\<name>) on Windows. Each connection gets its
+// own thread, and a request carries a whole batch of flights, so one round
+// trip answers a whole traffic sample.
+//
+// Every message is a 16-byte LoaDaemonFrame followed by its payload, all
+// little-endian. A string is a u8 length and its bytes; a list is a u16 count
+// and its items.
+//
+//   request  "LOAQ": online sectors (list of strings), then per flight:
+//            u32 id, i32 cleared altitude, i32 final altitude, origin,
+//            destination, tracking controller, aircraft type, wake, SID, STAR,
+//            squawk (strings), extracted route (list of strings), u8 flags;
+//            with flag 1 (positions) set: f64 lat, f64 lon of the flight,
+//            i16 calculated and i16 assigned route point index, then f64 lat,
+//            f64 lon per route point
+//   response "LOAR": u64 hash of the rules answered with, then per flight:
+//            u32 id, i32 rule id ((list << 16) | index, -1 = none), i32 XFL,
+//            COP, next sector (strings; the next sector is "" when none is online)
+//
+// XFL and COP are what the plugin's tags (and its result export) show at the
+// cleared altitude: the XFL tag as a number, 0 when it is empty, and the COP
+// tag, derived from where the route leaves the sector when no rule names one
+// and the flight came with positions. The rule id and next sector are those of
+// MatchLoaEntry's match.
+//
+// A malformed request gets a response with count 0 and the connection closed.
+// Evaluation uses the reference engine (LoaReference.h) over an immutable
+// snapshot of the rules. Shadow mode checks that engine against the plugin,
+// and unlike the plugin's caches it can serve several threads at once. A
+// reload swaps the snapshot; batches that are running keep the one they started
+// with. The daemon links only the SDK-free part of the plugin (LoaRules.h).
+
+const uint32_t LOA_DAEMON_VERSION = 2;
+const uint8_t LOA_DAEMON_FLIGHT_POSITIONS = 1;
+const uint32_t LOA_DAEMON_MAX_PAYLOAD = 16u << 20;
+
+struct LoaDaemonFrame {
+    char magic[4];      // "LOAQ" request, "LOAR" response
+    uint32_t version;   // LOA_DAEMON_VERSION
+    uint32_t count;     // flights in the batch
+    uint32_t bytes;     // payload size
+};
+
+static_assert(sizeof(LoaDaemonFrame) == 16, "LoaDaemonFrame layout");
+
+struct LoaDaemonFlight {
+    uint32_t id = 0;    // echoed back, the daemon does not interpret it
+    int clearedAltitude = 0;
+    int finalAltitude = 0;
+    std::string origin;
+    std::string destination;
+    std::string controller;
+    std::string aircraftType;
+    std::string wake;
+    std::string sid;
+    std::string star;
+    std::string squawk;
+    std::vector<std::string> routePoints;
+
+    // Optional, for the COP tag's geometric fallback (LoaSectorGeometry::RouteExitCop)
+    bool hasPositions = false;
+    LoaGeoPoint position;
+    int nextPoint = 0;                       // GetPointsCalculatedIndex
+    int directTo = -1;                       // GetPointsAssignedIndex
+    std::vector<LoaGeoPoint> routePositions; // one per route point
+};
+
+struct LoaDaemonRequest {
+    std::vector<std::string> onlineSectors;
+    std::vector<LoaDaemonFlight> flights;
+};
+
+struct LoaDaemonResult {
+    uint32_t id = 0;
+    int32_t ruleId = -1;
+    int32_t xfl = 0;
+    std::string cop;
+    std::string nextSector;
+};
+
+struct LoaDaemonResponse {
+    uint64_t configHash = 0;
+    std::vector<LoaDaemonResult> results;
+};
+
+// Frame and payload; Decode* take the payload and the frame's count
+void EncodeLoaDaemonRequest(const LoaDaemonRequest& request, std::string& out);
+bool DecodeLoaDaemonRequest(const char* data, size_t bytes, uint32_t count, LoaDaemonRequest& out);
+void EncodeLoaDaemonResponse(const LoaDaemonResponse& response, std::string& out);
+bool DecodeLoaDaemonResponse(const char* data, size_t bytes, uint32_t count, LoaDaemonResponse& out);
+
+// The rules one batch is answered with
+struct LoaDaemonRuleset {
+    std::shared_ptr<const LoaReferenceRules> rules;
+    std::shared_ptr<const LoaSectorGeometry> geometry;  // boundaries and COPs of the files
+    uint64_t configHash = 0;
+    bool windowed = false;  // some rule has activeUtc or activeWhen
+};
+
+// Parses the sector files (PrepareLOAConfigFiles, no bandbox merging) and
+// sets each rule's active flag for the given UTC time. Named conditions are
+// all off, as at plugin startup.
+std::shared_ptr<const LoaDaemonRuleset> LoadLoaDaemonRuleset(const std::vector<std::string>& files,
+    uint64_t nowUtcSeconds, std::string& error);
+
+// Same rules, active flags re-evaluated (activation windows cross minute boundaries)
+std::shared_ptr<const LoaDaemonRuleset> ActivateLoaDaemonRuleset(const LoaDaemonRuleset& ruleset, uint64_t nowUtcSeconds);
+
+// geometry: the calling thread's copy of ruleset.geometry (FindExit keeps
+// per-query state, so threads must not share one)
+void EvaluateLoaDaemonBatch(const LoaDaemonRuleset& ruleset, const LoaSectorGeometry& geometry,
+    const LoaDaemonRequest& request, LoaDaemonResponse& out);
+
+struct LoaDaemonStats {
+    unsigned long long connections = 0;
+    unsigned long long batches = 0;
+    unsigned long long flights = 0;
+    unsigned long long errors = 0;      // malformed requests
+    unsigned long long reloads = 0;
+    double busyCpuSeconds = 0;          // connection threads' CPU time decoding, evaluating and encoding
+};
+
+class LoaDaemonServer {
+public:
+    ~LoaDaemonServer() { Stop(); }
+
+    // Socket path on Linux, pipe name on Windows
+    bool Start(const std::string& endpoint, std::shared_ptr<const LoaDaemonRuleset> ruleset, std::string& error);
+    void Stop();
+
+    void SetRuleset(std::shared_ptr<const LoaDaemonRuleset> ruleset);
+    std::shared_ptr<const LoaDaemonRuleset> GetRuleset();
+
+    LoaDaemonStats GetStats();
+
+private:
+    struct Connection {
+        intptr_t channel = -1;
+        std::thread thread;
+        bool done = false;
+    };
+
+    void AcceptLoop();
+    void Serve(Connection* connection);
+    void ReapConnections(bool all);
+
+    std::string endpoint;
+    intptr_t listener = -1;             // socket on Linux, unused on Windows
+    std::thread acceptor;
+    std::atomic<bool> stopping{ false };
+
+    std::mutex mutex;                   // guards the fields below
+    std::shared_ptr<const LoaDaemonRuleset> ruleset;
+    std::vector<std::unique_ptr<Connection>> connections;
+    LoaDaemonStats stats;
+};
+
+// One connection; requests are answered in order
+class LoaDaemonClient {
+public:
+    ~LoaDaemonClient() { Close(); }
+
+    bool Connect(const std::string& endpoint, std::string& error);
+    void Close();
+
+    bool Evaluate(const LoaDaemonRequest& request, LoaDaemonResponse& response);
+
+private:
+    intptr_t channel = -1;
+    std::string buffer;
+};
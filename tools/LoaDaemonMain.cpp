@@ -0,0 +1,115 @@
+﻿// =========================
+// File: tools/LoaDaemonMain.cpp
+// =========================
+// Standalone LOA evaluation daemon (see LoaDaemon.h):
+//
+//   loa_daemon <socket path | pipe name> <sector.json> [sector.json ...]
+//
+// Serves until interrupted. The sector files are read once a second; when
+// their contents change they are parsed again and swapped in, and a file that
+// no longer parses leaves the previous rules in place. Rules with activation
+// windows are re-evaluated every minute. A stats line is printed every minute.
+
+#include "LoaDaemon.h"
+#include "LoaActivation.h"
+#include "LoaCompiled.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+volatile std::sig_atomic_t interrupted = 0;
+
+void OnSignal(int)
+{
+    interrupted = 1;
+}
+
+// Hash of the files as they are on disk, to notice edits without parsing
+uint64_t HashFiles(const std::vector<std::string>& files)
+{
+    std::string all;
+    for (const auto& path : files) {
+        std::ifstream in(path, std::ios::binary);
+        std::stringstream buffer;
+        buffer << in.rdbuf();
+        all += path + '\n' + buffer.str();
+    }
+    return HashLoaConfig(all);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <socket path | pipe name> <sector.json> [sector.json ...]\n", argv[0]);
+        return 2;
+    }
+    std::string endpoint = argv[1];
+    std::vector<std::string> files(argv + 2, argv + argc);
+
+    std::string error;
+    uint64_t filesHash = HashFiles(files);
+    std::shared_ptr<const LoaDaemonRuleset> ruleset = LoadLoaDaemonRuleset(files, LoaUtcNow(), error);
+    if (!ruleset) {
+        fprintf(stderr, "config: %s\n", error.c_str());
+        return 1;
+    }
+
+    LoaDaemonServer server;
+    if (!server.Start(endpoint, ruleset, error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::signal(SIGINT, OnSignal);
+    std::signal(SIGTERM, OnSignal);
+    printf("serving %s, rules %016llx\n", endpoint.c_str(), (unsigned long long)ruleset->configHash);
+    fflush(stdout);
+
+    uint64_t lastMinute = LoaUtcNow() / 60;
+    LoaDaemonStats lastStats;
+    while (!interrupted) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+
+        uint64_t hash = HashFiles(files);
+        if (hash != filesHash) {
+            filesHash = hash;
+            std::shared_ptr<const LoaDaemonRuleset> reloaded = LoadLoaDaemonRuleset(files, LoaUtcNow(), error);
+            if (reloaded) {
+                ruleset = reloaded;
+                server.SetRuleset(ruleset);
+                printf("reloaded, rules %016llx\n", (unsigned long long)ruleset->configHash);
+            }
+            else {
+                printf("reload failed, keeping rules %016llx: %s\n", (unsigned long long)ruleset->configHash, error.c_str());
+            }
+            fflush(stdout);
+        }
+
+        uint64_t minute = LoaUtcNow() / 60;
+        if (minute == lastMinute) continue;
+        lastMinute = minute;
+        if (ruleset->windowed) {
+            ruleset = ActivateLoaDaemonRuleset(*ruleset, LoaUtcNow());
+            server.SetRuleset(ruleset);
+        }
+
+        LoaDaemonStats stats = server.GetStats();
+        unsigned long long flights = stats.flights - lastStats.flights;
+        double cpu = stats.busyCpuSeconds - lastStats.busyCpuSeconds;
+        printf("connections %llu  batches %llu  flights %llu (+%llu, %.0f per CPU second)  malformed %llu\n",
+            stats.connections, stats.batches, stats.flights, flights, cpu > 0 ? flights / cpu : 0.0, stats.errors);
+        fflush(stdout);
+        lastStats = stats;
+    }
+
+    server.Stop();
+    return 0;
+}
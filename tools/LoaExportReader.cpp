@@ -0,0 +1,90 @@
+﻿// =========================
+// File: tools/LoaExportReader.cpp
+// =========================
+// Linux reader for the shared-memory result table (see LoaExport.h):
+//
+//   loa_export_reader [name] [--watch]
+//
+// Prints every flight in the table; --watch prints the flights whose record
+// changed, once a second, until interrupted. The name defaults to the one
+// ".loa export on" uses.
+
+#include "LoaExport.h"
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+
+const LoaExportHeader* Map(const std::string& name)
+{
+    int fd = shm_open(("/" + name).c_str(), O_RDONLY, 0);
+    if (fd < 0) return nullptr;
+    size_t bytes = sizeof(LoaExportHeader) + LOA_EXPORT_CAPACITY * sizeof(LoaExportRecord);
+    void* view = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return view == MAP_FAILED ? nullptr : static_cast<const LoaExportHeader*>(view);
+}
+
+std::string Field(const char* text, size_t size)
+{
+    return std::string(text, strnlen(text, size));
+}
+
+void Print(const LoaExportData& d)
+{
+    std::string rule = d.ruleId < 0 ? "-" : std::to_string(d.ruleId >> 16) + "/" + std::to_string(d.ruleId & 0xFFFF);
+    printf("%-11s rule %-8s XFL %3d  COP %-8s next %-10s exit FL%03d (%d) %s (%d)\n",
+        Field(d.callsign, sizeof(d.callsign)).c_str(), rule.c_str(), d.xfl,
+        Field(d.cop, sizeof(d.cop)).c_str(), Field(d.nextSector, sizeof(d.nextSector)).c_str(),
+        d.exitAltitude / 100, d.exitAltitudeState, Field(d.exitPoint, sizeof(d.exitPoint)).c_str(), d.exitPointState);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::string name = LOA_EXPORT_DEFAULT_NAME;
+    bool watch = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--watch") == 0) watch = true;
+        else name = argv[i];
+    }
+
+    const LoaExportHeader* header = Map(name);
+    if (!header || memcmp(header->magic, "LOAXPORT", 8) != 0 || header->version != LOA_EXPORT_VERSION ||
+        header->recordSize != sizeof(LoaExportRecord)) {
+        fprintf(stderr, "no LOA result table at /%s\n", name.c_str());
+        return 1;
+    }
+    const LoaExportRecord* records = reinterpret_cast<const LoaExportRecord*>(
+        reinterpret_cast<const char*>(header) + header->headerSize);
+
+    std::map<uint32_t, uint32_t> seen;  // slot -> sequence last printed
+    do {
+        unsigned long long torn = 0;
+        uint32_t highWater = header->highWater.load(std::memory_order_acquire);
+        for (uint32_t i = 0; i < highWater && i < header->capacity; ++i) {
+            uint32_t sequence = records[i].sequence.load(std::memory_order_acquire);
+            auto last = seen.find(i);
+            if (last != seen.end() && last->second == sequence) continue;
+
+            LoaExportData data;
+            if (!LoaExportTryRead(records[i], data)) {
+                torn++;
+                continue;
+            }
+            seen[i] = sequence;
+            if (data.callsign[0]) Print(data);
+            else if (watch && last != seen.end()) printf("slot %u freed\n", i);
+        }
+        if (torn) printf("(%llu records busy, retried next pass)\n", torn);
+        fflush(stdout);
+        if (watch) sleep(1);
+    } while (watch && memcmp(header->magic, "LOAXPORT", 8) == 0);
+    return 0;
+}